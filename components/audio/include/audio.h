@@ -0,0 +1,66 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One I2S port driving the INMP441 microphone and the MAX98357A amplifier
+ * from the same bit and word clocks, so capture and playback run at the
+ * same time. Both ends use mono, left-slot, 32-bit frames.
+ */
+typedef struct {
+    uint32_t sample_rate;
+    int bclk_gpio;          // shared by mic SCK and amp BCLK
+    int ws_gpio;            // shared by mic WS and amp LRC
+    int din_gpio;           // mic SD
+    int dout_gpio;          // amp DIN
+    uint32_t dma_desc_num;
+    uint32_t dma_frame_num; // frames per DMA buffer
+} audio_config_t;
+
+#define AUDIO_CONFIG_DEFAULT() {    \
+    .sample_rate = 16000,           \
+    .bclk_gpio = 21,                \
+    .ws_gpio = 47,                  \
+    .din_gpio = 48,                 \
+    .dout_gpio = 38,                \
+    .dma_desc_num = 6,              \
+    .dma_frame_num = 240,           \
+}
+
+/**
+ * @brief Create and start the full-duplex channel pair. Calling it again
+ *        with the same sample rate is a no-op, so every client can call it.
+ * @param config NULL for AUDIO_CONFIG_DEFAULT()
+ * @return ESP_ERR_INVALID_STATE if already running at another rate.
+ */
+esp_err_t audio_init(const audio_config_t *config);
+
+bool audio_is_running(void);
+uint32_t audio_get_sample_rate(void);
+
+/**
+ * @brief Read raw 32-bit microphone frames (24 significant bits, MSB aligned).
+ * @param got Frames actually read.
+ */
+esp_err_t audio_read(int32_t *frames, size_t count, size_t *got, uint32_t timeout_ms);
+
+/**
+ * @brief Queue 32-bit frames for the amplifier.
+ */
+esp_err_t audio_write(const int32_t *frames, size_t count, size_t *written, uint32_t timeout_ms);
+
+/**
+ * @brief Queue 16-bit PCM for the amplifier, widened to the 32-bit slot.
+ */
+esp_err_t audio_write_pcm16(const int16_t *samples, size_t count, size_t *written, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,148 @@
+#include "audio.h"
+#include "driver/i2s_std.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "AUDIO";
+
+#define AUDIO_I2S_PORT  I2S_NUM_0
+#define PCM16_CHUNK     128
+
+static i2s_chan_handle_t tx_chan = NULL;
+static i2s_chan_handle_t rx_chan = NULL;
+static audio_config_t cfg;
+static SemaphoreHandle_t init_lock = NULL;
+static portMUX_TYPE init_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static TickType_t to_ticks(uint32_t timeout_ms) {
+    return timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+static esp_err_t start_channels(void) {
+    // Both directions on one controller: the driver runs them off the same
+    // clock, which is what lets the mic and amp share BCLK/WS
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(AUDIO_I2S_PORT, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = cfg.dma_desc_num;
+    chan_cfg.dma_frame_num = cfg.dma_frame_num;
+    chan_cfg.auto_clear = true;     // underruns play silence, not the last buffer
+    esp_err_t ret = i2s_new_channel(&chan_cfg, &tx_chan, &rx_chan);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "i2s_new_channel failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // INMP441 needs 64 BCLK per frame and puts 24 bits MSB-first in the
+    // left slot; the MAX98357A accepts the same frame and plays the left
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(cfg.sample_rate),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = cfg.bclk_gpio,
+            .ws   = cfg.ws_gpio,
+            .dout = cfg.dout_gpio,
+            .din  = cfg.din_gpio,
+            .invert_flags = {0}
+        }
+    };
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+
+    ret = i2s_channel_init_std_mode(tx_chan, &std_cfg);
+    if (ret == ESP_OK) ret = i2s_channel_init_std_mode(rx_chan, &std_cfg);
+    if (ret == ESP_OK) ret = i2s_channel_enable(tx_chan);
+    if (ret == ESP_OK) ret = i2s_channel_enable(rx_chan);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Channel setup failed: %s", esp_err_to_name(ret));
+        i2s_del_channel(tx_chan);
+        i2s_del_channel(rx_chan);
+        tx_chan = rx_chan = NULL;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Full duplex @ %lu Hz: BCLK %d, WS %d, DIN %d, DOUT %d", (unsigned long)cfg.sample_rate,
+             cfg.bclk_gpio, cfg.ws_gpio, cfg.din_gpio, cfg.dout_gpio);
+    return ESP_OK;
+}
+
+esp_err_t audio_init(const audio_config_t *config) {
+    audio_config_t defaults = AUDIO_CONFIG_DEFAULT();
+    const audio_config_t *want = config ? config : &defaults;
+    if (want->sample_rate == 0) return ESP_ERR_INVALID_ARG;
+
+    // Microphone and speaker may both come up at boot from different tasks.
+    // The mutex is created outside the spinlock; a racing loser deletes its own
+    if (!init_lock) {
+        SemaphoreHandle_t m = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&init_mux);
+        if (!init_lock) {
+            init_lock = m;
+            m = NULL;
+        }
+        portEXIT_CRITICAL(&init_mux);
+        if (m) vSemaphoreDelete(m);
+    }
+    if (!init_lock) return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(init_lock, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    if (tx_chan) {
+        if (want->sample_rate != cfg.sample_rate) {
+            ESP_LOGE(TAG, "Already running at %lu Hz, can't switch to %lu Hz",
+                     (unsigned long)cfg.sample_rate, (unsigned long)want->sample_rate);
+            ret = ESP_ERR_INVALID_STATE;
+        }
+    } else {
+        cfg = *want;
+        ret = start_channels();
+    }
+    xSemaphoreGive(init_lock);
+    return ret;
+}
+
+bool audio_is_running(void) {
+    return tx_chan != NULL;
+}
+
+uint32_t audio_get_sample_rate(void) {
+    return tx_chan ? cfg.sample_rate : 0;
+}
+
+esp_err_t audio_read(int32_t *frames, size_t count, size_t *got, uint32_t timeout_ms) {
+    if (!rx_chan) return ESP_ERR_INVALID_STATE;
+    if (!frames || !got) return ESP_ERR_INVALID_ARG;
+
+    size_t bytes = 0;
+    esp_err_t ret = i2s_channel_read(rx_chan, frames, count * sizeof(int32_t), &bytes, to_ticks(timeout_ms));
+    *got = bytes / sizeof(int32_t);
+    return ret;
+}
+
+esp_err_t audio_write(const int32_t *frames, size_t count, size_t *written, uint32_t timeout_ms) {
+    if (!tx_chan) return ESP_ERR_INVALID_STATE;
+    if (!frames) return ESP_ERR_INVALID_ARG;
+
+    size_t bytes = 0;
+    esp_err_t ret = i2s_channel_write(tx_chan, frames, count * sizeof(int32_t), &bytes, to_ticks(timeout_ms));
+    if (written) *written = bytes / sizeof(int32_t);
+    return ret;
+}
+
+esp_err_t audio_write_pcm16(const int16_t *samples, size_t count, size_t *written, uint32_t timeout_ms) {
+    if (!tx_chan) return ESP_ERR_INVALID_STATE;
+    if (!samples) return ESP_ERR_INVALID_ARG;
+
+    int32_t wide[PCM16_CHUNK];
+    size_t done = 0;
+    esp_err_t ret = ESP_OK;
+    while (done < count) {
+        size_t n = count - done < PCM16_CHUNK ? count - done : PCM16_CHUNK;
+        for (size_t i = 0; i < n; i++) wide[i] = (int32_t)samples[done + i] << 16;
+        size_t w = 0;
+        ret = audio_write(wide, n, &w, timeout_ms);
+        done += w;
+        if (ret != ESP_OK || w < n) break;
+    }
+    if (written) *written = done;
+    return ret;
+}
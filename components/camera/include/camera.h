@@ -1,11 +1,37 @@
 #pragma once
 
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "frame_source.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void init_camera(void);
-void start_camera_server(void);
+// Viewers that can watch /stream at the same time. Each one gets its own
+// worker task and keeps one httpd socket open.
+#define CAMERA_MAX_STREAMS 3
+
+// WebSocket viewers (/ws/camera), on top of the MJPEG ones
+#define CAMERA_MAX_WS_CLIENTS 2
+
+// Snapshot requests parked on their own task while they wait for a frame
+#define CAMERA_MAX_SNAPSHOT_WAITERS 4
+
+/**
+ * Bring up the default frame source for the target (the sensor, or JPEG
+ * replay on linux) and start capturing. Fails if there is no source.
+ */
+esp_err_t init_camera(void);
+
+/**
+ * Start the capture task and everything behind it on a given source.
+ */
+esp_err_t camera_start(const frame_source_t *source);
+
+// Register /stream and the /api/camera/* routes with an existing server
+// (see petbot_web_add_handlers)
+esp_err_t camera_register_handlers(httpd_handle_t server);
 
 #ifdef __cplusplus
 }
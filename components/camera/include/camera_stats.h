@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log2 latency buckets: bucket 0 is < 256 us, bucket k covers
+// [2^(k+7), 2^(k+8)) us and the last one catches everything above ~4 s.
+#define CAMERA_STATS_BUCKETS 16
+
+typedef struct {
+    uint32_t buckets[CAMERA_STATS_BUCKETS];
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+} camera_hist_t;
+
+/**
+ * Remember the driver settings so /api/camera/stats can be read against them.
+ */
+void camera_stats_init(int xclk_freq_hz, int fb_count, int grab_mode);
+
+/**
+ * One frame out of the frame source.
+ * wait_us:    time blocked in the source's get() (esp_camera_fb_get())
+ * readout_us: capture timestamp to get() returning
+ * copy_us:    copying the frame into the shared ring
+ */
+void camera_stats_record_capture(int64_t wait_us, int64_t readout_us, int64_t copy_us);
+
+// One slot per MJPEG and WebSocket viewer
+#define CAMERA_STATS_MAX_CLIENTS (CAMERA_MAX_STREAMS + CAMERA_MAX_WS_CLIENTS)
+
+/**
+ * Claim a per-client slot for a new viewer. Returns the slot id, or -1 if
+ * all slots are in use (the viewer then simply isn't tracked).
+ */
+int camera_stats_client_open(int fd, const char *mode);
+
+/**
+ * One frame sent to a viewer.
+ * queue_us:   capture timestamp to the viewer picking the frame up
+ * send_us:    time spent writing it to the socket
+ * skipped:    newer frames published since the previous one it sent
+ */
+void camera_stats_client_frame(int id, int64_t queue_us, int64_t send_us, uint32_t skipped);
+
+/**
+ * The client acknowledged a frame (WebSocket only): capture timestamp to
+ * the ack arriving, i.e. glass-to-glass minus the return trip.
+ */
+void camera_stats_client_ack(int id, int64_t latency_us);
+
+void camera_stats_client_close(int id);
+
+/**
+ * Register GET /api/camera/stats (and DELETE to reset) with an existing server.
+ */
+esp_err_t camera_stats_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    size_t budget_bytes;        // PSRAM arena holding the JPEG frames
+    uint16_t window_s;          // keep at most this many seconds of history
+    uint16_t post_roll_ms;      // keep recording this long after a trigger
+    bool freeze_on_motion;      // trigger on motion START events
+} clip_recorder_config_t;
+
+#define CLIP_RECORDER_CONFIG_DEFAULT() { \
+    .budget_bytes = 1024 * 1024,         \
+    .window_s = 10,                      \
+    .post_roll_ms = 2000,                \
+    .freeze_on_motion = true,            \
+}
+
+typedef struct {
+    bool frozen;
+    uint32_t frames;            // frames currently in the window
+    uint32_t bytes;             // JPEG bytes currently in the window
+    uint32_t duration_ms;       // newest minus oldest timestamp
+    uint32_t dropped;           // frames the recorder couldn't keep up with
+    uint32_t budget_bytes;
+    uint16_t width;
+    uint16_t height;
+} clip_recorder_stats_t;
+
+/**
+ * Allocate the arena and start the recorder task. It reads frames from the
+ * capture ring like any viewer, so it never slows the camera down.
+ * The arena lives in PSRAM, so this fails unless CONFIG_SPIRAM is enabled
+ * for the board's PSRAM type; the committed sdkconfig leaves it off.
+ */
+esp_err_t clip_recorder_init(const clip_recorder_config_t *config);
+
+/**
+ * Freeze the window after the configured post-roll.
+ */
+void clip_recorder_trigger(void);
+
+/**
+ * Freeze the window now / start recording again.
+ */
+void clip_recorder_freeze(void);
+void clip_recorder_resume(void);
+
+void clip_recorder_get_stats(clip_recorder_stats_t *out);
+
+/**
+ * Register GET/DELETE /api/camera/clip and GET /api/camera/clip/status.
+ * Downloads are sent from a worker task, one at a time.
+ */
+esp_err_t clip_recorder_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "camera.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Readers that can each hold a frame at the same time: /stream and
+// /ws/camera viewers, parked snapshot requests, a snapshot answered on the
+// httpd task, and the clip recorder.
+#define FRAME_RING_READERS \
+    (CAMERA_MAX_STREAMS + CAMERA_MAX_WS_CLIENTS + CAMERA_MAX_SNAPSHOT_WAITERS + 2)
+
+// Number of JPEG slots shared by the capture task and all readers: one per
+// reader, one for the latest frame and one to write into, so readers stuck
+// on older frames can never leave the capture task without a free slot.
+// Buffers are only allocated for slots that are actually used.
+#define FRAME_RING_SLOTS (FRAME_RING_READERS + 2)
+
+/**
+ * A captured JPEG frame owned by the ring.
+ * Readers get one from frame_ring_acquire() and must hand it back with
+ * frame_ring_release(); the contents never change while it is held.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    uint32_t seq;           // 1, 2, 3... in publish order
+    int64_t timestamp_us;   // esp_timer time at capture
+    uint16_t width;
+    uint16_t height;
+    uint32_t refs;          // readers currently holding this slot
+} camera_frame_t;
+
+/**
+ * Allocate the ring bookkeeping. Slot buffers are grown lazily on publish.
+ */
+esp_err_t frame_ring_init(void);
+
+/**
+ * Copy a captured JPEG into a free slot and make it the latest frame.
+ * Never blocks on readers; a frame is only dropped (ESP_ERR_NO_MEM) if
+ * its buffer can't be allocated.
+ */
+esp_err_t frame_ring_publish(const uint8_t *jpeg, size_t len, uint16_t width, uint16_t height,
+                             int64_t timestamp_us);
+
+/**
+ * Take a reference to the newest frame whose seq is greater than after_seq,
+ * waiting up to timeout for one to be published. Pass 0 to take whatever
+ * is latest. Returns NULL on timeout.
+ */
+camera_frame_t *frame_ring_acquire(uint32_t after_seq, TickType_t timeout);
+
+/**
+ * Drop a reference taken with frame_ring_acquire().
+ */
+void frame_ring_release(camera_frame_t *frame);
+
+/**
+ * Frames dropped because no slot was free or its buffer couldn't be grown.
+ */
+uint32_t frame_ring_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    FRAME_FORMAT_JPEG = 0,
+    FRAME_FORMAT_GRAYSCALE,
+    FRAME_FORMAT_YUV422,
+    FRAME_FORMAT_RGB565,
+    FRAME_FORMAT_OTHER,     // anything else the sensor can produce
+} frame_format_t;
+
+/**
+ * One frame lent out by a source until it is handed back with put().
+ */
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+    frame_format_t format;
+    int64_t timestamp_us;   // esp_timer time at capture
+    void *priv;             // owned by the source
+} frame_source_frame_t;
+
+/**
+ * Where the capture task gets its frames from. Only the capture task calls
+ * into a source, so implementations need no locking of their own.
+ */
+typedef struct {
+    const char *name;
+    void *ctx;
+
+    /** Block until the next frame is ready. */
+    esp_err_t (*get)(void *ctx, frame_source_frame_t *out);
+
+    /** Return a frame from get(). */
+    void (*put)(void *ctx, frame_source_frame_t *frame);
+
+    /** Switch frame size and JPEG quality. NULL if the source can't. */
+    esp_err_t (*set_format)(void *ctx, uint16_t width, uint16_t height, uint8_t quality);
+} frame_source_t;
+
+/**
+ * The camera sensor via esp32-camera. Initialises the driver.
+ */
+esp_err_t frame_source_sensor_init(const frame_source_t **out);
+
+typedef struct {
+    const char *dir;        // directory of *.jpg files, played in name order
+    uint16_t fps;
+    bool loop;              // start over at the end instead of stopping
+} frame_source_replay_config_t;
+
+/**
+ * Replays recorded JPEGs at a fixed rate. Built for the linux target only,
+ * so streaming can be load-tested without hardware.
+ */
+esp_err_t frame_source_replay_init(const frame_source_replay_config_t *config, const frame_source_t **out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "lwip/sockets.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MJPEG_STREAM_CHUNKED = 0,   // httpd_resp_send_chunk: 3 chunks per frame
+    MJPEG_STREAM_RAW,           // one gathered send per frame straight to the socket
+    MJPEG_STREAM_MODE_COUNT,
+} mjpeg_stream_mode_t;
+
+typedef struct {
+    uint32_t frames;
+    uint64_t total_us;
+    int64_t max_us;
+} mjpeg_stream_latency_t;
+
+/**
+ * Per-frame send latency accumulated since boot for one streaming mode.
+ */
+void mjpeg_stream_get_latency(mjpeg_stream_mode_t mode, mjpeg_stream_latency_t *out);
+
+/**
+ * Write every byte of an iovec list to a socket, advancing through partial
+ * sends. Shared by the transports that bypass httpd for the frame body.
+ */
+esp_err_t mjpeg_stream_send_iov(int fd, struct iovec *iov, int iovcnt);
+
+/**
+ * Register /stream and /api/camera/latency with an existing server.
+ */
+esp_err_t mjpeg_stream_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
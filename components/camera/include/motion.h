@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "motion_kernels.h"
+#include "frame_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MOTION_EVENT_START = 0,
+    MOTION_EVENT_UPDATE,      // still moving; box follows the latest frame
+    MOTION_EVENT_END,
+} motion_event_type_t;
+
+typedef struct {
+    motion_event_type_t type;
+    motion_box_t box;         // in full frame pixels
+    uint32_t changed;         // changed pixels in the analysis frame
+    int64_t timestamp_us;     // capture time of the frame that triggered it
+} motion_event_t;
+
+/**
+ * Called from the capture task; keep it short.
+ */
+typedef void (*motion_event_cb_t)(const motion_event_t *event, void *arg);
+
+typedef struct {
+    uint8_t analyze_fps;      // frames per second run through the detector
+    uint8_t threshold;        // per-pixel grey level change that counts as motion
+    uint8_t min_changed_pct;  // share of analysis pixels that must change, in %
+    uint8_t bg_shift;         // background learns 1/2^bg_shift of the difference per frame
+    uint16_t hold_ms;         // stay active this long after the last moving frame
+    uint8_t idle_fps;         // capture rate while still; 0 keeps full rate
+} motion_config_t;
+
+#define MOTION_CONFIG_DEFAULT() {   \
+    .analyze_fps = 5,               \
+    .threshold = 24,                \
+    .min_changed_pct = 1,           \
+    .bg_shift = 4,                  \
+    .hold_ms = 3000,                \
+    .idle_fps = 2,                  \
+}
+
+esp_err_t motion_init(const motion_config_t *config);
+
+/**
+ * Feed one captured frame. JPEG frames are decoded at 1/8 scale; grayscale,
+ * YUV422 and RGB565 frames are box-filtered by 8 on their luma. Other
+ * formats, and buffers too short for their size, are ignored. Frames beyond
+ * analyze_fps are skipped cheaply.
+ */
+void motion_process_frame(const uint8_t *buf, size_t len, frame_format_t format, uint16_t width,
+                          uint16_t height, int64_t timestamp_us);
+
+bool motion_is_active(void);
+
+/**
+ * Frame period the capture task should hold to, in microseconds.
+ * 0 means capture as fast as the sensor allows.
+ */
+int64_t motion_capture_interval_us(void);
+
+esp_err_t motion_register_cb(motion_event_cb_t cb, void *arg);
+
+/**
+ * Register GET /api/camera/motion with an existing server.
+ */
+esp_err_t motion_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
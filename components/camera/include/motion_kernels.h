@@ -0,0 +1,63 @@
+#pragma once
+
+// Pixel kernels behind motion detection. They only touch the buffers they
+// are handed, so tools/host_tests builds them as they are to replay and
+// time recorded frames.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+} motion_box_t;
+
+/**
+ * Box-filter an 8-bit grayscale image down by an integer factor.
+ * dst must hold (src_w / factor) * (src_h / factor) bytes.
+ */
+void motion_downscale_gray(const uint8_t *src, int src_w, int src_h, int factor, uint8_t *dst);
+
+/**
+ * Same as motion_downscale_gray() for YUV422 (Y U Y V byte order), using
+ * the luma bytes only.
+ */
+void motion_downscale_yuv422(const uint8_t *src, int src_w, int src_h, int factor, uint8_t *dst);
+
+/**
+ * Same as motion_downscale_gray() for RGB565 stored big-endian, as
+ * esp32-camera delivers it. Each pixel is converted to luma before
+ * averaging.
+ */
+void motion_downscale_rgb565(const uint8_t *src, int src_w, int src_h, int factor, uint8_t *dst);
+
+/**
+ * mask[i] = 0xFF where |cur[i] - bg[i]| > threshold, else 0.
+ * Returns the number of changed pixels.
+ */
+uint32_t motion_absdiff_threshold(const uint8_t *cur, const uint8_t *bg, uint8_t *mask, size_t n,
+                                  uint8_t threshold);
+
+/**
+ * Move the background towards the current frame by 1/2^shift of the
+ * difference, rounding away from zero so small differences still converge.
+ */
+void motion_update_background(uint8_t *bg, const uint8_t *cur, size_t n, int shift);
+
+/**
+ * Bounding box of the set pixels in a w x h mask, ignoring rows and
+ * columns with fewer than min_hits set pixels (isolated sensor noise).
+ * Returns false if nothing is left.
+ */
+bool motion_mask_bbox(const uint8_t *mask, int w, int h, int min_hits, motion_box_t *box);
+
+#ifdef __cplusplus
+}
+#endif
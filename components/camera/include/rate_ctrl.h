@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "frame_source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RATE_CTRL_TARGET_FPS = 0,     // keep the rate each viewer could sustain at target_fps
+    RATE_CTRL_TARGET_LATENCY,     // keep per-frame send time under target_latency_ms
+} rate_ctrl_mode_t;
+
+typedef struct {
+    rate_ctrl_mode_t mode;
+    uint16_t target_fps;
+    uint16_t target_latency_ms;
+    bool enabled;                 // false pins the current operating point
+} rate_ctrl_target_t;
+
+typedef struct {
+    int level;                    // index into the operating point ladder
+    int level_count;
+    uint16_t width;
+    uint16_t height;
+    uint8_t quality;              // sensor JPEG quality, lower is better
+    uint32_t bytes_per_sec;       // sent to all viewers together, over the last window
+    float fps;                    // frames sent per second, summed over viewers
+    float send_ms;                // mean per-frame send time
+    float send_max_ms;
+} rate_ctrl_status_t;
+
+/**
+ * Apply the starting operating point to the frame source.
+ * A sensor must be initialised at the largest frame size in the ladder.
+ */
+esp_err_t rate_ctrl_init(const frame_source_t *source);
+
+/**
+ * Report one frame sent to a viewer. Safe to call from any stream task.
+ */
+void rate_ctrl_record_frame(size_t bytes, int64_t send_us);
+
+/**
+ * Re-evaluate the operating point once per window. Called from the capture
+ * task between frames so sensor changes never race a capture.
+ */
+void rate_ctrl_tick(void);
+
+void rate_ctrl_get_target(rate_ctrl_target_t *out);
+esp_err_t rate_ctrl_set_target(const rate_ctrl_target_t *target);
+
+/**
+ * Jump to a ladder level directly. Only useful with the controller disabled.
+ */
+esp_err_t rate_ctrl_set_level(int level);
+
+void rate_ctrl_get_status(rate_ctrl_status_t *out);
+
+/**
+ * Register GET/POST /api/camera/rate with an existing server.
+ */
+esp_err_t rate_ctrl_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Register GET /api/camera/snapshot with an existing server.
+ * Snapshots are served from the capture ring, so any number of pollers
+ * cost no extra captures.
+ */
+esp_err_t snapshot_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
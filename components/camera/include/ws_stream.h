@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * /ws/camera protocol, all integers little-endian:
+ *
+ * server -> client  binary: {u32 seq, u32 size, u64 timestamp_us} + JPEG
+ * client -> server  binary: u32 seq, acknowledging every frame up to seq
+ * client -> server  text:   {"credits":n} sets the frames allowed in flight
+ *                            (1..WS_STREAM_MAX_CREDITS); anything else goes
+ *                            to the control callback
+ *
+ * The server stops sending once `credits` frames are unacknowledged and
+ * then resumes with the newest frame, so a slow client sees fewer frames
+ * rather than older ones.
+ */
+#define WS_STREAM_HEADER_SIZE    16
+#define WS_STREAM_MAX_CREDITS    8
+#define WS_STREAM_DEFAULT_CREDITS 2
+
+/**
+ * Called from the httpd task for every text message the stream doesn't
+ * consume itself; msg is NUL terminated. Keep it short.
+ */
+typedef void (*ws_stream_control_cb_t)(const char *msg, size_t len, void *arg);
+
+void ws_stream_set_control_cb(ws_stream_control_cb_t cb, void *arg);
+
+/**
+ * Register the /ws/camera WebSocket endpoint with an existing server.
+ * Needs CONFIG_HTTPD_WS_SUPPORT.
+ */
+esp_err_t ws_stream_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
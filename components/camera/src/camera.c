@@ -1,114 +1,136 @@
 #include "camera.h"
-#include "esp_camera.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
 #include "esp_system.h"
-#include "esp_heap_caps.h"
-#include "camera_pins.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "frame_ring.h"
+#include "rate_ctrl.h"
+#include "mjpeg_stream.h"
+#include "snapshot.h"
+#include "motion.h"
+#include "clip_recorder.h"
+#include "camera_stats.h"
+#include "ws_stream.h"
+#include <stdlib.h>
 
 static const char *TAG = "camera";
-static httpd_handle_t camera_httpd = NULL;
+
+#define CAPTURE_TASK_STACK 4096
+#define CAPTURE_TASK_PRIO  5
 
 /**
- * Helper function for star_camera_server
- * It captures frames from the camera and sends them as multipart JPEG images.
- * This is used to serve the camera feed over HTTP.
+ * The only place that talks to the frame source. Every frame is copied into
+ * the shared ring and the source buffer is handed straight back, so viewers
+ * never hold one of the driver's fb_count buffers and can't stall the camera.
+ * While nothing moves the task drops to the motion detector's idle rate.
  */
-static esp_err_t stream_handler(httpd_req_t *req) {
-    camera_fb_t *fb = NULL;
-    esp_err_t res = ESP_OK;
-    char part_buf[64];
-
-    static const char* _STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=frame";
-    static const char* _STREAM_BOUNDARY = "\r\n--frame\r\n";
-    static const char* _STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
-
-    res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-    if (res != ESP_OK) return res;
-
+static void capture_task(void *arg) {
+    const frame_source_t *src = (const frame_source_t *)arg;
     while (true) {
-        fb = esp_camera_fb_get();
-        if (!fb) {
+        frame_source_frame_t f;
+        int64_t wait_start = esp_timer_get_time();
+        if (src->get(src->ctx, &f) != ESP_OK) {
             ESP_LOGE(TAG, "Camera capture failed");
-            return ESP_FAIL;
-        }
-        res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
-        if (res == ESP_OK) {
-            int hlen = snprintf(part_buf, 64, _STREAM_PART, fb->len);
-            res = httpd_resp_send_chunk(req, part_buf, hlen);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
         }
-        if (res == ESP_OK) {
-            res = httpd_resp_send_chunk(req, (const char *)fb->buf, fb->len);
+        int64_t got = esp_timer_get_time();
+        int64_t ts = f.timestamp_us;
+        frame_ring_publish(f.buf, f.len, f.width, f.height, ts);
+        camera_stats_record_capture(got - wait_start, got - ts, esp_timer_get_time() - got);
+        motion_process_frame(f.buf, f.len, f.format, f.width, f.height, ts);
+        src->put(src->ctx, &f);
+
+        rate_ctrl_tick();
+
+        int64_t interval = motion_capture_interval_us();
+        if (interval > 0) {
+            int64_t wait_us = ts + interval - esp_timer_get_time();
+            if (wait_us > 0) vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
         }
-        esp_camera_fb_return(fb);
-        if (res != ESP_OK) break;
     }
-    return res;
 }
 
 /**
- * Initializes the HTTP server and registers the stream handler.
- * It should start serving MJPEG stream from the camera.
+ * Registers the camera routes on the shared web server.
  */
-void start_camera_server(void) {
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.server_port = 80;
+esp_err_t camera_register_handlers(httpd_handle_t server) {
+    esp_err_t res = mjpeg_stream_register_handlers(server);
+    if (res == ESP_OK) res = snapshot_register_handlers(server);
+    if (res == ESP_OK) res = rate_ctrl_register_handlers(server);
+    if (res == ESP_OK) res = motion_register_handlers(server);
+    if (res == ESP_OK) res = clip_recorder_register_handlers(server);
+    if (res == ESP_OK) res = camera_stats_register_handlers(server);
+    if (res == ESP_OK) res = ws_stream_register_handlers(server);
+    if (res == ESP_OK) ESP_LOGI(TAG, "Camera stream registered at /stream");
+    return res;
+}
+
+
+esp_err_t camera_start(const frame_source_t *source) {
+    if (!source) return ESP_ERR_INVALID_ARG;
 
-    if (httpd_start(&camera_httpd, &config) == ESP_OK) {
-        httpd_uri_t stream_uri = {
-            .uri       = "/",
-            .method    = HTTP_GET,
-            .handler   = stream_handler,
-            .user_ctx  = NULL
-        };
-        httpd_register_uri_handler(camera_httpd, &stream_uri);
-        ESP_LOGI(TAG, "Camera server started");
+    rate_ctrl_init(source);
+    motion_init(NULL);
+
+    esp_err_t res = frame_ring_init();
+    if (res != ESP_OK) return res;
+    // Optional: without PSRAM there is simply no clip history
+    if (clip_recorder_init(NULL) != ESP_OK) ESP_LOGW(TAG, "Clip recorder disabled");
+    if (xTaskCreate(capture_task, "cam_capture", CAPTURE_TASK_STACK, (void *)source, CAPTURE_TASK_PRIO,
+                    NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
     }
+
+    ESP_LOGI(TAG, "Camera initialized (%s)", source->name);
+    return ESP_OK;
 }
 
+#if CONFIG_IDF_TARGET_LINUX
+#define REPLAY_DEFAULT_FPS 15
+#define REPLAY_MAX_FPS     120
 
 /**
- * Initialize the camera hardware with the specified configuration (aka ports).
+ * PETBOT_REPLAY_FPS if it is a whole number in 1..REPLAY_MAX_FPS, else the
+ * default with a warning rather than an abort in frame_source_replay_init().
  */
-void init_camera(void) {
-    camera_config_t config;
-    config.ledc_channel = LEDC_CHANNEL_0;
-    config.ledc_timer = LEDC_TIMER_0;
-    config.pin_d0 = Y2_GPIO_NUM;
-    config.pin_d1 = Y3_GPIO_NUM;
-    config.pin_d2 = Y4_GPIO_NUM;
-    config.pin_d3 = Y5_GPIO_NUM;
-    config.pin_d4 = Y6_GPIO_NUM;
-    config.pin_d5 = Y7_GPIO_NUM;
-    config.pin_d6 = Y8_GPIO_NUM;
-    config.pin_d7 = Y9_GPIO_NUM;
-    config.pin_xclk = XCLK_GPIO_NUM;
-    config.pin_pclk = PCLK_GPIO_NUM;
-    config.pin_vsync = VSYNC_GPIO_NUM;
-    config.pin_href = HREF_GPIO_NUM;
-    config.pin_sccb_sda = SIOD_GPIO_NUM;
-    config.pin_sccb_scl = SIOC_GPIO_NUM;
-    config.pin_pwdn = PWDN_GPIO_NUM;
-    config.pin_reset = RESET_GPIO_NUM;
-    config.xclk_freq_hz = 10000000;
-    config.frame_size = FRAMESIZE_96X96; // 320×240
-    config.jpeg_quality = 30; // lower quality, faster, to increase, make 15 or 10
-    config.pixel_format = PIXFORMAT_JPEG;
-    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
-    config.fb_location = CAMERA_FB_IN_PSRAM;
-    config.fb_count = 2;
-
-    config.jpeg_quality = 10;
-    config.fb_count = 2;
-    config.grab_mode = CAMERA_GRAB_LATEST;
+static uint16_t replay_fps(void) {
+    const char *s = getenv("PETBOT_REPLAY_FPS");
+    if (!s) return REPLAY_DEFAULT_FPS;
 
+    char *end;
+    long fps = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || fps < 1 || fps > REPLAY_MAX_FPS) {
+        ESP_LOGW(TAG, "PETBOT_REPLAY_FPS=\"%s\" is not 1..%d, using %d", s, REPLAY_MAX_FPS, REPLAY_DEFAULT_FPS);
+        return REPLAY_DEFAULT_FPS;
+    }
+    return (uint16_t)fps;
+}
 
-
-    ESP_ERROR_CHECK(esp_camera_init(&config));
-    sensor_t * s = esp_camera_sensor_get();
-    s->set_vflip(s, 1);
-    s->set_brightness(s, 1);
-    s->set_saturation(s, 0);
-
-    ESP_LOGI(TAG, "Camera initialized");
+/**
+ * No sensor on the host: replay PETBOT_REPLAY_DIR (default ./frames) at
+ * PETBOT_REPLAY_FPS (default 15).
+ */
+esp_err_t init_camera(void) {
+    const char *dir = getenv("PETBOT_REPLAY_DIR");
+    frame_source_replay_config_t cfg = {
+        .dir = dir ? dir : "./frames",
+        .fps = replay_fps(),
+        .loop = true,
+    };
+    const frame_source_t *source = NULL;
+    esp_err_t res = frame_source_replay_init(&cfg, &source);
+    if (res != ESP_OK) return res;
+    return camera_start(source);
+}
+#else
+esp_err_t init_camera(void) {
+    const frame_source_t *source = NULL;
+    esp_err_t res = frame_source_sensor_init(&source);
+    if (res != ESP_OK) return res;
+    return camera_start(source);
 }
+#endif
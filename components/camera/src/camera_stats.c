@@ -0,0 +1,254 @@
+#include "camera_stats.h"
+#include "camera.h"
+#include "frame_ring.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HIST_BASE_SHIFT 8       // bucket 0 ends at 2^8 us
+#define FPS_WINDOW_US   1000000
+
+typedef struct {
+    int64_t start_us;
+    uint32_t frames;
+    float fps;                  // over the last complete window
+} fps_meter_t;
+
+typedef struct {
+    bool active;
+    int fd;
+    const char *mode;
+    int64_t opened_us;
+    uint32_t frames;
+    uint32_t skipped;
+    fps_meter_t fps;
+    camera_hist_t queue;
+    camera_hist_t send;
+    camera_hist_t total;
+    camera_hist_t ack;
+} client_stats_t;
+
+static struct {
+    int xclk_freq_hz;
+    int fb_count;
+    int grab_mode;
+} driver_cfg;
+
+// Everything is static and updated under one spinlock; recording a frame
+// is a handful of increments, never an allocation.
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t captured = 0;
+static fps_meter_t capture_fps;
+static camera_hist_t fb_wait, readout, copy;
+static client_stats_t clients[CAMERA_STATS_MAX_CLIENTS];
+
+static void hist_add(camera_hist_t *h, int64_t us) {
+    if (us < 0) us = 0;
+    uint32_t v = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    uint32_t scaled = v >> HIST_BASE_SHIFT;
+    int b = scaled ? 32 - __builtin_clz(scaled) : 0;
+    if (b >= CAMERA_STATS_BUCKETS) b = CAMERA_STATS_BUCKETS - 1;
+    h->buckets[b]++;
+    h->count++;
+    h->sum_us += v;
+    if (v > h->max_us) h->max_us = v;
+}
+
+static void fps_tick(fps_meter_t *m, int64_t now) {
+    if (!m->start_us) m->start_us = now;
+    m->frames++;
+    int64_t elapsed = now - m->start_us;
+    if (elapsed >= FPS_WINDOW_US) {
+        m->fps = m->frames * 1000000.0f / elapsed;
+        m->frames = 0;
+        m->start_us = now;
+    }
+}
+
+void camera_stats_init(int xclk_freq_hz, int fb_count, int grab_mode) {
+    driver_cfg.xclk_freq_hz = xclk_freq_hz;
+    driver_cfg.fb_count = fb_count;
+    driver_cfg.grab_mode = grab_mode;
+}
+
+void camera_stats_record_capture(int64_t wait_us, int64_t readout_us, int64_t copy_us) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_mux);
+    captured++;
+    fps_tick(&capture_fps, now);
+    hist_add(&fb_wait, wait_us);
+    hist_add(&readout, readout_us);
+    hist_add(&copy, copy_us);
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+int camera_stats_client_open(int fd, const char *mode) {
+    int id = -1;
+    portENTER_CRITICAL(&stats_mux);
+    for (int i = 0; i < CAMERA_STATS_MAX_CLIENTS; i++) {
+        if (!clients[i].active) {
+            memset(&clients[i], 0, sizeof(clients[i]));
+            clients[i].active = true;
+            clients[i].fd = fd;
+            clients[i].mode = mode;
+            clients[i].opened_us = esp_timer_get_time();
+            id = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&stats_mux);
+    return id;
+}
+
+void camera_stats_client_frame(int id, int64_t queue_us, int64_t send_us, uint32_t skipped) {
+    if (id < 0 || id >= CAMERA_STATS_MAX_CLIENTS) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_mux);
+    client_stats_t *c = &clients[id];
+    c->frames++;
+    c->skipped += skipped;
+    fps_tick(&c->fps, now);
+    hist_add(&c->queue, queue_us);
+    hist_add(&c->send, send_us);
+    hist_add(&c->total, queue_us + send_us);
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void camera_stats_client_ack(int id, int64_t latency_us) {
+    if (id < 0 || id >= CAMERA_STATS_MAX_CLIENTS) return;
+    portENTER_CRITICAL(&stats_mux);
+    hist_add(&clients[id].ack, latency_us);
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void camera_stats_client_close(int id) {
+    if (id < 0 || id >= CAMERA_STATS_MAX_CLIENTS) return;
+    portENTER_CRITICAL(&stats_mux);
+    clients[id].active = false;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+/**
+ * Percentile estimate: upper edge of the bucket the rank falls into.
+ */
+static double hist_percentile_ms(const camera_hist_t *h, uint32_t pct) {
+    if (!h->count) return 0;
+    uint32_t rank = (h->count * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < CAMERA_STATS_BUCKETS - 1; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) return (1u << (b + HIST_BASE_SHIFT)) / 1000.0;
+    }
+    return h->max_us / 1000.0;
+}
+
+static void add_hist(cJSON *parent, const char *name, const camera_hist_t *h) {
+    cJSON *o = cJSON_AddObjectToObject(parent, name);
+    cJSON_AddNumberToObject(o, "count", h->count);
+    cJSON_AddNumberToObject(o, "mean_ms", h->count ? h->sum_us / 1000.0 / h->count : 0);
+    cJSON_AddNumberToObject(o, "p50_ms", hist_percentile_ms(h, 50));
+    cJSON_AddNumberToObject(o, "p95_ms", hist_percentile_ms(h, 95));
+    cJSON_AddNumberToObject(o, "max_ms", h->max_us / 1000.0);
+    int n = CAMERA_STATS_BUCKETS;
+    while (n > 0 && !h->buckets[n - 1]) n--;
+    cJSON *b = cJSON_AddArrayToObject(o, "buckets");
+    for (int i = 0; i < n; i++) cJSON_AddItemToArray(b, cJSON_CreateNumber(h->buckets[i]));
+}
+
+/**
+ * GET /api/camera/stats ->
+ * {config:{xclk_hz,fb_count,grab_mode}, bucket_us:[...],
+ *  capture:{frames,fps,ring_dropped,fb_wait:{...},readout:{...},copy:{...}},
+ *  clients:[{fd,mode,age_s,frames,skipped,fps,queue:{...},send:{...},total:{...},ack:{...}}]}
+ * Histograms are {count,mean_ms,p50_ms,p95_ms,max_ms,buckets:[...]}.
+ */
+static esp_err_t h_stats(httpd_req_t *req) {
+    // Snapshot first so the JSON building runs outside the critical section
+    static client_stats_t snap[CAMERA_STATS_MAX_CLIENTS];
+    camera_hist_t w, r, c;
+    portENTER_CRITICAL(&stats_mux);
+    uint32_t frames = captured;
+    float fps = capture_fps.fps;
+    w = fb_wait;
+    r = readout;
+    c = copy;
+    memcpy(snap, clients, sizeof(snap));
+    portEXIT_CRITICAL(&stats_mux);
+
+    cJSON *o = cJSON_CreateObject();
+    cJSON *cfg = cJSON_AddObjectToObject(o, "config");
+    cJSON_AddNumberToObject(cfg, "xclk_hz", driver_cfg.xclk_freq_hz);
+    cJSON_AddNumberToObject(cfg, "fb_count", driver_cfg.fb_count);
+    cJSON_AddStringToObject(cfg, "grab_mode", driver_cfg.grab_mode ? "latest" : "when_empty");
+
+    cJSON *edges = cJSON_AddArrayToObject(o, "bucket_us");
+    for (int i = 0; i < CAMERA_STATS_BUCKETS; i++) {
+        cJSON_AddItemToArray(edges, cJSON_CreateNumber(i ? 1u << (i + HIST_BASE_SHIFT - 1) : 0));
+    }
+
+    cJSON *cap = cJSON_AddObjectToObject(o, "capture");
+    cJSON_AddNumberToObject(cap, "frames", frames);
+    cJSON_AddNumberToObject(cap, "fps", fps);
+    cJSON_AddNumberToObject(cap, "ring_dropped", frame_ring_dropped());
+    add_hist(cap, "fb_wait", &w);
+    add_hist(cap, "readout", &r);
+    add_hist(cap, "copy", &c);
+
+    int64_t now = esp_timer_get_time();
+    cJSON *arr = cJSON_AddArrayToObject(o, "clients");
+    for (int i = 0; i < CAMERA_STATS_MAX_CLIENTS; i++) {
+        const client_stats_t *s = &snap[i];
+        if (!s->active) continue;
+        cJSON *j = cJSON_CreateObject();
+        cJSON_AddNumberToObject(j, "fd", s->fd);
+        cJSON_AddStringToObject(j, "mode", s->mode);
+        cJSON_AddNumberToObject(j, "age_s", (now - s->opened_us) / 1000000);
+        cJSON_AddNumberToObject(j, "frames", s->frames);
+        cJSON_AddNumberToObject(j, "skipped", s->skipped);
+        cJSON_AddNumberToObject(j, "fps", s->fps.fps);
+        add_hist(j, "queue", &s->queue);
+        add_hist(j, "send", &s->send);
+        add_hist(j, "total", &s->total);
+        if (s->ack.count) add_hist(j, "ack", &s->ack);
+        cJSON_AddItemToArray(arr, j);
+    }
+
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+// DELETE /api/camera/stats -> clear histograms, e.g. after changing a setting
+static esp_err_t h_stats_reset(httpd_req_t *req) {
+    portENTER_CRITICAL(&stats_mux);
+    captured = 0;
+    memset(&capture_fps, 0, sizeof(capture_fps));
+    memset(&fb_wait, 0, sizeof(fb_wait));
+    memset(&readout, 0, sizeof(readout));
+    memset(&copy, 0, sizeof(copy));
+    for (int i = 0; i < CAMERA_STATS_MAX_CLIENTS; i++) {
+        client_stats_t *c = &clients[i];
+        c->frames = c->skipped = 0;
+        memset(&c->fps, 0, sizeof(c->fps));
+        memset(&c->queue, 0, sizeof(c->queue));
+        memset(&c->send, 0, sizeof(c->send));
+        memset(&c->total, 0, sizeof(c->total));
+        memset(&c->ack, 0, sizeof(c->ack));
+    }
+    portEXIT_CRITICAL(&stats_mux);
+    return httpd_resp_sendstr(req, "OK");
+}
+
+esp_err_t camera_stats_register_handlers(httpd_handle_t server) {
+    const httpd_uri_t get_uri = {.uri = "/api/camera/stats", .method = HTTP_GET, .handler = h_stats};
+    const httpd_uri_t del_uri = {.uri = "/api/camera/stats", .method = HTTP_DELETE, .handler = h_stats_reset};
+    esp_err_t res = httpd_register_uri_handler(server, &get_uri);
+    if (res == ESP_OK) res = httpd_register_uri_handler(server, &del_uri);
+    return res;
+}
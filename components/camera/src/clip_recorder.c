@@ -0,0 +1,456 @@
+#include "clip_recorder.h"
+#include "frame_ring.h"
+#include "motion.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "clip";
+
+#define RECORDER_TASK_STACK 3072
+#define RECORDER_TASK_PRIO  3      // below the stream workers; drops frames, never delays them
+
+// Downloads run on their own task like /stream viewers
+#define CLIP_MAX_EXPORTS    1
+#define EXPORT_TASK_STACK   4096
+#define EXPORT_TASK_PRIO    4
+
+// Index entries are 12 bytes, so this costs ~7 KB of internal RAM and
+// covers 20 s at 30 fps.
+#define CLIP_INDEX_MAX 600
+
+typedef struct {
+    uint32_t offset;    // into the arena
+    uint32_t len;
+    uint32_t ts_ms;     // capture time
+} clip_entry_t;
+
+static clip_recorder_config_t cfg;
+static uint8_t *arena = NULL;
+static SemaphoreHandle_t lock = NULL;
+static SemaphoreHandle_t export_slots = NULL;
+
+// Index ring, oldest at head. Guarded by lock.
+static clip_entry_t entries[CLIP_INDEX_MAX];
+static uint32_t head = 0;
+static uint32_t count = 0;
+static uint32_t write_off = 0;
+static uint32_t window_bytes = 0;
+static uint16_t frame_w = 0, frame_h = 0;
+
+static volatile bool frozen = false;
+static volatile int64_t freeze_at_us = 0;   // pending trigger, 0 if none
+static int exporting = 0;                   // downloads in progress; resume waits for them
+static bool resume_pending = false;
+static uint32_t dropped = 0;
+
+static inline clip_entry_t *entry_at(uint32_t i) {
+    return &entries[(head + i) % CLIP_INDEX_MAX];
+}
+
+static void pop_oldest(void) {
+    window_bytes -= entries[head].len;
+    head = (head + 1) % CLIP_INDEX_MAX;
+    count--;
+}
+
+static bool overlaps(const clip_entry_t *e, uint32_t start, uint32_t end) {
+    return e->offset < end && start < e->offset + e->len;
+}
+
+/**
+ * Copy one frame into the arena, evicting whatever it overwrites and
+ * anything older than the window. Frames are never split across the end
+ * of the arena; the unused tail is simply skipped.
+ */
+static void store_frame(const camera_frame_t *f) {
+    if (f->len > cfg.budget_bytes) {
+        dropped++;
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    // recorder_task checked frozen without the lock; an export may have
+    // frozen the window since, and evicting now would pull frames out from
+    // under it
+    if (frozen || exporting) {
+        xSemaphoreGive(lock);
+        return;
+    }
+
+    // A new frame size would make an unplayable AVI; start a fresh window
+    if (f->width != frame_w || f->height != frame_h) {
+        head = count = write_off = window_bytes = 0;
+        frame_w = f->width;
+        frame_h = f->height;
+    }
+
+    uint32_t off = write_off;
+    bool wrapped = off + f->len > cfg.budget_bytes;
+    if (wrapped) off = 0;
+
+    // Oldest entries sit just past write_off, so they are the ones in the way
+    while (count > 0) {
+        const clip_entry_t *e = entry_at(0);
+        bool in_way = overlaps(e, off, off + f->len) ||
+                      (wrapped && overlaps(e, write_off, cfg.budget_bytes));
+        if (!in_way && count < CLIP_INDEX_MAX) break;
+        pop_oldest();
+    }
+
+    uint32_t ts_ms = f->timestamp_us / 1000;
+    while (count > 0 && ts_ms - entry_at(0)->ts_ms > cfg.window_s * 1000u) pop_oldest();
+
+    xSemaphoreGive(lock);
+
+    // Nothing else reads or writes [off, off + len) now, so copy unlocked
+    memcpy(arena + off, f->buf, f->len);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    clip_entry_t *e = &entries[(head + count) % CLIP_INDEX_MAX];
+    e->offset = off;
+    e->len = f->len;
+    e->ts_ms = ts_ms;
+    count++;
+    window_bytes += f->len;
+    write_off = off + f->len;
+    xSemaphoreGive(lock);
+}
+
+/**
+ * Reads the capture ring like a viewer. Whenever the PSRAM copy can't keep
+ * up, the ring hands over the newest frame and the gap is counted as drops.
+ */
+static void recorder_task(void *arg) {
+    uint32_t last_seq = 0;
+    while (true) {
+        camera_frame_t *f = frame_ring_acquire(last_seq, portMAX_DELAY);
+        if (!f) continue;
+
+        if (freeze_at_us && f->timestamp_us >= freeze_at_us) {
+            freeze_at_us = 0;
+            frozen = true;
+            ESP_LOGI(TAG, "Window frozen: %lu frames", (unsigned long)count);
+        }
+        if (!frozen) {
+            if (last_seq && f->seq > last_seq + 1) dropped += f->seq - last_seq - 1;
+            store_frame(f);
+        }
+        last_seq = f->seq;
+        frame_ring_release(f);
+    }
+}
+
+static void on_motion(const motion_event_t *event, void *arg) {
+    if (event->type == MOTION_EVENT_START) clip_recorder_trigger();
+}
+
+esp_err_t clip_recorder_init(const clip_recorder_config_t *config) {
+    clip_recorder_config_t defaults = CLIP_RECORDER_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.budget_bytes == 0 || cfg.window_s == 0) return ESP_ERR_INVALID_ARG;
+
+    arena = heap_caps_malloc(cfg.budget_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!arena) {
+        ESP_LOGE(TAG, "No PSRAM for a %u byte clip buffer", (unsigned)cfg.budget_bytes);
+        return ESP_ERR_NO_MEM;
+    }
+    lock = xSemaphoreCreateMutex();
+    if (!lock) return ESP_ERR_NO_MEM;
+
+    if (cfg.freeze_on_motion) motion_register_cb(on_motion, NULL);
+
+    xTaskCreate(recorder_task, "clip_rec", RECORDER_TASK_STACK, NULL, RECORDER_TASK_PRIO, NULL);
+    ESP_LOGI(TAG, "Recorder ready: %u KB, %u s window", (unsigned)(cfg.budget_bytes / 1024), cfg.window_s);
+    return ESP_OK;
+}
+
+void clip_recorder_trigger(void) {
+    if (!frozen && !freeze_at_us) {
+        freeze_at_us = esp_timer_get_time() + (int64_t)cfg.post_roll_ms * 1000;
+    }
+}
+
+void clip_recorder_freeze(void) {
+    freeze_at_us = 0;
+    frozen = true;
+}
+
+void clip_recorder_resume(void) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (exporting) {
+        resume_pending = true;
+    } else {
+        frozen = false;
+    }
+    xSemaphoreGive(lock);
+}
+
+void clip_recorder_get_stats(clip_recorder_stats_t *out) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    out->frozen = frozen;
+    out->frames = count;
+    out->bytes = window_bytes;
+    out->duration_ms = count > 1 ? entry_at(count - 1)->ts_ms - entry_at(0)->ts_ms : 0;
+    out->dropped = dropped;
+    out->budget_bytes = cfg.budget_bytes;
+    out->width = frame_w;
+    out->height = frame_h;
+    xSemaphoreGive(lock);
+}
+
+// ======= MJPEG-in-AVI export =======
+
+#define AVI_HDRL_SIZE  200      // complete 'hdrl' LIST chunk
+#define AVI_HEAD_SIZE  (12 + AVI_HDRL_SIZE + 12)
+#define AVIF_HASINDEX  0x10
+#define AVIIF_KEYFRAME 0x10
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *putcc(uint8_t *p, const char *fourcc) {
+    memcpy(p, fourcc, 4);
+    return p + 4;
+}
+
+static inline uint32_t padded(uint32_t len) {
+    return (len + 1) & ~1u;
+}
+
+/**
+ * RIFF header, hdrl list (avih + one MJPG video stream) and the start of
+ * the movi list. Returns the number of bytes written (AVI_HEAD_SIZE).
+ */
+static size_t avi_head(uint8_t *buf, uint32_t frames, uint32_t movi_size, uint32_t us_per_frame,
+                       uint32_t max_frame, uint16_t w, uint16_t h) {
+    uint32_t riff_size = 4 + AVI_HDRL_SIZE + 8 + movi_size + 8 + 16 * frames;
+    uint32_t fps_x1000 = us_per_frame ? 1000000000u / us_per_frame : 1000;
+    uint8_t *p = buf;
+
+    p = putcc(p, "RIFF"); p = put32(p, riff_size); p = putcc(p, "AVI ");
+
+    p = putcc(p, "LIST"); p = put32(p, AVI_HDRL_SIZE - 8); p = putcc(p, "hdrl");
+    p = putcc(p, "avih"); p = put32(p, 56);
+    p = put32(p, us_per_frame);
+    p = put32(p, 0);                    // max bytes per sec
+    p = put32(p, 0);                    // padding granularity
+    p = put32(p, AVIF_HASINDEX);
+    p = put32(p, frames);
+    p = put32(p, 0);                    // initial frames
+    p = put32(p, 1);                    // streams
+    p = put32(p, max_frame);            // suggested buffer size
+    p = put32(p, w);
+    p = put32(p, h);
+    memset(p, 0, 16); p += 16;          // reserved
+
+    p = putcc(p, "LIST"); p = put32(p, 4 + 64 + 48); p = putcc(p, "strl");
+    p = putcc(p, "strh"); p = put32(p, 56);
+    p = putcc(p, "vids"); p = putcc(p, "MJPG");
+    p = put32(p, 0);                    // flags
+    p = put16(p, 0); p = put16(p, 0);   // priority, language
+    p = put32(p, 0);                    // initial frames
+    p = put32(p, 1000);                 // scale
+    p = put32(p, fps_x1000);            // rate: rate / scale = fps
+    p = put32(p, 0);                    // start
+    p = put32(p, frames);               // length
+    p = put32(p, max_frame);
+    p = put32(p, 0xFFFFFFFF);           // quality: default
+    p = put32(p, 0);                    // sample size
+    p = put16(p, 0); p = put16(p, 0); p = put16(p, w); p = put16(p, h);
+
+    p = putcc(p, "strf"); p = put32(p, 40);
+    p = put32(p, 40);                   // BITMAPINFOHEADER size
+    p = put32(p, w);
+    p = put32(p, h);
+    p = put16(p, 1);                    // planes
+    p = put16(p, 24);                   // bit count
+    p = putcc(p, "MJPG");
+    p = put32(p, (uint32_t)w * h * 3);
+    memset(p, 0, 16); p += 16;          // ppm x/y, colours used/important
+
+    p = putcc(p, "LIST"); p = put32(p, movi_size); p = putcc(p, "movi");
+    return p - buf;
+}
+
+/**
+ * Sends the frozen window as an AVI, freezing it first if needed.
+ */
+static esp_err_t export_clip(httpd_req_t *req) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool froze_here = !frozen;
+    frozen = true;
+    freeze_at_us = 0;
+    exporting++;
+    uint32_t n = count;
+    uint16_t w = frame_w, h = frame_h;
+    clip_entry_t *list = n ? malloc(n * sizeof(clip_entry_t)) : NULL;
+    for (uint32_t i = 0; list && i < n; i++) list[i] = *entry_at(i);
+    xSemaphoreGive(lock);
+
+    esp_err_t res = ESP_OK;
+    if (!list) {
+        res = httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "no frames recorded");
+        goto done;
+    }
+
+    uint32_t movi_size = 4, max_frame = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        movi_size += 8 + padded(list[i].len);
+        if (list[i].len > max_frame) max_frame = list[i].len;
+    }
+    uint32_t span_ms = list[n - 1].ts_ms - list[0].ts_ms;
+    uint32_t us_per_frame = n > 1 && span_ms ? span_ms * 1000 / (n - 1) : 100000;
+
+    uint8_t head_buf[AVI_HEAD_SIZE];
+    size_t head_len = avi_head(head_buf, n, movi_size, us_per_frame, max_frame, w, h);
+
+    httpd_resp_set_type(req, "video/avi");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"petbot-clip.avi\"");
+    res = httpd_resp_send_chunk(req, (const char *)head_buf, head_len);
+
+    // Frames go straight from the arena; offsets in idx1 are relative to "movi"
+    static const uint8_t pad = 0;
+    for (uint32_t i = 0; i < n && res == ESP_OK; i++) {
+        uint8_t ck[8];
+        put32(putcc(ck, "00dc"), list[i].len);
+        res = httpd_resp_send_chunk(req, (const char *)ck, sizeof(ck));
+        if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char *)arena + list[i].offset, list[i].len);
+        if (res == ESP_OK && (list[i].len & 1)) res = httpd_resp_send_chunk(req, (const char *)&pad, 1);
+    }
+
+    if (res == ESP_OK) {
+        uint8_t idx[16 * 16];
+        uint8_t *p = putcc(idx, "idx1");
+        p = put32(p, 16 * n);
+        res = httpd_resp_send_chunk(req, (const char *)idx, p - idx);
+
+        uint32_t chunk_off = 4;
+        for (uint32_t i = 0; i < n && res == ESP_OK;) {
+            p = idx;
+            for (int k = 0; k < 16 && i < n; k++, i++) {
+                p = putcc(p, "00dc");
+                p = put32(p, AVIIF_KEYFRAME);
+                p = put32(p, chunk_off);
+                p = put32(p, list[i].len);
+                chunk_off += 8 + padded(list[i].len);
+            }
+            res = httpd_resp_send_chunk(req, (const char *)idx, p - idx);
+        }
+    }
+    if (res == ESP_OK) res = httpd_resp_send_chunk(req, NULL, 0);
+    ESP_LOGI(TAG, "Exported %lu frames (%ux%u, %lu ms)", (unsigned long)n, w, h, (unsigned long)span_ms);
+
+done:
+    free(list);
+    xSemaphoreTake(lock, portMAX_DELAY);
+    exporting--;
+    // An on-demand export resumes recording; an event-frozen clip stays
+    // until someone deletes it.
+    if (!exporting && (froze_here || resume_pending)) {
+        frozen = false;
+        resume_pending = false;
+    }
+    xSemaphoreGive(lock);
+    return res;
+}
+
+/**
+ * A download can take seconds on a slow link; it runs here on the async
+ * copy of the request rather than on the server's single worker.
+ */
+static void export_worker(void *arg) {
+    httpd_req_t *req = (httpd_req_t *)arg;
+    export_clip(req);
+    httpd_req_async_handler_complete(req);
+    xSemaphoreGive(export_slots);
+    vTaskDelete(NULL);
+}
+
+// GET /api/camera/clip -> video/avi of the frozen window (freezes it if needed)
+static esp_err_t h_clip(httpd_req_t *req) {
+    if (xSemaphoreTake(export_slots, 0) != pdTRUE) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Too many downloads");
+    }
+
+    httpd_req_t *async_req = NULL;
+    esp_err_t res = httpd_req_async_handler_begin(req, &async_req);
+    if (res != ESP_OK) {
+        xSemaphoreGive(export_slots);
+        return res;
+    }
+    if (xTaskCreate(export_worker, "clip_export", EXPORT_TASK_STACK, async_req, EXPORT_TASK_PRIO,
+                    NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start clip export");
+        httpd_req_async_handler_complete(async_req);
+        xSemaphoreGive(export_slots);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// DELETE /api/camera/clip -> discard a frozen window and record again
+static esp_err_t h_clip_delete(httpd_req_t *req) {
+    clip_recorder_resume();
+    return httpd_resp_sendstr(req, "OK");
+}
+
+// GET /api/camera/clip/status -> {frozen, frames, bytes, duration_ms, dropped, budget, width, height}
+static esp_err_t h_clip_status(httpd_req_t *req) {
+    clip_recorder_stats_t st;
+    clip_recorder_get_stats(&st);
+
+    cJSON *o = cJSON_CreateObject();
+    cJSON_AddBoolToObject(o, "frozen", st.frozen);
+    cJSON_AddNumberToObject(o, "frames", st.frames);
+    cJSON_AddNumberToObject(o, "bytes", st.bytes);
+    cJSON_AddNumberToObject(o, "duration_ms", st.duration_ms);
+    cJSON_AddNumberToObject(o, "dropped", st.dropped);
+    cJSON_AddNumberToObject(o, "budget", st.budget_bytes);
+    cJSON_AddNumberToObject(o, "width", st.width);
+    cJSON_AddNumberToObject(o, "height", st.height);
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+esp_err_t clip_recorder_register_handlers(httpd_handle_t server) {
+    if (!arena) return ESP_OK;   // recorder disabled (no PSRAM)
+    if (!export_slots) {
+        export_slots = xSemaphoreCreateCounting(CLIP_MAX_EXPORTS, CLIP_MAX_EXPORTS);
+        if (!export_slots) return ESP_ERR_NO_MEM;
+    }
+
+    const httpd_uri_t routes[] = {
+        {.uri = "/api/camera/clip", .method = HTTP_GET, .handler = h_clip},
+        {.uri = "/api/camera/clip", .method = HTTP_DELETE, .handler = h_clip_delete},
+        {.uri = "/api/camera/clip/status", .method = HTTP_GET, .handler = h_clip_status},
+    };
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); ++i) {
+        esp_err_t res = httpd_register_uri_handler(server, &routes[i]);
+        if (res != ESP_OK) return res;
+    }
+    return ESP_OK;
+}
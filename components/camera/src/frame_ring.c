@@ -0,0 +1,128 @@
+#include "frame_ring.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "frame_ring";
+
+// Publishing seq N sets the bit for N's parity and clears the other one, so a
+// reader that saw seq N-1 and waits on N's bit still wakes if the publish
+// happened between its check and its wait.
+#define FRAME_EVEN_BIT BIT0
+#define FRAME_ODD_BIT  BIT1
+#define SEQ_BIT(seq)   (((seq) & 1) ? FRAME_ODD_BIT : FRAME_EVEN_BIT)
+
+// Upper bound on a single wait so a reader that misses two publishes in a row
+// re-checks the ring instead of sleeping for its whole timeout.
+#define WAIT_SLICE pdMS_TO_TICKS(50)
+
+static camera_frame_t slots[FRAME_RING_SLOTS];
+static camera_frame_t *latest = NULL;
+static uint32_t next_seq = 0;
+static uint32_t dropped = 0;
+static SemaphoreHandle_t lock = NULL;
+static EventGroupHandle_t events = NULL;
+
+/**
+ * Make sure a slot can hold len bytes. Buffers prefer PSRAM and are rounded
+ * up to 4 KB so small changes in JPEG size don't reallocate every frame.
+ */
+static bool slot_reserve(camera_frame_t *f, size_t len) {
+    if (len <= f->cap) return true;
+
+    size_t cap = (len + 4095) & ~(size_t)4095;
+    uint8_t *buf = heap_caps_realloc(f->buf, cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) buf = heap_caps_realloc(f->buf, cap, MALLOC_CAP_8BIT);
+    if (!buf) return false;
+
+    f->buf = buf;
+    f->cap = cap;
+    return true;
+}
+
+esp_err_t frame_ring_init(void) {
+    if (lock) return ESP_OK;
+
+    lock = xSemaphoreCreateMutex();
+    events = xEventGroupCreate();
+    if (!lock || !events) return ESP_ERR_NO_MEM;
+
+    memset(slots, 0, sizeof(slots));
+    return ESP_OK;
+}
+
+esp_err_t frame_ring_publish(const uint8_t *jpeg, size_t len, uint16_t width, uint16_t height,
+                             int64_t timestamp_us) {
+    // Readers only ever take a reference to `latest`, so any other slot with
+    // no references is ours to overwrite without holding the lock.
+    camera_frame_t *slot = NULL;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+        if (&slots[i] != latest && slots[i].refs == 0) {
+            slot = &slots[i];
+            break;
+        }
+    }
+    xSemaphoreGive(lock);
+
+    if (!slot) {
+        dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    if (!slot_reserve(slot, len)) {
+        ESP_LOGW(TAG, "No memory for %u byte frame", (unsigned)len);
+        dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(slot->buf, jpeg, len);
+    slot->len = len;
+    slot->width = width;
+    slot->height = height;
+    slot->timestamp_us = timestamp_us;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    slot->seq = ++next_seq;
+    latest = slot;
+    xSemaphoreGive(lock);
+
+    xEventGroupClearBits(events, SEQ_BIT(slot->seq + 1));
+    xEventGroupSetBits(events, SEQ_BIT(slot->seq));
+    return ESP_OK;
+}
+
+camera_frame_t *frame_ring_acquire(uint32_t after_seq, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+
+    while (true) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+        camera_frame_t *f = latest;
+        uint32_t seen = f ? f->seq : 0;
+        if (f && seen > after_seq) {
+            f->refs++;
+            xSemaphoreGive(lock);
+            return f;
+        }
+        xSemaphoreGive(lock);
+
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= timeout) return NULL;
+
+        TickType_t wait = timeout - waited;
+        if (wait > WAIT_SLICE) wait = WAIT_SLICE;
+        xEventGroupWaitBits(events, SEQ_BIT(seen + 1), pdFALSE, pdFALSE, wait);
+    }
+}
+
+void frame_ring_release(camera_frame_t *frame) {
+    if (!frame) return;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (frame->refs > 0) frame->refs--;
+    xSemaphoreGive(lock);
+}
+
+uint32_t frame_ring_dropped(void) {
+    return dropped;
+}
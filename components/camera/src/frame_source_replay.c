@@ -0,0 +1,178 @@
+#include "frame_source.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "cam_replay";
+
+#define REPLAY_PATH_MAX 256
+
+typedef struct {
+    frame_source_replay_config_t cfg;
+    char **files;
+    int file_count;
+    int next;
+    uint8_t *buf;
+    size_t cap;
+    int64_t period_us;
+    int64_t due_us;
+} replay_t;
+
+static replay_t replay;
+
+static bool is_jpeg_name(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+static int cmp_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Frame size from the first SOF marker. Returns false if there is none.
+ */
+static bool jpeg_size(const uint8_t *p, size_t len, uint16_t *w, uint16_t *h) {
+    size_t i = 2;   // past SOI
+    while (i + 9 < len) {
+        if (p[i] != 0xFF) return false;
+        uint8_t marker = p[i + 1];
+        uint16_t seg = p[i + 2] << 8 | p[i + 3];
+        // SOF0..SOF15, minus DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            *h = p[i + 5] << 8 | p[i + 6];
+            *w = p[i + 7] << 8 | p[i + 8];
+            return true;
+        }
+        i += 2 + seg;
+    }
+    return false;
+}
+
+static esp_err_t load_file(replay_t *r, const char *name, size_t *len) {
+    char path[REPLAY_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", r->cfg.dir, name);
+    FILE *f = fopen(path, "rb");
+    if (!f) return ESP_ERR_NOT_FOUND;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if ((size_t)size > r->cap) {
+        uint8_t *nb = realloc(r->buf, size);
+        if (!nb) {
+            fclose(f);
+            return ESP_ERR_NO_MEM;
+        }
+        r->buf = nb;
+        r->cap = size;
+    }
+    *len = fread(r->buf, 1, size, f);
+    fclose(f);
+    return *len == (size_t)size ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * Hold to the configured rate like a sensor would, then read the next file.
+ * Files are read per frame, so directories larger than RAM work too.
+ */
+static esp_err_t replay_get(void *ctx, frame_source_frame_t *out) {
+    replay_t *r = (replay_t *)ctx;
+    if (r->next >= r->file_count) {
+        if (!r->cfg.loop) return ESP_ERR_NOT_FOUND;
+        r->next = 0;
+    }
+
+    int64_t wait_us = r->due_us - esp_timer_get_time();
+    if (wait_us > 0) vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) ? pdMS_TO_TICKS(wait_us / 1000) : 1);
+    int64_t now = esp_timer_get_time();
+    // Don't try to catch up after a stall; a sensor wouldn't either
+    r->due_us = (now - r->due_us > r->period_us ? now : r->due_us) + r->period_us;
+
+    const char *name = r->files[r->next++];
+    size_t len = 0;
+    esp_err_t res = load_file(r, name, &len);
+    if (res != ESP_OK) {
+        ESP_LOGW(TAG, "%s: %s", name, esp_err_to_name(res));
+        return res;
+    }
+
+    uint16_t w = 0, h = 0;
+    if (!jpeg_size(r->buf, len, &w, &h)) {
+        ESP_LOGW(TAG, "%s: not a JPEG", name);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    out->buf = r->buf;
+    out->len = len;
+    out->width = w;
+    out->height = h;
+    out->format = FRAME_FORMAT_JPEG;
+    out->timestamp_us = now;
+    out->priv = NULL;
+    return ESP_OK;
+}
+
+static void replay_put(void *ctx, frame_source_frame_t *frame) {
+}
+
+static frame_source_t replay_source = {
+    .name = "replay",
+    .ctx = &replay,
+    .get = replay_get,
+    .put = replay_put,
+    .set_format = NULL,   // frames play back as recorded
+};
+
+esp_err_t frame_source_replay_init(const frame_source_replay_config_t *config, const frame_source_t **out) {
+    if (!config || !config->dir || config->fps == 0) return ESP_ERR_INVALID_ARG;
+
+    DIR *d = opendir(config->dir);
+    if (!d) {
+        ESP_LOGE(TAG, "Can't open %s", config->dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    replay_t *r = &replay;
+    memset(r, 0, sizeof(*r));
+    r->cfg = *config;
+    int cap = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (!is_jpeg_name(e->d_name)) continue;
+        if (r->file_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **nf = realloc(r->files, cap * sizeof(char *));
+            if (!nf) break;
+            r->files = nf;
+        }
+        r->files[r->file_count] = strdup(e->d_name);
+        if (r->files[r->file_count]) r->file_count++;
+    }
+    closedir(d);
+
+    if (r->file_count == 0) {
+        ESP_LOGE(TAG, "No .jpg files in %s", config->dir);
+        free(r->files);
+        r->files = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+    qsort(r->files, r->file_count, sizeof(char *), cmp_names);
+
+    r->period_us = 1000000 / config->fps;
+    r->due_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Replaying %d frames from %s at %u fps", r->file_count, config->dir, config->fps);
+
+    *out = &replay_source;
+    return ESP_OK;
+}
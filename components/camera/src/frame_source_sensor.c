@@ -0,0 +1,111 @@
+#include "frame_source.h"
+#include "camera_stats.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "camera_pins.h"
+
+static const char *TAG = "cam_sensor";
+
+static frame_format_t frame_format(pixformat_t format) {
+    switch (format) {
+    case PIXFORMAT_JPEG: return FRAME_FORMAT_JPEG;
+    case PIXFORMAT_GRAYSCALE: return FRAME_FORMAT_GRAYSCALE;
+    case PIXFORMAT_YUV422: return FRAME_FORMAT_YUV422;
+    case PIXFORMAT_RGB565: return FRAME_FORMAT_RGB565;
+    default: return FRAME_FORMAT_OTHER;
+    }
+}
+
+static esp_err_t sensor_get(void *ctx, frame_source_frame_t *out) {
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) return ESP_FAIL;
+    out->buf = fb->buf;
+    out->len = fb->len;
+    out->width = fb->width;
+    out->height = fb->height;
+    out->format = frame_format(fb->format);
+    // The driver stamps frames with esp_timer time at VSYNC
+    out->timestamp_us = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    out->priv = fb;
+    return ESP_OK;
+}
+
+static void sensor_put(void *ctx, frame_source_frame_t *frame) {
+    esp_camera_fb_return((camera_fb_t *)frame->priv);
+}
+
+static esp_err_t sensor_set_format(void *ctx, uint16_t width, uint16_t height, uint8_t quality) {
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s) return ESP_ERR_INVALID_STATE;
+
+    framesize_t size = FRAMESIZE_INVALID;
+    for (int i = 0; i < FRAMESIZE_INVALID; i++) {
+        if (resolution[i].width == width && resolution[i].height == height) {
+            size = i;
+            break;
+        }
+    }
+    if (size == FRAMESIZE_INVALID) return ESP_ERR_NOT_SUPPORTED;
+
+    if (s->status.framesize != size && s->set_framesize(s, size) != 0) {
+        ESP_LOGW(TAG, "set_framesize(%d) failed", size);
+        return ESP_FAIL;
+    }
+    if (s->set_quality(s, quality) != 0) {
+        ESP_LOGW(TAG, "set_quality(%d) failed", quality);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static const frame_source_t sensor_source = {
+    .name = "sensor",
+    .get = sensor_get,
+    .put = sensor_put,
+    .set_format = sensor_set_format,
+};
+
+/**
+ * Initialize the camera hardware with the specified configuration (aka ports).
+ */
+esp_err_t frame_source_sensor_init(const frame_source_t **out) {
+    camera_config_t config;
+    config.ledc_channel = LEDC_CHANNEL_0;
+    config.ledc_timer = LEDC_TIMER_0;
+    config.pin_d0 = Y2_GPIO_NUM;
+    config.pin_d1 = Y3_GPIO_NUM;
+    config.pin_d2 = Y4_GPIO_NUM;
+    config.pin_d3 = Y5_GPIO_NUM;
+    config.pin_d4 = Y6_GPIO_NUM;
+    config.pin_d5 = Y7_GPIO_NUM;
+    config.pin_d6 = Y8_GPIO_NUM;
+    config.pin_d7 = Y9_GPIO_NUM;
+    config.pin_xclk = XCLK_GPIO_NUM;
+    config.pin_pclk = PCLK_GPIO_NUM;
+    config.pin_vsync = VSYNC_GPIO_NUM;
+    config.pin_href = HREF_GPIO_NUM;
+    config.pin_sccb_sda = SIOD_GPIO_NUM;
+    config.pin_sccb_scl = SIOC_GPIO_NUM;
+    config.pin_pwdn = PWDN_GPIO_NUM;
+    config.pin_reset = RESET_GPIO_NUM;
+    config.xclk_freq_hz = 10000000;
+    // The driver sizes its JPEG buffers for this frame size, so start at the
+    // largest one the rate controller may pick; it steps down from here.
+    config.frame_size = FRAMESIZE_VGA; // 640×480
+    config.jpeg_quality = 10; // rate_ctrl takes over quality at runtime
+    config.pixel_format = PIXFORMAT_JPEG;
+    config.grab_mode = CAMERA_GRAB_LATEST;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.fb_count = 2;
+
+    esp_err_t res = esp_camera_init(&config);
+    if (res != ESP_OK) return res;
+    sensor_t * s = esp_camera_sensor_get();
+    s->set_vflip(s, 1);
+    s->set_brightness(s, 1);
+    s->set_saturation(s, 0);
+    camera_stats_init(config.xclk_freq_hz, config.fb_count, config.grab_mode);
+
+    *out = &sensor_source;
+    return ESP_OK;
+}
@@ -0,0 +1,289 @@
+#include "mjpeg_stream.h"
+#include "camera.h"
+#include "frame_ring.h"
+#include "rate_ctrl.h"
+#include "camera_stats.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "cJSON.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "mjpeg";
+static SemaphoreHandle_t stream_slots = NULL;
+
+// Stream workers sit just below the httpd task so UI requests win the CPU
+#define STREAM_TASK_STACK  4096
+#define STREAM_TASK_PRIO   4
+
+// How long a viewer waits for the next frame before giving up on the camera
+#define STREAM_FRAME_TIMEOUT pdMS_TO_TICKS(2000)
+
+// Each worker logs its send latency every this many frames
+#define STREAM_LOG_EVERY 100
+
+#define STREAM_CONTENT_TYPE "multipart/x-mixed-replace;boundary=frame"
+#define STREAM_BOUNDARY "\r\n--frame\r\n"
+#define STREAM_PART "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n"
+
+static const char *mode_names[] = {"chunked", "raw"};
+
+typedef struct {
+    httpd_req_t *req;
+    mjpeg_stream_mode_t mode;
+} stream_job_t;
+
+// Per-frame send latency since boot, per mode, so the two can be compared
+static portMUX_TYPE latency_mux = portMUX_INITIALIZER_UNLOCKED;
+static mjpeg_stream_latency_t latency[MJPEG_STREAM_MODE_COUNT];
+
+static void record_latency(mjpeg_stream_mode_t mode, int64_t send_us) {
+    portENTER_CRITICAL(&latency_mux);
+    mjpeg_stream_latency_t *l = &latency[mode];
+    l->frames++;
+    l->total_us += send_us;
+    if (send_us > l->max_us) l->max_us = send_us;
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+/**
+ * Chunked transfer through httpd: boundary, part header and body are
+ * three chunks, each with its own length line and TCP write.
+ */
+static esp_err_t send_frame_chunked(httpd_req_t *req, const camera_frame_t *frame) {
+    char part_buf[64];
+    esp_err_t res = httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
+    if (res == ESP_OK) {
+        int hlen = snprintf(part_buf, sizeof(part_buf), STREAM_PART, (unsigned)frame->len);
+        res = httpd_resp_send_chunk(req, part_buf, hlen);
+    }
+    if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char *)frame->buf, frame->len);
+    return res;
+}
+
+esp_err_t mjpeg_stream_send_iov(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iovcnt};
+        ssize_t n = sendmsg(fd, &msg, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return ESP_FAIL;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Raw socket: the boundary and part header go out with the JPEG in one
+ * gathered send, straight from the ring buffer, with no chunk framing.
+ */
+static esp_err_t send_frame_raw(int fd, const camera_frame_t *frame) {
+    char part_buf[80];
+    int hlen = snprintf(part_buf, sizeof(part_buf), STREAM_BOUNDARY STREAM_PART, (unsigned)frame->len);
+    struct iovec iov[2] = {
+        {.iov_base = part_buf, .iov_len = hlen},
+        {.iov_base = frame->buf, .iov_len = frame->len},
+    };
+    return mjpeg_stream_send_iov(fd, iov, 2);
+}
+
+/**
+ * Raw mode writes its own response head, since httpd never sees the body.
+ * The connection is closed afterwards because the body has no length.
+ */
+static esp_err_t send_raw_head(int fd) {
+    static const char head[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: " STREAM_CONTENT_TYPE "\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    struct iovec iov = {.iov_base = (void *)head, .iov_len = sizeof(head) - 1};
+    return mjpeg_stream_send_iov(fd, &iov, 1);
+}
+
+/**
+ * Sends the latest frame from the capture ring as multipart JPEG images
+ * until the client goes away. A viewer that falls behind skips straight
+ * to the newest frame.
+ */
+static esp_err_t stream_frames(httpd_req_t *req, mjpeg_stream_mode_t mode) {
+    int fd = httpd_req_to_sockfd(req);
+    esp_err_t res;
+
+    if (mode == MJPEG_STREAM_RAW) {
+        // Push the tail of each frame out now instead of waiting for an ACK
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        res = send_raw_head(fd);
+    } else {
+        res = httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+    }
+    if (res != ESP_OK) return res;
+
+    uint32_t last_seq = 0;
+    uint32_t frames = 0;
+    int64_t window_us = 0, window_max_us = 0;
+    int stats_id = camera_stats_client_open(fd, mode_names[mode]);
+
+    while (true) {
+        camera_frame_t *frame = frame_ring_acquire(last_seq, STREAM_FRAME_TIMEOUT);
+        if (!frame) {
+            ESP_LOGE(TAG, "No frame from capture task");
+            // The client is still there; end the chunked body so the
+            // connection goes back to httpd in a clean state
+            if (mode == MJPEG_STREAM_CHUNKED) httpd_resp_send_chunk(req, NULL, 0);
+            res = ESP_FAIL;
+            break;
+        }
+        uint32_t skipped = last_seq ? frame->seq - last_seq - 1 : 0;
+        last_seq = frame->seq;
+
+        int64_t send_start = esp_timer_get_time();
+        res = mode == MJPEG_STREAM_RAW ? send_frame_raw(fd, frame) : send_frame_chunked(req, frame);
+        int64_t send_us = esp_timer_get_time() - send_start;
+        int64_t queue_us = send_start - frame->timestamp_us;
+        size_t len = frame->len;
+        frame_ring_release(frame);
+        if (res != ESP_OK) break;
+
+        rate_ctrl_record_frame(len, send_us);
+        record_latency(mode, send_us);
+        camera_stats_client_frame(stats_id, queue_us, send_us, skipped);
+
+        window_us += send_us;
+        if (send_us > window_max_us) window_max_us = send_us;
+        if (++frames % STREAM_LOG_EVERY == 0) {
+            ESP_LOGI(TAG, "fd %d [%s]: mean send %.2f ms, max %.2f ms over %d frames", fd,
+                     mode_names[mode], window_us / 1000.0 / STREAM_LOG_EVERY, window_max_us / 1000.0,
+                     STREAM_LOG_EVERY);
+            window_us = 0;
+            window_max_us = 0;
+        }
+    }
+    camera_stats_client_close(stats_id);
+    return res;
+}
+
+/**
+ * One task per viewer. Owns the async copy of the request until the
+ * client disconnects, then hands the socket back to the server.
+ */
+static void stream_worker(void *arg) {
+    stream_job_t *job = (stream_job_t *)arg;
+    httpd_req_t *req = job->req;
+    mjpeg_stream_mode_t mode = job->mode;
+    free(job);
+
+    stream_frames(req, mode);
+
+    httpd_handle_t server = req->handle;
+    int fd = httpd_req_to_sockfd(req);
+    httpd_req_async_handler_complete(req);
+    if (mode == MJPEG_STREAM_RAW) httpd_sess_trigger_close(server, fd);
+
+    xSemaphoreGive(stream_slots);
+    vTaskDelete(NULL);
+}
+
+/**
+ * GET /stream[?mode=chunked|raw]
+ * Detaches the request from the server's single worker so the UI, log
+ * polling and OTA keep being served while video plays. Raw mode is the
+ * default; chunked is kept for comparison and picky clients.
+ */
+static esp_err_t stream_handler(httpd_req_t *req) {
+    mjpeg_stream_mode_t mode = MJPEG_STREAM_RAW;
+    char q[32], val[16];
+    if (httpd_req_get_url_query_str(req, q, sizeof(q)) == ESP_OK &&
+        httpd_query_key_value(q, "mode", val, sizeof(val)) == ESP_OK &&
+        strcmp(val, "chunked") == 0) {
+        mode = MJPEG_STREAM_CHUNKED;
+    }
+
+    if (xSemaphoreTake(stream_slots, 0) != pdTRUE) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Too many viewers");
+    }
+
+    stream_job_t *job = malloc(sizeof(*job));
+    if (!job) {
+        xSemaphoreGive(stream_slots);
+        return ESP_ERR_NO_MEM;
+    }
+    job->mode = mode;
+
+    esp_err_t res = httpd_req_async_handler_begin(req, &job->req);
+    if (res != ESP_OK) {
+        free(job);
+        xSemaphoreGive(stream_slots);
+        return res;
+    }
+
+    if (xTaskCreate(stream_worker, "cam_stream", STREAM_TASK_STACK, job,
+                    STREAM_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start stream worker");
+        httpd_req_async_handler_complete(job->req);
+        free(job);
+        xSemaphoreGive(stream_slots);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void mjpeg_stream_get_latency(mjpeg_stream_mode_t mode, mjpeg_stream_latency_t *out) {
+    portENTER_CRITICAL(&latency_mux);
+    *out = latency[mode];
+    portEXIT_CRITICAL(&latency_mux);
+}
+
+// GET /api/camera/latency -> {chunked:{frames,mean_ms,max_ms}, raw:{...}}
+static esp_err_t h_latency(httpd_req_t *req) {
+    cJSON *o = cJSON_CreateObject();
+    for (int m = 0; m < MJPEG_STREAM_MODE_COUNT; m++) {
+        mjpeg_stream_latency_t l;
+        mjpeg_stream_get_latency(m, &l);
+        cJSON *j = cJSON_AddObjectToObject(o, mode_names[m]);
+        cJSON_AddNumberToObject(j, "frames", l.frames);
+        cJSON_AddNumberToObject(j, "mean_ms", l.frames ? l.total_us / 1000.0 / l.frames : 0);
+        cJSON_AddNumberToObject(j, "max_ms", l.max_us / 1000.0);
+    }
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+esp_err_t mjpeg_stream_register_handlers(httpd_handle_t server) {
+    if (!stream_slots) {
+        stream_slots = xSemaphoreCreateCounting(CAMERA_MAX_STREAMS, CAMERA_MAX_STREAMS);
+        if (!stream_slots) return ESP_ERR_NO_MEM;
+    }
+
+    const httpd_uri_t stream_uri = {
+        .uri       = "/stream",
+        .method    = HTTP_GET,
+        .handler   = stream_handler,
+        .user_ctx  = NULL
+    };
+    const httpd_uri_t latency_uri = {.uri = "/api/camera/latency", .method = HTTP_GET, .handler = h_latency};
+    esp_err_t res = httpd_register_uri_handler(server, &stream_uri);
+    if (res == ESP_OK) res = httpd_register_uri_handler(server, &latency_uri);
+    return res;
+}
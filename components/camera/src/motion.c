@@ -0,0 +1,244 @@
+#include "motion.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_jpg_decode.h"
+#endif
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "motion";
+
+// Frames are analysed at 1/8 of their size; JPEG decodes that cheaply from
+// the DC coefficients alone. VGA is the largest frame the camera produces.
+#define MOTION_SCALE 8
+#define MOTION_MAX_W (640 / MOTION_SCALE)
+#define MOTION_MAX_H (480 / MOTION_SCALE)
+#define MOTION_MAX_PIXELS (MOTION_MAX_W * MOTION_MAX_H)
+
+// Rows/columns with fewer changed pixels than this don't widen the box
+#define MOTION_MIN_LINE_HITS 2
+#define MOTION_MIN_CHANGED   4
+#define MOTION_MAX_CBS       4
+
+static motion_config_t cfg;
+static bool initialized = false;
+
+static uint8_t gray[MOTION_MAX_PIXELS];
+static uint8_t background[MOTION_MAX_PIXELS];
+static uint8_t mask[MOTION_MAX_PIXELS];
+static uint16_t gray_w = 0, gray_h = 0;
+static bool background_valid = false;
+static bool format_warned = false;
+
+static int64_t last_analyzed_us = 0;
+static int64_t last_motion_us = 0;
+static bool active = false;
+
+static portMUX_TYPE state_mux = portMUX_INITIALIZER_UNLOCKED;
+static motion_event_t last_event;
+static uint32_t event_count = 0;
+
+static struct {
+    motion_event_cb_t cb;
+    void *arg;
+} callbacks[MOTION_MAX_CBS];
+static int callback_count = 0;
+
+#if !CONFIG_IDF_TARGET_LINUX
+typedef struct {
+    const uint8_t *src;
+    size_t len;
+    uint16_t out_w;
+    uint16_t out_h;
+} jpg_gray_ctx_t;
+
+static size_t jpg_read(void *arg, size_t index, uint8_t *buf, size_t len) {
+    jpg_gray_ctx_t *ctx = (jpg_gray_ctx_t *)arg;
+    if (index >= ctx->len) return 0;
+    if (len > ctx->len - index) len = ctx->len - index;
+    if (buf) memcpy(buf, ctx->src + index, len);
+    return len;
+}
+
+/**
+ * Decoder output callback. Receives RGB888 blocks and keeps only luma.
+ * A NULL block at (0,0) announces the output size.
+ */
+static bool jpg_write_gray(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data) {
+    jpg_gray_ctx_t *ctx = (jpg_gray_ctx_t *)arg;
+    if (!data) {
+        if (x == 0 && y == 0) {
+            bool fits = w <= MOTION_MAX_W && h <= MOTION_MAX_H;
+            ctx->out_w = fits ? w : 0;
+            ctx->out_h = fits ? h : 0;
+        }
+        return true;
+    }
+    if (!ctx->out_w) return false;
+
+    for (uint16_t j = 0; j < h && y + j < ctx->out_h; j++) {
+        const uint8_t *p = data + j * w * 3;
+        uint8_t *dst = gray + (y + j) * ctx->out_w + x;
+        for (uint16_t i = 0; i < w && x + i < ctx->out_w; i++, p += 3) {
+            dst[i] = (p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8;
+        }
+    }
+    return true;
+}
+#endif
+
+static void emit(motion_event_type_t type, const motion_box_t *box, uint32_t changed, int64_t ts) {
+    motion_event_t ev = {.type = type, .box = *box, .changed = changed, .timestamp_us = ts};
+
+    portENTER_CRITICAL(&state_mux);
+    last_event = ev;
+    if (type == MOTION_EVENT_START) event_count++;
+    portEXIT_CRITICAL(&state_mux);
+
+    if (type != MOTION_EVENT_UPDATE) {
+        ESP_LOGI(TAG, "Motion %s at %u,%u %ux%u", type == MOTION_EVENT_START ? "start" : "end",
+                 box->x, box->y, box->w, box->h);
+    }
+    for (int i = 0; i < callback_count; i++) callbacks[i].cb(&ev, callbacks[i].arg);
+}
+
+esp_err_t motion_init(const motion_config_t *config) {
+    motion_config_t defaults = MOTION_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.analyze_fps == 0 || cfg.bg_shift == 0 || cfg.bg_shift > 7) return ESP_ERR_INVALID_ARG;
+
+    background_valid = false;
+    active = false;
+    initialized = true;
+    return ESP_OK;
+}
+
+void motion_process_frame(const uint8_t *buf, size_t len, frame_format_t format, uint16_t width,
+                          uint16_t height, int64_t timestamp_us) {
+    if (!initialized) return;
+    if (timestamp_us - last_analyzed_us < 1000000 / cfg.analyze_fps) return;
+    last_analyzed_us = timestamp_us;
+
+    uint16_t w = width / MOTION_SCALE;
+    uint16_t h = height / MOTION_SCALE;
+    if (w == 0 || h == 0 || w > MOTION_MAX_W || h > MOTION_MAX_H) return;
+
+    size_t pixels = (size_t)width * height;
+    switch (format) {
+    case FRAME_FORMAT_JPEG: {
+#if CONFIG_IDF_TARGET_LINUX
+        // The JPEG decoder comes with esp32-camera, which has no host build
+        return;
+#else
+        jpg_gray_ctx_t ctx = {.src = buf, .len = len};
+        if (esp_jpg_decode(len, JPG_SCALE_8X, jpg_read, jpg_write_gray, &ctx) != ESP_OK || !ctx.out_w) return;
+        w = ctx.out_w;
+        h = ctx.out_h;
+        break;
+#endif
+    }
+    case FRAME_FORMAT_GRAYSCALE:
+        if (len < pixels) return;
+        motion_downscale_gray(buf, width, height, MOTION_SCALE, gray);
+        break;
+    case FRAME_FORMAT_YUV422:
+        if (len < pixels * 2) return;
+        motion_downscale_yuv422(buf, width, height, MOTION_SCALE, gray);
+        break;
+    case FRAME_FORMAT_RGB565:
+        if (len < pixels * 2) return;
+        motion_downscale_rgb565(buf, width, height, MOTION_SCALE, gray);
+        break;
+    default:
+        if (!format_warned) {
+            ESP_LOGW(TAG, "Pixel format %d not supported, motion detection off", format);
+            format_warned = true;
+        }
+        return;
+    }
+
+    // The rate controller changed the frame size: start learning again
+    size_t n = (size_t)w * h;
+    if (w != gray_w || h != gray_h || !background_valid) {
+        gray_w = w;
+        gray_h = h;
+        memcpy(background, gray, n);
+        background_valid = true;
+        return;
+    }
+
+    uint32_t changed = motion_absdiff_threshold(gray, background, mask, n, cfg.threshold);
+    motion_update_background(background, gray, n, cfg.bg_shift);
+
+    uint32_t min_changed = n * cfg.min_changed_pct / 100;
+    if (min_changed < MOTION_MIN_CHANGED) min_changed = MOTION_MIN_CHANGED;
+
+    motion_box_t box;
+    if (changed >= min_changed && motion_mask_bbox(mask, w, h, MOTION_MIN_LINE_HITS, &box)) {
+        // Back to full frame coordinates
+        box.x = box.x * width / w;
+        box.y = box.y * height / h;
+        box.w = box.w * width / w;
+        box.h = box.h * height / h;
+        last_motion_us = timestamp_us;
+        emit(active ? MOTION_EVENT_UPDATE : MOTION_EVENT_START, &box, changed, timestamp_us);
+        active = true;
+    } else if (active && timestamp_us - last_motion_us > (int64_t)cfg.hold_ms * 1000) {
+        active = false;
+        emit(MOTION_EVENT_END, &last_event.box, changed, timestamp_us);
+    }
+}
+
+bool motion_is_active(void) {
+    return active;
+}
+
+int64_t motion_capture_interval_us(void) {
+    if (!initialized || cfg.idle_fps == 0 || active) return 0;
+    return 1000000 / cfg.idle_fps;
+}
+
+esp_err_t motion_register_cb(motion_event_cb_t cb, void *arg) {
+    if (!cb) return ESP_ERR_INVALID_ARG;
+    if (callback_count >= MOTION_MAX_CBS) return ESP_ERR_NO_MEM;
+    callbacks[callback_count].cb = cb;
+    callbacks[callback_count].arg = arg;
+    callback_count++;
+    return ESP_OK;
+}
+
+// GET /api/camera/motion -> {active, events, idle_fps, last:{x,y,w,h,changed,timestamp_ms}}
+static esp_err_t h_motion(httpd_req_t *req) {
+    portENTER_CRITICAL(&state_mux);
+    motion_event_t ev = last_event;
+    uint32_t events = event_count;
+    portEXIT_CRITICAL(&state_mux);
+
+    cJSON *o = cJSON_CreateObject();
+    cJSON_AddBoolToObject(o, "active", active);
+    cJSON_AddNumberToObject(o, "events", events);
+    cJSON_AddNumberToObject(o, "idle_fps", cfg.idle_fps);
+    if (events) {
+        cJSON *l = cJSON_AddObjectToObject(o, "last");
+        cJSON_AddNumberToObject(l, "x", ev.box.x);
+        cJSON_AddNumberToObject(l, "y", ev.box.y);
+        cJSON_AddNumberToObject(l, "w", ev.box.w);
+        cJSON_AddNumberToObject(l, "h", ev.box.h);
+        cJSON_AddNumberToObject(l, "changed", ev.changed);
+        cJSON_AddNumberToObject(l, "timestamp_ms", ev.timestamp_us / 1000);
+    }
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+esp_err_t motion_register_handlers(httpd_handle_t server) {
+    const httpd_uri_t uri = {.uri = "/api/camera/motion", .method = HTTP_GET, .handler = h_motion};
+    return httpd_register_uri_handler(server, &uri);
+}
@@ -0,0 +1,180 @@
+#include "motion_kernels.h"
+#include <string.h>
+
+// The per-pixel kernels work on 16 pixels at a time using GCC vector
+// extensions. On the host they become SSE/NEON. The ESP32-S3 build is
+// scalar: Xtensa GCC only turns the bitwise and add/sub lanes into 32-bit
+// word operations, and the compares and selects in absdiff, threshold and
+// bbox become per-byte code. There is no PIE or esp-dsp path.
+typedef uint8_t v16u8 __attribute__((vector_size(16)));
+#define LANES 16
+
+static inline v16u8 load16(const uint8_t *p) {
+    v16u8 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store16(uint8_t *p, v16u8 v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+void motion_downscale_gray(const uint8_t *src, int src_w, int src_h, int factor, uint8_t *dst) {
+    int dst_w = src_w / factor;
+    int dst_h = src_h / factor;
+    int area = factor * factor;
+
+    for (int dy = 0; dy < dst_h; dy++) {
+        const uint8_t *row = src + dy * factor * src_w;
+        for (int dx = 0; dx < dst_w; dx++) {
+            const uint8_t *p = row + dx * factor;
+            uint32_t sum = 0;
+            for (int y = 0; y < factor; y++) {
+                for (int x = 0; x < factor; x++) sum += p[x];
+                p += src_w;
+            }
+            dst[dy * dst_w + dx] = (uint8_t)(sum / area);
+        }
+    }
+}
+
+void motion_downscale_yuv422(const uint8_t *src, int src_w, int src_h, int factor, uint8_t *dst) {
+    int dst_w = src_w / factor;
+    int dst_h = src_h / factor;
+    int area = factor * factor;
+    int stride = src_w * 2;
+
+    // Y U Y V: luma is every even byte
+    for (int dy = 0; dy < dst_h; dy++) {
+        const uint8_t *row = src + dy * factor * stride;
+        for (int dx = 0; dx < dst_w; dx++) {
+            const uint8_t *p = row + dx * factor * 2;
+            uint32_t sum = 0;
+            for (int y = 0; y < factor; y++) {
+                for (int x = 0; x < factor; x++) sum += p[x * 2];
+                p += stride;
+            }
+            dst[dy * dst_w + dx] = (uint8_t)(sum / area);
+        }
+    }
+}
+
+void motion_downscale_rgb565(const uint8_t *src, int src_w, int src_h, int factor, uint8_t *dst) {
+    int dst_w = src_w / factor;
+    int dst_h = src_h / factor;
+    int area = factor * factor;
+    int stride = src_w * 2;
+
+    for (int dy = 0; dy < dst_h; dy++) {
+        const uint8_t *row = src + dy * factor * stride;
+        for (int dx = 0; dx < dst_w; dx++) {
+            const uint8_t *p = row + dx * factor * 2;
+            uint32_t sum = 0;
+            for (int y = 0; y < factor; y++) {
+                for (int x = 0; x < factor; x++) {
+                    uint32_t v = (uint32_t)p[x * 2] << 8 | p[x * 2 + 1];
+                    uint32_t r = (v >> 11) & 0x1F, g = (v >> 5) & 0x3F, b = v & 0x1F;
+                    r = r << 3 | r >> 2;
+                    g = g << 2 | g >> 4;
+                    b = b << 3 | b >> 2;
+                    sum += (r * 77 + g * 150 + b * 29) >> 8;
+                }
+                p += stride;
+            }
+            dst[dy * dst_w + dx] = (uint8_t)(sum / area);
+        }
+    }
+}
+
+uint32_t motion_absdiff_threshold(const uint8_t *cur, const uint8_t *bg, uint8_t *mask, size_t n,
+                                  uint8_t threshold) {
+    const v16u8 zero = {0};
+    const v16u8 t = zero + threshold;
+    uint32_t changed = 0;
+    size_t i = 0;
+
+    // Hits are counted per lane in 8 bits, so fold them into the total
+    // before any lane can reach 256.
+    while (i + LANES <= n) {
+        v16u8 acc = zero;
+        for (int k = 0; k < 255 && i + LANES <= n; k++, i += LANES) {
+            v16u8 a = load16(cur + i);
+            v16u8 b = load16(bg + i);
+            v16u8 gt = (v16u8)(a > b);
+            v16u8 d = ((a - b) & gt) | ((b - a) & ~gt);
+            v16u8 hit = (v16u8)(d > t);
+            store16(mask + i, hit);
+            acc -= hit;   // hit lanes are 0xFF, i.e. -1
+        }
+        for (int l = 0; l < LANES; l++) changed += acc[l];
+    }
+
+    for (; i < n; i++) {
+        int d = cur[i] > bg[i] ? cur[i] - bg[i] : bg[i] - cur[i];
+        mask[i] = d > threshold ? 0xFF : 0;
+        changed += d > threshold;
+    }
+    return changed;
+}
+
+void motion_update_background(uint8_t *bg, const uint8_t *cur, size_t n, int shift) {
+    const v16u8 zero = {0};
+    const v16u8 low = zero + (uint8_t)((1 << shift) - 1);
+    size_t i = 0;
+
+    for (; i + LANES <= n; i += LANES) {
+        v16u8 a = load16(cur + i);
+        v16u8 b = load16(bg + i);
+        v16u8 up = (a - b) & (v16u8)(a > b);
+        v16u8 down = (b - a) & (v16u8)(a < b);
+        // ceil(d / 2^shift): comparisons yield -1, so subtracting adds one
+        up = (up >> shift) - (v16u8)((up & low) != zero);
+        down = (down >> shift) - (v16u8)((down & low) != zero);
+        store16(bg + i, b + up - down);
+    }
+
+    int round = (1 << shift) - 1;
+    for (; i < n; i++) {
+        int d = (int)cur[i] - bg[i];
+        if (d > 0) bg[i] += (d + round) >> shift;
+        else if (d < 0) bg[i] -= (-d + round) >> shift;
+    }
+}
+
+bool motion_mask_bbox(const uint8_t *mask, int w, int h, int min_hits, motion_box_t *box) {
+    // Column hit counts live on the stack; motion frames are small
+    uint16_t col_hits[w];
+    memset(col_hits, 0, sizeof(col_hits));
+
+    int y0 = -1, y1 = -1;
+    for (int y = 0; y < h; y++) {
+        const uint8_t *row = mask + y * w;
+        int row_hits = 0;
+        for (int x = 0; x < w; x++) {
+            if (row[x]) {
+                row_hits++;
+                col_hits[x]++;
+            }
+        }
+        if (row_hits >= min_hits) {
+            if (y0 < 0) y0 = y;
+            y1 = y;
+        }
+    }
+    if (y0 < 0) return false;
+
+    int x0 = -1, x1 = -1;
+    for (int x = 0; x < w; x++) {
+        if (col_hits[x] >= min_hits) {
+            if (x0 < 0) x0 = x;
+            x1 = x;
+        }
+    }
+    if (x0 < 0) return false;
+
+    box->x = x0;
+    box->y = y0;
+    box->w = x1 - x0 + 1;
+    box->h = y1 - y0 + 1;
+    return true;
+}
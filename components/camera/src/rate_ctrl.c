@@ -0,0 +1,300 @@
+#include "rate_ctrl.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+static const char *TAG = "rate_ctrl";
+
+// Measurement window and hysteresis. Stepping down reacts after one bad
+// window; stepping up needs several good ones in a row so we don't flap.
+#define WINDOW_US          1000000
+#define UP_HOLD_WINDOWS    3
+#define FPS_HEADROOM       1.5f   // step up when we could send this much faster
+#define LATENCY_HEADROOM   0.5f   // step up when sends take under half the budget
+
+// Accepted from POST /api/camera/rate
+#define TARGET_FPS_MAX        60
+#define TARGET_LATENCY_MS_MAX 10000
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t quality;
+} operating_point_t;
+
+// Cheapest first. The last entry is the frame size the camera is initialised
+// with, since the driver sizes its JPEG buffers for it.
+static const operating_point_t ladder[] = {
+    {160, 120, 20},     // QQVGA
+    {160, 120, 12},
+    {320, 240, 20},     // QVGA
+    {320, 240, 12},
+    {480, 320, 15},     // HVGA
+    {640, 480, 15},     // VGA
+    {640, 480, 10},
+};
+#define LADDER_LEN ((int)(sizeof(ladder) / sizeof(ladder[0])))
+#define START_LEVEL 3
+
+static rate_ctrl_target_t target = {
+    .mode = RATE_CTRL_TARGET_FPS,
+    .target_fps = 15,
+    .target_latency_ms = 150,
+    .enabled = true,
+};
+static int level = START_LEVEL;
+static int pending_level = -1;   // set by the API, applied from the capture task
+static bool target_changed = false;
+static int good_windows = 0;     // capture task only
+
+// Guards the current window, which stream tasks fill, and everything above
+// and below that the API shares with the capture task
+static portMUX_TYPE window_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t win_frames = 0;
+static uint64_t win_bytes = 0;
+static uint64_t win_send_us = 0;
+static int64_t win_send_max_us = 0;
+static int64_t win_start_us = 0;
+
+// Last completed window, reported by the API
+static rate_ctrl_status_t last;
+
+static const frame_source_t *source = NULL;
+
+static esp_err_t apply_level(int new_level) {
+    if (!source) return ESP_ERR_INVALID_STATE;
+
+    // Sources that play back fixed frames still get the bookkeeping, so the
+    // controller's decisions can be tested without a sensor
+    const operating_point_t *op = &ladder[new_level];
+    if (source->set_format) {
+        esp_err_t res = source->set_format(source->ctx, op->width, op->height, op->quality);
+        if (res != ESP_OK) return res;
+    }
+
+    portENTER_CRITICAL(&window_mux);
+    level = new_level;
+    portEXIT_CRITICAL(&window_mux);
+    ESP_LOGI(TAG, "Operating point %d: %ux%u q%u", level, op->width, op->height, op->quality);
+    return ESP_OK;
+}
+
+esp_err_t rate_ctrl_init(const frame_source_t *src) {
+    source = src;
+    win_start_us = esp_timer_get_time();
+    return apply_level(START_LEVEL);
+}
+
+void rate_ctrl_record_frame(size_t bytes, int64_t send_us) {
+    portENTER_CRITICAL(&window_mux);
+    win_frames++;
+    win_bytes += bytes;
+    win_send_us += send_us;
+    if (send_us > win_send_max_us) win_send_max_us = send_us;
+    portEXIT_CRITICAL(&window_mux);
+}
+
+/**
+ * Decide which way to move given the last window.
+ * Returns -1 to step down, +1 to step up, 0 to hold.
+ */
+static int evaluate(const rate_ctrl_target_t *t, float mean_send_ms) {
+    if (t->mode == RATE_CTRL_TARGET_FPS) {
+        // A viewer's worker sends frames back to back, so the mean send
+        // time bounds the frame rate each viewer can sustain. The measured
+        // fps is summed over viewers and can't be compared with the target.
+        float capacity_fps = mean_send_ms > 0 ? 1000.0f / mean_send_ms : 1000.0f;
+        if (capacity_fps < t->target_fps) return -1;
+        if (capacity_fps > t->target_fps * FPS_HEADROOM) return 1;
+    } else {
+        if (mean_send_ms > t->target_latency_ms) return -1;
+        if (mean_send_ms < t->target_latency_ms * LATENCY_HEADROOM) return 1;
+    }
+    return 0;
+}
+
+void rate_ctrl_tick(void) {
+    portENTER_CRITICAL(&window_mux);
+    int jump_to = pending_level;
+    bool restart = target_changed || pending_level >= 0;
+    rate_ctrl_target_t t = target;
+    pending_level = -1;
+    target_changed = false;
+    portEXIT_CRITICAL(&window_mux);
+
+    if (restart) good_windows = 0;
+    if (jump_to >= 0) apply_level(jump_to);
+
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - win_start_us;
+    if (elapsed < WINDOW_US) return;
+
+    portENTER_CRITICAL(&window_mux);
+    uint32_t frames = win_frames;
+    uint64_t bytes = win_bytes;
+    uint64_t send_us = win_send_us;
+    int64_t send_max_us = win_send_max_us;
+    win_frames = 0;
+    win_bytes = 0;
+    win_send_us = 0;
+    win_send_max_us = 0;
+
+    float mean_send_ms = frames ? (float)send_us / frames / 1000.0f : 0;
+    last.bytes_per_sec = (uint32_t)(bytes * 1000000 / elapsed);
+    last.fps = frames * 1000000.0f / elapsed;
+    last.send_ms = mean_send_ms;
+    last.send_max_ms = send_max_us / 1000.0f;
+    portEXIT_CRITICAL(&window_mux);
+    win_start_us = now;
+
+    // Nobody is watching: nothing to learn from this window
+    if (!t.enabled || frames == 0) {
+        good_windows = 0;
+        return;
+    }
+
+    int step = evaluate(&t, mean_send_ms);
+    if (step < 0) {
+        good_windows = 0;
+        if (level > 0) apply_level(level - 1);
+    } else if (step > 0) {
+        if (++good_windows >= UP_HOLD_WINDOWS && level < LADDER_LEN - 1) {
+            good_windows = 0;
+            apply_level(level + 1);
+        }
+    } else {
+        good_windows = 0;
+    }
+}
+
+void rate_ctrl_get_target(rate_ctrl_target_t *out) {
+    portENTER_CRITICAL(&window_mux);
+    *out = target;
+    portEXIT_CRITICAL(&window_mux);
+}
+
+esp_err_t rate_ctrl_set_target(const rate_ctrl_target_t *t) {
+    if (!t || t->target_fps == 0 || t->target_latency_ms == 0) return ESP_ERR_INVALID_ARG;
+    if (t->mode != RATE_CTRL_TARGET_FPS && t->mode != RATE_CTRL_TARGET_LATENCY) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&window_mux);
+    target = *t;
+    target_changed = true;
+    portEXIT_CRITICAL(&window_mux);
+    return ESP_OK;
+}
+
+esp_err_t rate_ctrl_set_level(int new_level) {
+    if (new_level < 0 || new_level >= LADDER_LEN) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&window_mux);
+    pending_level = new_level;
+    portEXIT_CRITICAL(&window_mux);
+    return ESP_OK;
+}
+
+void rate_ctrl_get_status(rate_ctrl_status_t *out) {
+    portENTER_CRITICAL(&window_mux);
+    *out = last;
+    out->level = level;
+    portEXIT_CRITICAL(&window_mux);
+    const operating_point_t *op = &ladder[out->level];
+    out->level_count = LADDER_LEN;
+    out->width = op->width;
+    out->height = op->height;
+    out->quality = op->quality;
+}
+
+static esp_err_t send_rate_json(httpd_req_t *req) {
+    rate_ctrl_status_t st;
+    rate_ctrl_get_status(&st);
+    rate_ctrl_target_t tg;
+    rate_ctrl_get_target(&tg);
+
+    cJSON *o = cJSON_CreateObject();
+    cJSON *t = cJSON_AddObjectToObject(o, "target");
+    cJSON_AddStringToObject(t, "mode", tg.mode == RATE_CTRL_TARGET_FPS ? "fps" : "latency");
+    cJSON_AddNumberToObject(t, "fps", tg.target_fps);
+    cJSON_AddNumberToObject(t, "latency_ms", tg.target_latency_ms);
+    cJSON_AddBoolToObject(t, "enabled", tg.enabled);
+
+    cJSON *c = cJSON_AddObjectToObject(o, "current");
+    cJSON_AddNumberToObject(c, "level", st.level);
+    cJSON_AddNumberToObject(c, "levels", st.level_count);
+    cJSON_AddNumberToObject(c, "width", st.width);
+    cJSON_AddNumberToObject(c, "height", st.height);
+    cJSON_AddNumberToObject(c, "quality", st.quality);
+    cJSON_AddNumberToObject(c, "bytes_per_sec", st.bytes_per_sec);
+    cJSON_AddNumberToObject(c, "fps", st.fps);
+    cJSON_AddNumberToObject(c, "send_ms", st.send_ms);
+    cJSON_AddNumberToObject(c, "send_max_ms", st.send_max_ms);
+
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+// GET /api/camera/rate -> {target:{mode,fps,latency_ms,enabled}, current:{...}}
+static esp_err_t h_rate_get(httpd_req_t *req) {
+    return send_rate_json(req);
+}
+
+// POST /api/camera/rate {mode?, fps?, latency_ms?, enabled?, level?}
+// Nothing is applied unless every field given is valid.
+static esp_err_t h_rate_post(httpd_req_t *req) {
+    char buf[160];
+    int r = httpd_req_recv(req, buf, MIN(sizeof(buf) - 1, req->content_len));
+    if (r <= 0) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "no body");
+    buf[r] = 0;
+
+    cJSON *j = cJSON_Parse(buf);
+    if (!j) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad json");
+
+    rate_ctrl_target_t t;
+    rate_ctrl_get_target(&t);
+    const char *err = NULL;
+    int new_level = -1;
+    cJSON *it;
+    if ((it = cJSON_GetObjectItem(j, "mode")) && cJSON_IsString(it)) {
+        if (strcmp(it->valuestring, "fps") == 0) t.mode = RATE_CTRL_TARGET_FPS;
+        else if (strcmp(it->valuestring, "latency") == 0) t.mode = RATE_CTRL_TARGET_LATENCY;
+        else err = "bad mode";
+    }
+    if ((it = cJSON_GetObjectItem(j, "fps")) && cJSON_IsNumber(it)) {
+        if (it->valuedouble >= 1 && it->valuedouble <= TARGET_FPS_MAX) t.target_fps = it->valueint;
+        else err = "bad fps";
+    }
+    if ((it = cJSON_GetObjectItem(j, "latency_ms")) && cJSON_IsNumber(it)) {
+        if (it->valuedouble >= 1 && it->valuedouble <= TARGET_LATENCY_MS_MAX) t.target_latency_ms = it->valueint;
+        else err = "bad latency_ms";
+    }
+    if ((it = cJSON_GetObjectItem(j, "enabled")) && cJSON_IsBool(it)) t.enabled = cJSON_IsTrue(it);
+    if ((it = cJSON_GetObjectItem(j, "level")) && cJSON_IsNumber(it)) {
+        if (it->valuedouble >= 0 && it->valuedouble < LADDER_LEN) new_level = it->valueint;
+        else err = "bad level";
+    }
+    cJSON_Delete(j);
+    if (err) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err);
+
+    if (rate_ctrl_set_target(&t) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad target");
+    }
+    if (new_level >= 0) rate_ctrl_set_level(new_level);
+    return send_rate_json(req);
+}
+
+esp_err_t rate_ctrl_register_handlers(httpd_handle_t server) {
+    const httpd_uri_t get_uri = {.uri = "/api/camera/rate", .method = HTTP_GET, .handler = h_rate_get};
+    const httpd_uri_t post_uri = {.uri = "/api/camera/rate", .method = HTTP_POST, .handler = h_rate_post};
+    esp_err_t res = httpd_register_uri_handler(server, &get_uri);
+    if (res == ESP_OK) res = httpd_register_uri_handler(server, &post_uri);
+    return res;
+}
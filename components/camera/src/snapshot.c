@@ -0,0 +1,167 @@
+#include "snapshot.h"
+#include "camera.h"
+#include "frame_ring.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "snapshot";
+
+// How long a request waits for the very first frame after boot
+#define SNAPSHOT_TIMEOUT pdMS_TO_TICKS(1000)
+// Upper bound for ?wait=ms long polling
+#define SNAPSHOT_MAX_WAIT_MS 5000
+
+// Requests that have to wait are parked on their own task, like /stream
+// viewers, so they don't hold the server's single worker. Past
+// CAMERA_MAX_SNAPSHOT_WAITERS they are answered at once with whatever the
+// ring has.
+#define SNAPSHOT_TASK_STACK   3072
+#define SNAPSHOT_TASK_PRIO    4
+
+// Sequence numbers restart at 1 on every boot, so tag them with a per-boot
+// id; otherwise a poller could get 304 for a different image after reboot.
+static uint32_t boot_id = 0;
+static SemaphoreHandle_t waiter_slots = NULL;
+
+typedef struct {
+    httpd_req_t *req;
+    uint32_t known_seq;
+    uint32_t after_seq;     // what to wait for: 0 for any frame
+    TickType_t timeout;
+} snapshot_job_t;
+
+/**
+ * Parse an ETag produced by this module back into a frame seq.
+ * Returns 0 if the tag is missing, malformed or from an earlier boot.
+ */
+static uint32_t etag_to_seq(httpd_req_t *req) {
+    char tag[32];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", tag, sizeof(tag)) != ESP_OK) return 0;
+
+    unsigned long boot = 0, seq = 0;
+    if (sscanf(tag, "\"%lx-%lu\"", &boot, &seq) != 2 || boot != boot_id) return 0;
+    return (uint32_t)seq;
+}
+
+/**
+ * Answer with frame, or 500 without one. 304 if the client has it already.
+ * Releases the frame.
+ */
+static esp_err_t send_frame(httpd_req_t *req, camera_frame_t *frame, uint32_t known_seq) {
+    if (!frame) {
+        ESP_LOGW(TAG, "No frame available");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no frame");
+    }
+
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)boot_id, (unsigned long)frame->seq);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    esp_err_t res;
+    if (frame->seq == known_seq) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        res = httpd_resp_send(req, NULL, 0);
+    } else {
+        httpd_resp_set_type(req, "image/jpeg");
+        res = httpd_resp_send(req, (const char *)frame->buf, frame->len);
+    }
+    frame_ring_release(frame);
+    return res;
+}
+
+/**
+ * Holds the async copy of one request while it waits for a frame.
+ */
+static void snapshot_worker(void *arg) {
+    snapshot_job_t *job = (snapshot_job_t *)arg;
+
+    camera_frame_t *frame = frame_ring_acquire(job->after_seq, job->timeout);
+    // Long poll ran out: the client still gets the latest, as a 304
+    if (!frame && job->after_seq) frame = frame_ring_acquire(0, 0);
+    send_frame(job->req, frame, job->known_seq);
+
+    httpd_req_async_handler_complete(job->req);
+    free(job);
+    xSemaphoreGive(waiter_slots);
+    vTaskDelete(NULL);
+}
+
+/**
+ * Hand the request to a waiter task. Returns false if none can be started,
+ * in which case req is untouched.
+ */
+static bool park_request(httpd_req_t *req, uint32_t known_seq, uint32_t after_seq, TickType_t timeout) {
+    if (xSemaphoreTake(waiter_slots, 0) != pdTRUE) return false;
+
+    snapshot_job_t *job = malloc(sizeof(*job));
+    if (!job) {
+        xSemaphoreGive(waiter_slots);
+        return false;
+    }
+    job->known_seq = known_seq;
+    job->after_seq = after_seq;
+    job->timeout = timeout;
+
+    if (httpd_req_async_handler_begin(req, &job->req) != ESP_OK) {
+        free(job);
+        xSemaphoreGive(waiter_slots);
+        return false;
+    }
+    if (xTaskCreate(snapshot_worker, "snapshot", SNAPSHOT_TASK_STACK, job, SNAPSHOT_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start snapshot waiter");
+        httpd_req_async_handler_complete(job->req);
+        free(job);
+        xSemaphoreGive(waiter_slots);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * GET /api/camera/snapshot[?wait=ms]
+ * Newest JPEG with an ETag of its sequence number. A matching If-None-Match
+ * gets 304, or with ?wait the request holds until a newer frame shows up.
+ * Anything that has to wait, including the first request after boot, is
+ * answered from a waiter task; the handler itself never blocks.
+ */
+static esp_err_t h_snapshot(httpd_req_t *req) {
+    uint32_t known_seq = etag_to_seq(req);
+
+    int wait_ms = 0;
+    char q[32], val[8];
+    if (httpd_req_get_url_query_str(req, q, sizeof(q)) == ESP_OK &&
+        httpd_query_key_value(q, "wait", val, sizeof(val)) == ESP_OK) {
+        wait_ms = atoi(val);
+        if (wait_ms < 0) wait_ms = 0;
+        if (wait_ms > SNAPSHOT_MAX_WAIT_MS) wait_ms = SNAPSHOT_MAX_WAIT_MS;
+    }
+
+    // Long poll: serve at once if something newer is already there
+    uint32_t after_seq = known_seq && wait_ms ? known_seq : 0;
+    camera_frame_t *frame = frame_ring_acquire(after_seq, 0);
+    if (frame) return send_frame(req, frame, known_seq);
+
+    TickType_t timeout = after_seq ? pdMS_TO_TICKS(wait_ms) : SNAPSHOT_TIMEOUT;
+    if (park_request(req, known_seq, after_seq, timeout)) return ESP_OK;
+
+    // Every waiter is busy: no long poll, just the latest if there is one
+    return send_frame(req, frame_ring_acquire(0, 0), known_seq);
+}
+
+esp_err_t snapshot_register_handlers(httpd_handle_t server) {
+    if (!boot_id) boot_id = esp_random() | 1;
+    if (!waiter_slots) {
+        waiter_slots = xSemaphoreCreateCounting(CAMERA_MAX_SNAPSHOT_WAITERS, CAMERA_MAX_SNAPSHOT_WAITERS);
+        if (!waiter_slots) return ESP_ERR_NO_MEM;
+    }
+
+    const httpd_uri_t uri = {.uri = "/api/camera/snapshot", .method = HTTP_GET, .handler = h_snapshot};
+    return httpd_register_uri_handler(server, &uri);
+}
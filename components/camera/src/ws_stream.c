@@ -0,0 +1,391 @@
+#include "ws_stream.h"
+#include "camera.h"
+#include "camera_stats.h"
+#include "frame_ring.h"
+#include "mjpeg_stream.h"
+#include "rate_ctrl.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ws_stream";
+
+#define WS_TASK_STACK 4096
+#define WS_TASK_PRIO  4
+
+// How often a blocked sender wakes up to answer pings and notice closes
+#define WS_POLL_TICKS pdMS_TO_TICKS(100)
+
+// A client that acknowledges nothing for this long is dropped
+#define WS_STALL_TIMEOUT_US (10 * 1000000)
+
+// Largest message accepted from a client; acks and control are tiny
+#define WS_MAX_RX 256
+
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE  0x8
+#define WS_OP_PONG   0xA
+#define WS_MAX_CTRL_PAYLOAD 125
+
+typedef struct {
+    uint32_t seq;
+    int64_t timestamp_us;
+} inflight_t;
+
+/**
+ * One WebSocket viewer. The sender task owns every write to the socket;
+ * the httpd task only records what it received and wakes the sender.
+ * The slot is reused once both the task and the httpd session are gone.
+ */
+typedef struct {
+    bool in_use;
+    bool sess_open;
+    bool task_running;
+    bool closing;
+    bool close_reply;           // client sent CLOSE, echo one back
+    httpd_handle_t server;
+    int fd;
+    SemaphoreHandle_t wake;     // given by the httpd side; outlives the task
+    int stats_id;
+    uint8_t credits;
+    inflight_t inflight[WS_STREAM_MAX_CREDITS];
+    uint8_t inflight_head;
+    uint8_t inflight_count;
+    int64_t last_ack_us;
+    bool pong_pending;
+    uint8_t pong_len;
+    uint8_t pong[WS_MAX_CTRL_PAYLOAD];
+} ws_client_t;
+
+static portMUX_TYPE ws_mux = portMUX_INITIALIZER_UNLOCKED;
+static ws_client_t clients[CAMERA_MAX_WS_CLIENTS];
+
+static ws_stream_control_cb_t control_cb = NULL;
+static void *control_arg = NULL;
+
+static size_t ws_frame_head(uint8_t *p, uint8_t opcode, size_t len) {
+    p[0] = 0x80 | opcode;   // FIN; frames are never fragmented
+    if (len < 126) {
+        p[1] = len;
+        return 2;
+    }
+    if (len <= 0xFFFF) {
+        p[1] = 126;
+        p[2] = len >> 8;
+        p[3] = len;
+        return 4;
+    }
+    p[1] = 127;
+    for (int i = 0; i < 8; i++) p[2 + i] = (uint64_t)len >> (56 - 8 * i);
+    return 10;
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = v >> (8 * i);
+}
+
+static esp_err_t send_control(int fd, uint8_t opcode, const uint8_t *payload, size_t len) {
+    uint8_t buf[2 + WS_MAX_CTRL_PAYLOAD];
+    size_t hlen = ws_frame_head(buf, opcode, len);
+    memcpy(buf + hlen, payload, len);
+    struct iovec iov = {.iov_base = buf, .iov_len = hlen + len};
+    return mjpeg_stream_send_iov(fd, &iov, 1);
+}
+
+/**
+ * WebSocket header, frame header and JPEG in one gathered send.
+ */
+static esp_err_t send_frame(int fd, const camera_frame_t *frame) {
+    uint8_t head[10 + WS_STREAM_HEADER_SIZE];
+    size_t hlen = ws_frame_head(head, WS_OP_BINARY, WS_STREAM_HEADER_SIZE + frame->len);
+    uint8_t *h = head + hlen;
+    put_le32(h, frame->seq);
+    put_le32(h + 4, frame->len);
+    put_le32(h + 8, (uint32_t)frame->timestamp_us);
+    put_le32(h + 12, (uint32_t)((uint64_t)frame->timestamp_us >> 32));
+    struct iovec iov[2] = {
+        {.iov_base = head, .iov_len = hlen + WS_STREAM_HEADER_SIZE},
+        {.iov_base = frame->buf, .iov_len = frame->len},
+    };
+    return mjpeg_stream_send_iov(fd, iov, 2);
+}
+
+// Call with ws_mux held
+static void release_if_done(ws_client_t *c) {
+    if (!c->sess_open && !c->task_running) c->in_use = false;
+}
+
+/**
+ * Once the session destructor has run, httpd may hand the fd to a new
+ * connection; check this right before every write.
+ */
+static bool sess_writable(ws_client_t *c, bool even_if_closing) {
+    portENTER_CRITICAL(&ws_mux);
+    bool ok = c->sess_open && (even_if_closing || !c->closing);
+    portEXIT_CRITICAL(&ws_mux);
+    return ok;
+}
+
+static void ws_sender(void *arg) {
+    ws_client_t *c = (ws_client_t *)arg;
+    int fd = c->fd;
+    uint32_t last_seq = 0;
+
+    // Frames are latency-bound, not throughput-bound
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    while (true) {
+        uint8_t pong[WS_MAX_CTRL_PAYLOAD];
+        uint8_t pong_len = 0;
+        bool pong_pending, closing, blocked;
+        int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&ws_mux);
+        pong_pending = c->pong_pending;
+        if (pong_pending) {
+            pong_len = c->pong_len;
+            memcpy(pong, c->pong, pong_len);
+            c->pong_pending = false;
+        }
+        closing = c->closing;
+        blocked = c->inflight_count >= c->credits;
+        int64_t last_ack = c->last_ack_us;
+        portEXIT_CRITICAL(&ws_mux);
+
+        if (closing) break;
+        if (pong_pending && (!sess_writable(c, false) || send_control(fd, WS_OP_PONG, pong, pong_len) != ESP_OK))
+            break;
+
+        if (blocked) {
+            if (now - last_ack > WS_STALL_TIMEOUT_US) {
+                ESP_LOGW(TAG, "fd %d stopped acknowledging, dropping it", fd);
+                break;
+            }
+            xSemaphoreTake(c->wake, WS_POLL_TICKS);
+            continue;
+        }
+
+        camera_frame_t *frame = frame_ring_acquire(last_seq, WS_POLL_TICKS);
+        if (!frame) continue;
+        uint32_t skipped = last_seq ? frame->seq - last_seq - 1 : 0;
+        last_seq = frame->seq;
+        if (!sess_writable(c, false)) {
+            frame_ring_release(frame);
+            break;
+        }
+
+        int64_t send_start = esp_timer_get_time();
+        esp_err_t res = send_frame(fd, frame);
+        int64_t send_us = esp_timer_get_time() - send_start;
+        int64_t queue_us = send_start - frame->timestamp_us;
+        inflight_t sent = {.seq = frame->seq, .timestamp_us = frame->timestamp_us};
+        size_t len = frame->len;
+        frame_ring_release(frame);
+        if (res != ESP_OK) break;
+
+        portENTER_CRITICAL(&ws_mux);
+        c->inflight[(c->inflight_head + c->inflight_count) % WS_STREAM_MAX_CREDITS] = sent;
+        c->inflight_count++;
+        if (c->inflight_count == 1) c->last_ack_us = send_start;   // stall clock starts now
+        portEXIT_CRITICAL(&ws_mux);
+
+        rate_ctrl_record_frame(len, send_us);
+        camera_stats_client_frame(c->stats_id, queue_us, send_us, skipped);
+    }
+
+    if (c->close_reply && sess_writable(c, true)) {
+        uint8_t status[2] = {0x03, 0xE8};   // 1000, normal closure
+        send_control(fd, WS_OP_CLOSE, status, sizeof(status));
+    }
+    camera_stats_client_close(c->stats_id);
+    // Only our own session; a purged fd may already belong to someone else
+    if (sess_writable(c, true)) httpd_sess_trigger_close(c->server, fd);
+
+    portENTER_CRITICAL(&ws_mux);
+    c->task_running = false;
+    release_if_done(c);
+    portEXIT_CRITICAL(&ws_mux);
+    vTaskDelete(NULL);
+}
+
+/**
+ * httpd session destructor: the socket is gone (closed by either side or
+ * purged as least recently used).
+ */
+static void ws_session_closed(void *ctx) {
+    ws_client_t *c = (ws_client_t *)ctx;
+    portENTER_CRITICAL(&ws_mux);
+    c->sess_open = false;
+    c->closing = true;
+    release_if_done(c);
+    portEXIT_CRITICAL(&ws_mux);
+    xSemaphoreGive(c->wake);
+}
+
+static void handle_ack(ws_client_t *c, uint32_t seq) {
+    int64_t now = esp_timer_get_time();
+    int64_t acked_ts = -1;
+
+    portENTER_CRITICAL(&ws_mux);
+    while (c->inflight_count && (int32_t)(seq - c->inflight[c->inflight_head].seq) >= 0) {
+        acked_ts = c->inflight[c->inflight_head].timestamp_us;
+        c->inflight_head = (c->inflight_head + 1) % WS_STREAM_MAX_CREDITS;
+        c->inflight_count--;
+    }
+    if (acked_ts >= 0) c->last_ack_us = now;
+    portEXIT_CRITICAL(&ws_mux);
+
+    if (acked_ts >= 0) {
+        camera_stats_client_ack(c->stats_id, now - acked_ts);
+        xSemaphoreGive(c->wake);
+    }
+}
+
+static void handle_text(ws_client_t *c, char *msg, size_t len) {
+    cJSON *j = cJSON_Parse(msg);
+    cJSON *credits = j ? cJSON_GetObjectItem(j, "credits") : NULL;
+    if (cJSON_IsNumber(credits)) {
+        int n = credits->valueint;
+        if (n < 1) n = 1;
+        if (n > WS_STREAM_MAX_CREDITS) n = WS_STREAM_MAX_CREDITS;
+        portENTER_CRITICAL(&ws_mux);
+        c->credits = n;
+        portEXIT_CRITICAL(&ws_mux);
+        xSemaphoreGive(c->wake);
+    } else if (control_cb) {
+        control_cb(msg, len, control_arg);
+    }
+    cJSON_Delete(j);
+}
+
+/**
+ * New connection: claim a slot and start its sender.
+ */
+static esp_err_t ws_open(httpd_req_t *req) {
+    ws_client_t *c = NULL;
+    portENTER_CRITICAL(&ws_mux);
+    for (int i = 0; i < CAMERA_MAX_WS_CLIENTS; i++) {
+        if (!clients[i].in_use) {
+            c = &clients[i];
+            SemaphoreHandle_t wake = c->wake;
+            memset(c, 0, sizeof(*c));
+            c->wake = wake;
+            c->in_use = true;
+            c->sess_open = true;
+            c->task_running = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&ws_mux);
+    if (!c) {
+        ESP_LOGW(TAG, "Too many WebSocket viewers");
+        return ESP_FAIL;
+    }
+
+    c->server = req->handle;
+    c->fd = httpd_req_to_sockfd(req);
+    c->credits = WS_STREAM_DEFAULT_CREDITS;
+    c->last_ack_us = esp_timer_get_time();
+    c->stats_id = camera_stats_client_open(c->fd, "ws");
+    xSemaphoreTake(c->wake, 0);   // clear a give left over from the last viewer
+
+    if (xTaskCreate(ws_sender, "cam_ws", WS_TASK_STACK, c, WS_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start WebSocket sender");
+        camera_stats_client_close(c->stats_id);
+        portENTER_CRITICAL(&ws_mux);
+        c->in_use = false;
+        portEXIT_CRITICAL(&ws_mux);
+        return ESP_FAIL;
+    }
+
+    // httpd keeps this with the session and calls ws_session_closed on close
+    req->sess_ctx = c;
+    req->free_ctx = ws_session_closed;
+    ESP_LOGI(TAG, "fd %d connected", c->fd);
+    return ESP_OK;
+}
+
+/**
+ * GET /ws/camera
+ * Called once for the handshake, then for every message the client sends.
+ * Control frames are handled here too so that only the sender task ever
+ * writes to the socket.
+ */
+static esp_err_t ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) return ws_open(req);
+
+    ws_client_t *c = (ws_client_t *)req->sess_ctx;
+    if (!c) return ESP_FAIL;
+
+    uint8_t buf[WS_MAX_RX + 1];
+    httpd_ws_frame_t pkt = {0};
+    esp_err_t res = httpd_ws_recv_frame(req, &pkt, 0);
+    if (res != ESP_OK) return res;
+    if (pkt.len > WS_MAX_RX) {
+        ESP_LOGW(TAG, "fd %d: %u byte message rejected", c->fd, (unsigned)pkt.len);
+        return ESP_FAIL;
+    }
+    pkt.payload = buf;
+    if (pkt.len) {
+        res = httpd_ws_recv_frame(req, &pkt, pkt.len);
+        if (res != ESP_OK) return res;
+    }
+
+    switch (pkt.type) {
+    case HTTPD_WS_TYPE_BINARY:
+        if (pkt.len >= 4) handle_ack(c, buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24);
+        break;
+    case HTTPD_WS_TYPE_TEXT:
+        buf[pkt.len] = '\0';
+        handle_text(c, (char *)buf, pkt.len);
+        break;
+    case HTTPD_WS_TYPE_PING:
+        portENTER_CRITICAL(&ws_mux);
+        c->pong_len = pkt.len > WS_MAX_CTRL_PAYLOAD ? WS_MAX_CTRL_PAYLOAD : pkt.len;
+        memcpy(c->pong, buf, c->pong_len);
+        c->pong_pending = true;
+        portEXIT_CRITICAL(&ws_mux);
+        xSemaphoreGive(c->wake);
+        break;
+    case HTTPD_WS_TYPE_CLOSE:
+        portENTER_CRITICAL(&ws_mux);
+        c->closing = true;
+        c->close_reply = true;
+        portEXIT_CRITICAL(&ws_mux);
+        xSemaphoreGive(c->wake);
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+void ws_stream_set_control_cb(ws_stream_control_cb_t cb, void *arg) {
+    control_arg = arg;
+    control_cb = cb;
+}
+
+esp_err_t ws_stream_register_handlers(httpd_handle_t server) {
+    for (int i = 0; i < CAMERA_MAX_WS_CLIENTS; i++) {
+        if (!clients[i].wake) {
+            clients[i].wake = xSemaphoreCreateBinary();
+            if (!clients[i].wake) return ESP_ERR_NO_MEM;
+        }
+    }
+
+    const httpd_uri_t uri = {
+        .uri = "/ws/camera",
+        .method = HTTP_GET,
+        .handler = ws_handler,
+        .is_websocket = true,
+        .handle_ws_control_frames = true,
+    };
+    return httpd_register_uri_handler(server, &uri);
+}
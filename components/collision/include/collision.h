@@ -0,0 +1,77 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "collision_detect.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct
+    {
+        collision_kind_t kind;
+        int64_t timestamp_us; // of the IMU sample that tripped the detector
+        uint32_t latency_us;  // from that sample to the motors being stopped
+        float jerk_gps;
+        float threshold_gps;
+    } collision_event_t;
+
+    typedef void (*collision_cb_t)(const collision_event_t *event, void *arg);
+
+    typedef struct
+    {
+        collision_detect_config_t detect;
+        bool estop;   // stop the motors on a hit; off only to tune thresholds
+        int core;     // same core as the IMU sampler keeps the hand-off cheap
+        int priority; // above the sampler, so a pushed sample runs straight away
+    } collision_config_t;
+
+#define COLLISION_CONFIG_DEFAULT() {               \
+    .detect = COLLISION_DETECT_CONFIG_DEFAULT(),   \
+    .estop = true,                                 \
+    .core = 1,                                     \
+    .priority = 22,                                \
+}
+
+    typedef struct
+    {
+        uint32_t samples;
+        uint32_t jerk_hits;
+        uint32_t decel_hits;
+        uint32_t false_positives; // reported through collision_report_false_positive()
+        uint32_t last_latency_us;
+        uint32_t max_latency_us;
+        uint32_t sample_period_us; // latest, to compare the latency against
+        float noise_gps;          // learned jerk noise
+        float threshold_gps;      // current jerk threshold
+    } collision_stats_t;
+
+    /**
+     * Watch the IMU sample stream for impacts and call motor_emergency_stop()
+     * from the consumer task itself, before anything else sees the sample.
+     * Needs the IMU sampler (or FIFO) running; for the advertised latency
+     * configure it at 1.66 kHz and ±8 g. Clear a stop with
+     * motor_clear_emergency_stop().
+     */
+    esp_err_t collision_start(const collision_config_t *config);
+
+    // Called on the detector task after the motors are stopped
+    void collision_register_cb(collision_cb_t cb, void *arg);
+
+    /**
+     * For the behaviour layer to flag the last stop as spurious, e.g. the
+     * robot drove on freely afterwards. Feeds the false-positive count.
+     */
+    void collision_report_false_positive(void);
+
+    void collision_get_stats(collision_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COLLISION_H
@@ -0,0 +1,78 @@
+#ifndef COLLISION_DETECT_H
+#define COLLISION_DETECT_H
+
+// Collision detector kernel: accelerometer samples in, a verdict out. The
+// motor stop and the task around it live in collision.c, which keeps this
+// part replayable over recorded IMU traces.
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        COLLISION_NONE = 0,
+        COLLISION_JERK,  // sudden change in horizontal acceleration
+        COLLISION_DECEL, // sustained horizontal deceleration while driving
+    } collision_kind_t;
+
+    typedef struct
+    {
+        float jerk_floor_gps; // lowest jerk threshold, g/s
+        float noise_k;        // plus this many times the learned jerk noise
+        float speed_gain;     // threshold grows by this fraction at full commanded speed
+        float decel_g;        // horizontal deceleration that counts as blocked...
+        float decel_ms;       // ...when it lasts this long
+        float blank_ms;       // ignore everything this long after a motor command
+        float smooth_ms;      // low-pass on linear acceleration before differencing
+        float gravity_s;      // time constant of the gravity estimate
+        float noise_s;        // time constant of the jerk noise estimate
+    } collision_detect_config_t;
+
+#define COLLISION_DETECT_CONFIG_DEFAULT() { \
+    .jerk_floor_gps = 20.0f,                \
+    .noise_k = 6.0f,                        \
+    .speed_gain = 1.0f,                     \
+    .decel_g = 0.5f,                        \
+    .decel_ms = 15.0f,                      \
+    .blank_ms = 150.0f,                     \
+    .smooth_ms = 3.0f,                      \
+    .gravity_s = 0.5f,                      \
+    .noise_s = 1.0f,                        \
+}
+
+    typedef struct
+    {
+        collision_detect_config_t cfg;
+        bool primed;
+        float gravity[3]; // slow average of the accelerometer
+        float lin[2];     // smoothed horizontal linear acceleration, g
+        float noise;      // mean jerk while nothing happens, g/s
+        float decel_s;    // how long the decel condition has held
+        float blank_s;    // remaining blanking time
+
+        // Last update, for stats
+        float jerk;
+        float threshold;
+    } collision_detect_t;
+
+    void collision_detect_init(collision_detect_t *d, const collision_detect_config_t *cfg);
+
+    /**
+     * Feed one accelerometer sample in g. speed is the highest commanded
+     * motor speed as a fraction (0..1); command_changed is true when the
+     * motors were just told to do something new, which blanks detection
+     * while the robot accelerates on purpose. After a detection the
+     * detector blanks itself too, so one impact reports once.
+     */
+    collision_kind_t collision_detect_update(collision_detect_t *d, float ax, float ay, float az, float dt,
+                                             float speed, bool command_changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COLLISION_DETECT_H
@@ -0,0 +1,177 @@
+#include "collision.h"
+#include "collision_detect.h"
+#include "imu.h"
+#include "motor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define COLLISION_TASK_STACK 3072
+#define COLLISION_RING_LEN 32
+#define COLLISION_BATCH 8
+
+// Longer gaps mean the stream stopped; restart the detector instead
+#define MAX_DT_US 50000
+
+// Tag for logging
+static const char *TAG = "COLLISION";
+
+static collision_config_t cfg;
+static TaskHandle_t collision_task_handle = NULL;
+static imu_ring_t *ring = NULL;
+static collision_cb_t user_cb = NULL;
+static void *user_arg = NULL;
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static collision_stats_t stats;
+
+static void on_hit(collision_detect_t *d, collision_kind_t kind, const imu_raw_sample_t *s)
+{
+    // Stop first; everything else can wait
+    if (cfg.estop)
+        motor_emergency_stop();
+    uint32_t latency = esp_timer_get_time() - s->timestamp_us;
+
+    collision_event_t ev = {
+        .kind = kind,
+        .timestamp_us = s->timestamp_us,
+        .latency_us = latency,
+        .jerk_gps = d->jerk,
+        .threshold_gps = d->threshold,
+    };
+
+    portENTER_CRITICAL(&stats_mux);
+    if (kind == COLLISION_JERK)
+        stats.jerk_hits++;
+    else
+        stats.decel_hits++;
+    stats.last_latency_us = latency;
+    if (latency > stats.max_latency_us)
+        stats.max_latency_us = latency;
+    portEXIT_CRITICAL(&stats_mux);
+
+    ESP_LOGW(TAG, "%s: jerk %.0f g/s (threshold %.0f), stopped %lu us after the sample",
+             kind == COLLISION_JERK ? "Impact" : "Blocked", d->jerk, d->threshold, (unsigned long)latency);
+    if (user_cb)
+        user_cb(&ev, user_arg);
+}
+
+static void collision_task(void *arg)
+{
+    collision_detect_t det;
+    collision_detect_init(&det, &cfg.detect);
+    imu_raw_sample_t batch[COLLISION_BATCH];
+    int64_t last_ts = 0;
+    uint32_t last_cmd = motor_get_command_seq();
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        imu_scale_t scale;
+        imu_get_scale(&scale);
+
+        size_t n;
+        while ((n = imu_ring_pop(ring, batch, COLLISION_BATCH)) > 0)
+        {
+            // Taken across pops, since the DRDY sampler hands over one
+            // sample at a time
+            uint32_t period_us = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                const imu_raw_sample_t *s = &batch[i];
+                int64_t dt_us = s->timestamp_us - last_ts;
+                last_ts = s->timestamp_us;
+                if (dt_us <= 0 || dt_us > MAX_DT_US)
+                {
+                    collision_detect_init(&det, &cfg.detect);
+                    dt_us = 0;
+                }
+                else
+                {
+                    period_us = dt_us;
+                }
+
+                uint32_t cmd = motor_get_command_seq();
+                float speed = motor_get_max_speed() * 0.01f;
+                collision_kind_t hit = collision_detect_update(
+                    &det,
+                    s->accelerometer.x * scale.accel_g_per_lsb,
+                    s->accelerometer.y * scale.accel_g_per_lsb,
+                    s->accelerometer.z * scale.accel_g_per_lsb,
+                    dt_us * 1e-6f, speed, cmd != last_cmd);
+                last_cmd = cmd;
+
+                if (hit != COLLISION_NONE)
+                {
+                    on_hit(&det, hit, s);
+                    // The stop itself is a motor command; don't blank twice
+                    last_cmd = motor_get_command_seq();
+                }
+            }
+
+            portENTER_CRITICAL(&stats_mux);
+            stats.samples += n;
+            stats.noise_gps = det.noise;
+            stats.threshold_gps = det.threshold;
+            if (period_us)
+                stats.sample_period_us = period_us;
+            portEXIT_CRITICAL(&stats_mux);
+        }
+    }
+}
+
+esp_err_t collision_start(const collision_config_t *config)
+{
+    if (collision_task_handle)
+        return ESP_ERR_INVALID_STATE;
+
+    collision_config_t defaults = COLLISION_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.core < 0 || cfg.core >= portNUM_PROCESSORS || cfg.priority >= configMAX_PRIORITIES)
+        return ESP_ERR_INVALID_ARG;
+
+    if (xTaskCreatePinnedToCore(collision_task, "collision", COLLISION_TASK_STACK, NULL, cfg.priority,
+                                &collision_task_handle, cfg.core) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    // The first push can wake the task before ring is assigned; keep it
+    // suspended until then
+    vTaskSuspend(collision_task_handle);
+    ring = imu_ring_create(COLLISION_RING_LEN, collision_task_handle);
+    if (!ring)
+    {
+        vTaskDelete(collision_task_handle);
+        collision_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    vTaskResume(collision_task_handle);
+
+    imu_config_t imu;
+    imu_get_config(&imu);
+    if (imu.odr < IMU_ODR_1660HZ)
+        ESP_LOGW(TAG, "IMU at %lu Hz; stops can lag by up to a sample period", (unsigned long)imu_odr_hz(imu.odr));
+    ESP_LOGI(TAG, "Collision detection running%s", cfg.estop ? "" : " (e-stop disabled)");
+    return ESP_OK;
+}
+
+void collision_register_cb(collision_cb_t cb, void *arg)
+{
+    user_arg = arg;
+    user_cb = cb;
+}
+
+void collision_report_false_positive(void)
+{
+    portENTER_CRITICAL(&stats_mux);
+    stats.false_positives++;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void collision_get_stats(collision_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
@@ -0,0 +1,86 @@
+#include "collision_detect.h"
+#include <math.h>
+
+void collision_detect_init(collision_detect_t *d, const collision_detect_config_t *cfg)
+{
+    d->cfg = *cfg;
+    d->primed = false;
+    d->noise = 0.0f;
+    d->decel_s = 0.0f;
+    d->blank_s = 0.0f;
+    d->jerk = 0.0f;
+    d->threshold = cfg->jerk_floor_gps;
+}
+
+// Weight of a new sample in a first-order low-pass with time constant tau
+static inline float lp_alpha(float dt, float tau)
+{
+    return dt / (tau + dt);
+}
+
+collision_kind_t collision_detect_update(collision_detect_t *d, float ax, float ay, float az, float dt,
+                                         float speed, bool command_changed)
+{
+    const collision_detect_config_t *c = &d->cfg;
+    if (!d->primed || dt <= 0.0f)
+    {
+        d->gravity[0] = ax;
+        d->gravity[1] = ay;
+        d->gravity[2] = az;
+        d->lin[0] = d->lin[1] = 0.0f;
+        d->primed = true;
+        return COLLISION_NONE;
+    }
+
+    // Gravity follows slowly, so tilting on a slope isn't linear acceleration
+    float kg = lp_alpha(dt, c->gravity_s);
+    d->gravity[0] += kg * (ax - d->gravity[0]);
+    d->gravity[1] += kg * (ay - d->gravity[1]);
+    d->gravity[2] += kg * (az - d->gravity[2]);
+
+    // Horizontal linear acceleration, smoothed just enough to take the
+    // sample-to-sample sensor noise out of the derivative
+    float ks = lp_alpha(dt, c->smooth_ms * 0.001f);
+    float lx = d->lin[0] + ks * ((ax - d->gravity[0]) - d->lin[0]);
+    float ly = d->lin[1] + ks * ((ay - d->gravity[1]) - d->lin[1]);
+    float dx = lx - d->lin[0];
+    float dy = ly - d->lin[1];
+    d->lin[0] = lx;
+    d->lin[1] = ly;
+
+    d->jerk = sqrtf(dx * dx + dy * dy) / dt;
+    d->threshold = (c->jerk_floor_gps + c->noise_k * d->noise) * (1.0f + c->speed_gain * speed);
+
+    if (command_changed)
+        d->blank_s = c->blank_ms * 0.001f;
+    if (d->blank_s > 0.0f)
+    {
+        d->blank_s -= dt;
+        d->decel_s = 0.0f;
+        return COLLISION_NONE;
+    }
+
+    collision_kind_t hit = COLLISION_NONE;
+    if (d->jerk > d->threshold)
+        hit = COLLISION_JERK;
+
+    // Pushing against something: the motors drive but the body decelerates
+    float lin_mag2 = lx * lx + ly * ly;
+    if (speed > 0.0f && lin_mag2 > c->decel_g * c->decel_g)
+        d->decel_s += dt;
+    else
+        d->decel_s = 0.0f;
+    if (hit == COLLISION_NONE && d->decel_s >= c->decel_ms * 0.001f)
+        hit = COLLISION_DECEL;
+
+    if (hit != COLLISION_NONE)
+    {
+        d->blank_s = c->blank_ms * 0.001f;
+        d->decel_s = 0.0f;
+        return hit;
+    }
+
+    // Learn the noise only from quiet samples, so impacts don't raise it
+    d->noise += lp_alpha(dt, c->noise_s) * (d->jerk - d->noise);
+    return COLLISION_NONE;
+}
@@ -0,0 +1,118 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/i2c_master.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Queued transactions run highest priority first. A transfer in flight
+    // always finishes; priority decides which one goes next.
+    typedef enum
+    {
+        I2C_BUS_PRIO_HIGH = 0, // sample reads on a deadline
+        I2C_BUS_PRIO_NORMAL,
+        I2C_BUS_PRIO_LOW, // configuration writes
+        I2C_BUS_PRIO_COUNT,
+    } i2c_bus_prio_t;
+
+    typedef struct i2c_bus i2c_bus_t;
+    typedef struct i2c_bus_device i2c_bus_device_t;
+
+    typedef struct
+    {
+        i2c_port_num_t port;
+        int sda_gpio;
+        int scl_gpio;
+        int task_priority; // at least that of the tasks waiting on the bus
+        int task_core;     // tskNO_AFFINITY for either
+    } i2c_bus_config_t;
+
+    /**
+     * Called on the bus task when a transaction is done. Keep it short:
+     * the next transaction waits for it.
+     */
+    typedef void (*i2c_bus_done_cb_t)(esp_err_t result, void *arg);
+
+    // Bytes of tx data copied into the queue, so short writes can be
+    // submitted without keeping the buffer alive
+#define I2C_BUS_INLINE_TX 16
+
+    typedef struct
+    {
+        i2c_bus_device_t *dev;
+        i2c_bus_prio_t prio;
+        const uint8_t *tx; // copied if tx_len <= I2C_BUS_INLINE_TX, else must outlive the transaction
+        size_t tx_len;
+        uint8_t *rx; // filled before done is called
+        size_t rx_len;
+        uint32_t timeout_ms;
+        i2c_bus_done_cb_t done; // may be NULL
+        void *arg;
+    } i2c_bus_txn_t;
+
+    typedef struct
+    {
+        uint32_t submitted;
+        uint32_t completed;
+        uint32_t errors;
+        uint32_t rejected;     // queue full at submit
+        uint32_t wait_mean_us; // submit to start of transfer
+        uint32_t wait_max_us;
+        uint32_t xfer_mean_us; // transfer alone
+        uint32_t xfer_max_us;
+    } i2c_bus_prio_stats_t;
+
+    typedef struct
+    {
+        i2c_bus_prio_stats_t prio[I2C_BUS_PRIO_COUNT];
+        uint32_t window_ms; // since creation or the last reset
+        uint32_t busy_ms;   // spent in transfers within the window
+        float utilisation;  // busy_ms / window_ms
+    } i2c_bus_stats_t;
+
+    /**
+     * Create the bus on a port and start its scheduler task. Fails with
+     * ESP_ERR_INVALID_STATE if the port already has one; use i2c_bus_get().
+     */
+    esp_err_t i2c_bus_create(const i2c_bus_config_t *config, i2c_bus_t **out);
+
+    // The bus already created on port, or NULL
+    i2c_bus_t *i2c_bus_get(i2c_port_num_t port);
+
+    esp_err_t i2c_bus_add_device(i2c_bus_t *bus, uint16_t address, uint32_t scl_hz, i2c_bus_device_t **out);
+
+    /**
+     * Queue a transaction without waiting. Returns ESP_ERR_NO_MEM if that
+     * priority's queue is full; done is not called then.
+     */
+    esp_err_t i2c_bus_submit(const i2c_bus_txn_t *txn);
+
+    /**
+     * Submit and wait for the result. Either length may be zero. Any number
+     * of tasks may call this on the same device; each is queued at its own
+     * priority.
+     */
+    esp_err_t i2c_bus_write_read(i2c_bus_device_t *dev, i2c_bus_prio_t prio, const uint8_t *tx, size_t tx_len,
+                                 uint8_t *rx, size_t rx_len, uint32_t timeout_ms);
+
+    void i2c_bus_get_stats(i2c_bus_t *bus, i2c_bus_stats_t *out);
+    void i2c_bus_reset_stats(i2c_bus_t *bus);
+
+    /**
+     * Register GET /api/i2c/stats, reporting every bus created so far.
+     */
+    esp_err_t i2c_bus_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // I2C_BUS_H
@@ -0,0 +1,366 @@
+#include "i2c_bus.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define QUEUE_DEPTH 16
+#define BUS_TASK_STACK 3072
+
+// Tag for logging
+static const char *TAG = "I2C_BUS";
+
+typedef struct
+{
+    i2c_bus_txn_t txn;
+    uint8_t inline_tx[I2C_BUS_INLINE_TX];
+    int64_t submitted_us;
+} queued_txn_t;
+
+typedef struct
+{
+    i2c_bus_prio_stats_t out;
+    uint64_t wait_sum_us;
+    uint64_t xfer_sum_us;
+} prio_acc_t;
+
+struct i2c_bus
+{
+    i2c_port_num_t port;
+    i2c_master_bus_handle_t handle;
+    QueueHandle_t queues[I2C_BUS_PRIO_COUNT];
+    SemaphoreHandle_t pending; // one count per queued transaction, any priority
+    TaskHandle_t task;
+
+    portMUX_TYPE stats_mux;
+    prio_acc_t acc[I2C_BUS_PRIO_COUNT];
+    int64_t window_start_us;
+    uint64_t busy_us;
+};
+
+struct i2c_bus_device
+{
+    i2c_bus_t *bus;
+    i2c_master_dev_handle_t handle;
+};
+
+// One blocking i2c_bus_write_read() call, on the caller's stack. Each call
+// waits on its own semaphore, so callers sharing a device still queue at
+// their own priorities.
+typedef struct
+{
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} sync_call_t;
+
+static i2c_bus_t *buses[SOC_I2C_NUM];
+
+static esp_err_t run(const queued_txn_t *q)
+{
+    const i2c_bus_txn_t *t = &q->txn;
+    const uint8_t *tx = t->tx_len <= I2C_BUS_INLINE_TX ? q->inline_tx : t->tx;
+    int timeout = t->timeout_ms;
+    i2c_master_dev_handle_t dev = t->dev->handle;
+
+    if (t->rx_len == 0)
+        return i2c_master_transmit(dev, tx, t->tx_len, timeout);
+    if (t->tx_len == 0)
+        return i2c_master_receive(dev, t->rx, t->rx_len, timeout);
+    return i2c_master_transmit_receive(dev, tx, t->tx_len, t->rx, t->rx_len, timeout);
+}
+
+/**
+ * The only task that touches the bus. Each pass takes the oldest
+ * transaction from the highest non-empty priority queue, so a burst of
+ * low-priority writes delays a sample read by one transfer at most.
+ */
+static void bus_task(void *arg)
+{
+    i2c_bus_t *bus = (i2c_bus_t *)arg;
+    queued_txn_t q;
+
+    while (true)
+    {
+        xSemaphoreTake(bus->pending, portMAX_DELAY);
+
+        int prio;
+        for (prio = 0; prio < I2C_BUS_PRIO_COUNT; prio++)
+        {
+            if (xQueueReceive(bus->queues[prio], &q, 0) == pdTRUE)
+                break;
+        }
+        if (prio == I2C_BUS_PRIO_COUNT)
+            continue;
+
+        int64_t start = esp_timer_get_time();
+        esp_err_t res = run(&q);
+        int64_t end = esp_timer_get_time();
+
+        uint32_t wait_us = start - q.submitted_us;
+        uint32_t xfer_us = end - start;
+        portENTER_CRITICAL(&bus->stats_mux);
+        prio_acc_t *a = &bus->acc[prio];
+        if (res == ESP_OK)
+            a->out.completed++;
+        else
+            a->out.errors++;
+        a->wait_sum_us += wait_us;
+        a->xfer_sum_us += xfer_us;
+        if (wait_us > a->out.wait_max_us)
+            a->out.wait_max_us = wait_us;
+        if (xfer_us > a->out.xfer_max_us)
+            a->out.xfer_max_us = xfer_us;
+        bus->busy_us += xfer_us;
+        portEXIT_CRITICAL(&bus->stats_mux);
+
+        if (res != ESP_OK)
+            ESP_LOGD(TAG, "Port %d: transaction failed: %s", bus->port, esp_err_to_name(res));
+        if (q.txn.done)
+            q.txn.done(res, q.txn.arg);
+    }
+}
+
+esp_err_t i2c_bus_create(const i2c_bus_config_t *config, i2c_bus_t **out)
+{
+    if (!config || !out || config->port < 0 || config->port >= SOC_I2C_NUM)
+        return ESP_ERR_INVALID_ARG;
+    if (buses[config->port])
+        return ESP_ERR_INVALID_STATE;
+
+    i2c_bus_t *bus = calloc(1, sizeof(i2c_bus_t));
+    if (!bus)
+        return ESP_ERR_NO_MEM;
+    bus->port = config->port;
+    portMUX_INITIALIZE(&bus->stats_mux);
+    bus->window_start_us = esp_timer_get_time();
+
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = config->port,
+        .sda_io_num = config->sda_gpio,
+        .scl_io_num = config->scl_gpio,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t ret = i2c_new_master_bus(&bus_cfg, &bus->handle);
+    if (ret != ESP_OK)
+    {
+        free(bus);
+        return ret;
+    }
+
+    ret = ESP_ERR_NO_MEM;
+    bus->pending = xSemaphoreCreateCounting(QUEUE_DEPTH * I2C_BUS_PRIO_COUNT, 0);
+    if (!bus->pending)
+        goto fail;
+    for (int i = 0; i < I2C_BUS_PRIO_COUNT; i++)
+    {
+        bus->queues[i] = xQueueCreate(QUEUE_DEPTH, sizeof(queued_txn_t));
+        if (!bus->queues[i])
+            goto fail;
+    }
+    if (xTaskCreatePinnedToCore(bus_task, "i2c_bus", BUS_TASK_STACK, bus, config->task_priority, &bus->task,
+                                config->task_core) != pdPASS)
+        goto fail;
+
+    buses[config->port] = bus;
+    *out = bus;
+    ESP_LOGI(TAG, "Bus %d on SDA %d / SCL %d", config->port, config->sda_gpio, config->scl_gpio);
+    return ESP_OK;
+
+fail:
+    for (int i = 0; i < I2C_BUS_PRIO_COUNT; i++)
+    {
+        if (bus->queues[i])
+            vQueueDelete(bus->queues[i]);
+    }
+    if (bus->pending)
+        vSemaphoreDelete(bus->pending);
+    i2c_del_master_bus(bus->handle);
+    free(bus);
+    return ret;
+}
+
+i2c_bus_t *i2c_bus_get(i2c_port_num_t port)
+{
+    if (port < 0 || port >= SOC_I2C_NUM)
+        return NULL;
+    return buses[port];
+}
+
+esp_err_t i2c_bus_add_device(i2c_bus_t *bus, uint16_t address, uint32_t scl_hz, i2c_bus_device_t **out)
+{
+    if (!bus || !out)
+        return ESP_ERR_INVALID_ARG;
+
+    i2c_bus_device_t *dev = calloc(1, sizeof(i2c_bus_device_t));
+    if (!dev)
+        return ESP_ERR_NO_MEM;
+    dev->bus = bus;
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = scl_hz,
+    };
+    esp_err_t ret = i2c_master_bus_add_device(bus->handle, &dev_cfg, &dev->handle);
+    if (ret != ESP_OK)
+    {
+        free(dev);
+        return ret;
+    }
+    *out = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_submit(const i2c_bus_txn_t *txn)
+{
+    if (!txn || !txn->dev || txn->prio < 0 || txn->prio >= I2C_BUS_PRIO_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if ((txn->tx_len && !txn->tx) || (txn->rx_len && !txn->rx) || (txn->tx_len == 0 && txn->rx_len == 0))
+        return ESP_ERR_INVALID_ARG;
+
+    i2c_bus_t *bus = txn->dev->bus;
+    queued_txn_t q;
+    q.txn = *txn;
+    if (txn->tx_len <= I2C_BUS_INLINE_TX)
+        memcpy(q.inline_tx, txn->tx, txn->tx_len);
+    q.submitted_us = esp_timer_get_time();
+
+    bool queued = xQueueSend(bus->queues[txn->prio], &q, 0) == pdTRUE;
+    portENTER_CRITICAL(&bus->stats_mux);
+    if (queued)
+        bus->acc[txn->prio].out.submitted++;
+    else
+        bus->acc[txn->prio].out.rejected++;
+    portEXIT_CRITICAL(&bus->stats_mux);
+    if (!queued)
+        return ESP_ERR_NO_MEM;
+
+    xSemaphoreGive(bus->pending);
+    return ESP_OK;
+}
+
+static void sync_done(esp_err_t result, void *arg)
+{
+    sync_call_t *call = (sync_call_t *)arg;
+    call->result = result;
+    xSemaphoreGive(call->done);
+}
+
+esp_err_t i2c_bus_write_read(i2c_bus_device_t *dev, i2c_bus_prio_t prio, const uint8_t *tx, size_t tx_len,
+                             uint8_t *rx, size_t rx_len, uint32_t timeout_ms)
+{
+    if (!dev)
+        return ESP_ERR_INVALID_ARG;
+
+    sync_call_t call;
+    call.done = xSemaphoreCreateBinaryStatic(&call.done_buf);
+
+    i2c_bus_txn_t txn = {
+        .dev = dev,
+        .prio = prio,
+        .tx = tx,
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .timeout_ms = timeout_ms,
+        .done = sync_done,
+        .arg = &call,
+    };
+
+    esp_err_t ret = i2c_bus_submit(&txn);
+    if (ret == ESP_OK)
+    {
+        // The bus task always calls back, after at most the queued
+        // transfers' own timeouts
+        xSemaphoreTake(call.done, portMAX_DELAY);
+        ret = call.result;
+    }
+    vSemaphoreDelete(call.done);
+    return ret;
+}
+
+void i2c_bus_get_stats(i2c_bus_t *bus, i2c_bus_stats_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&bus->stats_mux);
+    for (int i = 0; i < I2C_BUS_PRIO_COUNT; i++)
+    {
+        const prio_acc_t *a = &bus->acc[i];
+        uint32_t done = a->out.completed + a->out.errors;
+        out->prio[i] = a->out;
+        out->prio[i].wait_mean_us = done ? a->wait_sum_us / done : 0;
+        out->prio[i].xfer_mean_us = done ? a->xfer_sum_us / done : 0;
+    }
+    uint64_t window_us = now - bus->window_start_us;
+    uint64_t busy_us = bus->busy_us;
+    portEXIT_CRITICAL(&bus->stats_mux);
+
+    out->window_ms = window_us / 1000;
+    out->busy_ms = busy_us / 1000;
+    out->utilisation = window_us ? (float)busy_us / window_us : 0.0f;
+}
+
+void i2c_bus_reset_stats(i2c_bus_t *bus)
+{
+    portENTER_CRITICAL(&bus->stats_mux);
+    memset(bus->acc, 0, sizeof(bus->acc));
+    bus->busy_us = 0;
+    bus->window_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&bus->stats_mux);
+}
+
+// GET /api/i2c/stats -> [{port, window_ms, busy_ms, utilisation, high:{...}, normal:{...}, low:{...}}]
+static esp_err_t h_stats(httpd_req_t *req)
+{
+    static const char *prio_names[I2C_BUS_PRIO_COUNT] = {"high", "normal", "low"};
+
+    cJSON *arr = cJSON_CreateArray();
+    for (int port = 0; port < SOC_I2C_NUM; port++)
+    {
+        if (!buses[port])
+            continue;
+        i2c_bus_stats_t st;
+        i2c_bus_get_stats(buses[port], &st);
+
+        cJSON *b = cJSON_CreateObject();
+        cJSON_AddNumberToObject(b, "port", port);
+        cJSON_AddNumberToObject(b, "window_ms", st.window_ms);
+        cJSON_AddNumberToObject(b, "busy_ms", st.busy_ms);
+        cJSON_AddNumberToObject(b, "utilisation", st.utilisation);
+        for (int i = 0; i < I2C_BUS_PRIO_COUNT; i++)
+        {
+            const i2c_bus_prio_stats_t *p = &st.prio[i];
+            cJSON *j = cJSON_AddObjectToObject(b, prio_names[i]);
+            cJSON_AddNumberToObject(j, "submitted", p->submitted);
+            cJSON_AddNumberToObject(j, "completed", p->completed);
+            cJSON_AddNumberToObject(j, "errors", p->errors);
+            cJSON_AddNumberToObject(j, "rejected", p->rejected);
+            cJSON_AddNumberToObject(j, "wait_mean_us", p->wait_mean_us);
+            cJSON_AddNumberToObject(j, "wait_max_us", p->wait_max_us);
+            cJSON_AddNumberToObject(j, "xfer_mean_us", p->xfer_mean_us);
+            cJSON_AddNumberToObject(j, "xfer_max_us", p->xfer_max_us);
+        }
+        cJSON_AddItemToArray(arr, b);
+    }
+    char *out = cJSON_PrintUnformatted(arr);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(arr);
+    free(out);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_register_handlers(httpd_handle_t server)
+{
+    const httpd_uri_t uri = {.uri = "/api/i2c/stats", .method = HTTP_GET, .handler = h_stats};
+    return httpd_register_uri_handler(server, &uri);
+}
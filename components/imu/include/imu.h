@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "imu_ahrs.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -23,11 +27,367 @@ extern "C"
         imu_vector_t gyroscope;
     } imu_data_t;
 
+    // Output data rates. The values are the LSM6DS3 ODR register codes, which
+    // are also the matching FIFO ODR codes.
+    typedef enum
+    {
+        IMU_ODR_104HZ = 4,
+        IMU_ODR_208HZ = 5,
+        IMU_ODR_416HZ = 6,
+        IMU_ODR_833HZ = 7,
+        IMU_ODR_1660HZ = 8,
+    } imu_odr_t;
+
+    // Accelerometer full scale, as FS_XL bits in CTRL1_XL
+    typedef enum
+    {
+        IMU_ACCEL_FS_2G = 0x00,
+        IMU_ACCEL_FS_4G = 0x08,
+        IMU_ACCEL_FS_8G = 0x0C,
+        IMU_ACCEL_FS_16G = 0x04,
+    } imu_accel_fs_t;
+
+    // Gyro full scale, as FS_G/FS_125 bits in CTRL2_G
+    typedef enum
+    {
+        IMU_GYRO_FS_125DPS = 0x02,
+        IMU_GYRO_FS_245DPS = 0x00,
+        IMU_GYRO_FS_500DPS = 0x04,
+        IMU_GYRO_FS_1000DPS = 0x08,
+        IMU_GYRO_FS_2000DPS = 0x0C,
+    } imu_gyro_fs_t;
+
+    // Accelerometer anti-aliasing filter. The first four are BW_XL codes;
+    // AUTO lets the IMU pick from the ODR.
+    typedef enum
+    {
+        IMU_ACCEL_BW_400HZ = 0,
+        IMU_ACCEL_BW_200HZ = 1,
+        IMU_ACCEL_BW_100HZ = 2,
+        IMU_ACCEL_BW_50HZ = 3,
+        IMU_ACCEL_BW_AUTO = 4,
+    } imu_accel_bw_t;
+
+    typedef struct
+    {
+        imu_odr_t odr; // both sensors
+        imu_accel_fs_t accel_fs;
+        imu_gyro_fs_t gyro_fs;
+        imu_accel_bw_t accel_bw;
+    } imu_config_t;
+
+#define IMU_CONFIG_DEFAULT() {      \
+    .odr = IMU_ODR_104HZ,           \
+    .accel_fs = IMU_ACCEL_FS_2G,    \
+    .gyro_fs = IMU_GYRO_FS_245DPS,  \
+    .accel_bw = IMU_ACCEL_BW_AUTO,  \
+}
+
+    typedef struct
+    {
+        imu_data_t data;
+        int64_t timestamp_us; // from the IMU's sample clock, in esp_timer time
+    } imu_sample_t;
+
+    typedef struct
+    {
+        int16_t x;
+        int16_t y;
+        int16_t z;
+    } imu_raw_vector_t;
+
+    // Sensor counts as read from the IMU, before any scaling
+    typedef struct
+    {
+        imu_raw_vector_t gyroscope;
+        imu_raw_vector_t accelerometer;
+        int64_t timestamp_us;
+        uint32_t seq; // per-sample counter; gaps mean samples were never read
+    } imu_raw_sample_t;
+
+    typedef struct
+    {
+        imu_odr_t odr;
+        uint16_t watermark; // samples buffered in the IMU before it interrupts
+        int int_gpio;       // GPIO wired to the LSM6DS3 INT1 pin
+    } imu_fifo_config_t;
+
+#define IMU_FIFO_CONFIG_DEFAULT() { \
+    .odr = IMU_ODR_104HZ,           \
+    .watermark = 32,                \
+    .int_gpio = 14,                 \
+}
+
+    typedef struct
+    {
+        uint32_t batches;    // FIFO drains
+        uint32_t samples;    // samples read out of the FIFO
+        uint32_t overruns;   // drains that found the IMU's FIFO had overflowed
+        uint32_t dropped;    // samples no consumer collected in time
+        uint32_t max_batch;  // largest drain, in samples
+        uint32_t max_drain_us;
+    } imu_fifo_stats_t;
+
+    // Counts to physical units at the configured full-scale range
+    typedef struct
+    {
+        float gyro_dps_per_lsb;
+        float accel_g_per_lsb;
+    } imu_scale_t;
+
+    // Offsets subtracted from the raw counts before scaling
+    typedef struct
+    {
+        imu_raw_vector_t gyro_bias;
+        imu_raw_vector_t accel_offset; // with gravity on +Z taken out
+    } imu_calibration_t;
+
+    // Nominal rate from the datasheet, or 0 for a code outside imu_odr_t
+    uint32_t imu_odr_hz(imu_odr_t odr);
+
+    // Starts with IMU_CONFIG_DEFAULT()
     esp_err_t imu_init(void);
+
+    /**
+     * Change rate, ranges and filtering at runtime. Calibration offsets are
+     * rescaled to the new ranges. While the FIFO runs the ODR can't change,
+     * and while the FIFO or the sampler runs the full scales can't either
+     * (ESP_ERR_INVALID_STATE).
+     */
+    esp_err_t imu_configure(const imu_config_t *config);
+    void imu_get_config(imu_config_t *out);
     esp_err_t imu_read_data(imu_data_t *data);
+
+    /**
+     * Average the sensor for a few seconds while the robot stands still and
+     * level, then store the gyro bias and accel offset in NVS; imu_init()
+     * loads them. Returns ESP_ERR_INVALID_RESPONSE, keeping the old values,
+     * if the robot moved or wasn't level. Stop the sampler and FIFO first.
+     */
     esp_err_t imu_calibrate(void);
+    void imu_get_calibration(imu_calibration_t *out);
     bool imu_is_initialized(void);
 
+    /**
+     * One calibrated sample in counts, for callers that compare thresholds
+     * or forward data as is. scale, if not NULL, receives the factors that
+     * turn the counts into units.
+     */
+    esp_err_t imu_read_raw(imu_raw_sample_t *out, imu_scale_t *scale);
+    void imu_get_scale(imu_scale_t *out);
+
+    /**
+     * Convert n raw samples to dps and m/s² in one pass. scale NULL uses the
+     * current one.
+     */
+    void imu_convert_batch(const imu_raw_sample_t *in, imu_sample_t *out, size_t n, const imu_scale_t *scale);
+
+    /**
+     * Switch the IMU to continuous FIFO mode. A driver task sleeps until the
+     * watermark interrupt and then drains the whole FIFO in burst reads,
+     * timestamping each sample from the IMU's own timer.
+     */
+    esp_err_t imu_fifo_start(const imu_fifo_config_t *config);
+    esp_err_t imu_fifo_stop(void);
+
+    /**
+     * Copy up to max buffered samples, oldest first, waiting up to timeout_ms
+     * for at least one. Returns the number of samples copied, at most 32 per
+     * call.
+     */
+    size_t imu_fifo_read(imu_sample_t *out, size_t max, uint32_t timeout_ms);
+
+    /**
+     * imu_fifo_read() without the conversion: up to max buffered samples in
+     * counts, plus the scale they were taken at.
+     */
+    size_t imu_read_batch(imu_raw_sample_t *out, size_t max, uint32_t timeout_ms, imu_scale_t *scale);
+
+    void imu_fifo_get_stats(imu_fifo_stats_t *out);
+
+    // ======= DRDY sampler and consumer rings =======
+
+    typedef struct
+    {
+        int int_gpio;     // GPIO wired to the LSM6DS3 INT1 pin
+        int core;         // core the sampler task is pinned to
+        int priority;
+    } imu_sampler_config_t;
+
+#define IMU_SAMPLER_CONFIG_DEFAULT() { \
+    .int_gpio = 14,                    \
+    .core = 1,                         \
+    .priority = 20,                    \
+}
+
+    typedef struct
+    {
+        uint32_t samples;
+        uint32_t missed;      // data-ready interrupts that arrived before the last read finished
+        uint32_t read_errors;
+        uint32_t max_read_us; // interrupt to sample published
+    } imu_sampler_stats_t;
+
+    /**
+     * Read one sample per gyro data-ready interrupt on a task pinned to a
+     * core, timestamped at the interrupt. Not available while the FIFO runs.
+     */
+    esp_err_t imu_sampler_start(const imu_sampler_config_t *config);
+    esp_err_t imu_sampler_stop(void);
+    void imu_sampler_get_stats(imu_sampler_stats_t *out);
+
+    /**
+     * A single-producer/single-consumer ring of raw samples. The sampler (or
+     * FIFO drain) pushes without locks or blocking; one consumer task pops.
+     * When the ring is full new samples are dropped and counted as overruns.
+     */
+    typedef struct imu_ring imu_ring_t;
+
+    typedef struct
+    {
+        uint32_t pushed;
+        uint32_t overruns;
+        uint32_t popped;
+        uint32_t latency_mean_us; // sample timestamp to pop
+        uint32_t latency_max_us;
+    } imu_ring_stats_t;
+
+    /**
+     * Add a consumer with room for capacity samples (rounded up to a power of
+     * two). notify, if set, gets a task notification for every push.
+     * Consumers are never removed.
+     */
+    imu_ring_t *imu_ring_create(size_t capacity, TaskHandle_t notify_task);
+
+    /**
+     * Non-blocking. Copies up to max samples, oldest first.
+     */
+    size_t imu_ring_pop(imu_ring_t *ring, imu_raw_sample_t *out, size_t max);
+
+    /**
+     * Non-blocking. Discards everything but the newest sample, for control
+     * loops that only care about the current state. Returns false if empty.
+     */
+    bool imu_ring_pop_latest(imu_ring_t *ring, imu_raw_sample_t *out);
+
+    void imu_ring_get_stats(imu_ring_t *ring, imu_ring_stats_t *out);
+
+    // ======= Orientation =======
+
+    typedef struct
+    {
+        imu_quaternion_t q;
+        float roll;  // degrees
+        float pitch; // degrees
+        float yaw;   // degrees, relative to the heading at start-up
+        int64_t timestamp_us; // of the newest sample folded in
+    } imu_orientation_t;
+
+    typedef struct
+    {
+        float beta; // Madgwick gain
+        int core;
+        int priority;
+    } imu_orientation_config_t;
+
+#define IMU_ORIENTATION_CONFIG_DEFAULT() { \
+    .beta = 0.1f,                          \
+    .core = 1,                             \
+    .priority = 18,                        \
+}
+
+    typedef struct
+    {
+        uint32_t updates;
+        uint32_t gaps;             // sample gaps too long to integrate across; the filter re-levelled
+        uint32_t last_update_cycles;
+        uint32_t max_update_cycles;
+    } imu_orientation_stats_t;
+
+    /**
+     * Start a task that folds every sample from the sampler or FIFO into a
+     * Madgwick filter, at the IMU's own rate. Start one of those as well.
+     */
+    esp_err_t imu_orientation_start(const imu_orientation_config_t *config);
+
+    /**
+     * The latest estimate. ESP_ERR_INVALID_STATE until the first sample.
+     */
+    esp_err_t imu_get_orientation(imu_orientation_t *out);
+
+    void imu_orientation_get_stats(imu_orientation_stats_t *out);
+
+    // ======= Embedded event detection =======
+
+    typedef enum
+    {
+        IMU_EVENT_WAKE = 1 << 0,       // acceleration above the wake threshold, e.g. picked up
+        IMU_EVENT_SINGLE_TAP = 1 << 1,
+        IMU_EVENT_DOUBLE_TAP = 1 << 2,
+        IMU_EVENT_FREE_FALL = 1 << 3,
+        IMU_EVENT_TILT = 1 << 4,       // orientation changed by more than 35°, e.g. knocked over
+    } imu_event_t;
+
+#define IMU_EVENT_ALL 0x1F
+#define IMU_EVENT_COUNT 5
+
+#define IMU_AXIS_X 0x01
+#define IMU_AXIS_Y 0x02
+#define IMU_AXIS_Z 0x04
+
+    typedef struct
+    {
+        imu_event_t event;
+        uint8_t axes;     // IMU_AXIS_* that triggered a wake or tap
+        bool negative;    // tap direction
+        int64_t timestamp_us; // when the interrupt fired
+    } imu_event_info_t;
+
+    typedef void (*imu_event_cb_t)(const imu_event_info_t *info, void *arg);
+
+    typedef struct
+    {
+        int int2_gpio;           // GPIO wired to the LSM6DS3 INT2 pin
+        uint32_t events;         // IMU_EVENT_* to detect
+        uint16_t wake_mg;        // rounded to the accel range / 64
+        uint16_t tap_mg;         // rounded to the accel range / 32
+        uint16_t free_fall_mg;   // 156 to 500, rounded down to a supported step
+        uint16_t free_fall_ms;   // how long the fall must last
+        bool wake_from_light_sleep;
+    } imu_event_config_t;
+
+#define IMU_EVENT_CONFIG_DEFAULT() {   \
+    .int2_gpio = 1,                    \
+    .events = IMU_EVENT_ALL,           \
+    .wake_mg = 250,                    \
+    .tap_mg = 500,                     \
+    .free_fall_mg = 312,               \
+    .free_fall_ms = 60,                \
+    .wake_from_light_sleep = false,    \
+}
+
+    typedef struct
+    {
+        uint32_t counts[IMU_EVENT_COUNT]; // per event, in imu_event_t bit order
+        uint32_t max_latency_us; // interrupt to last callback returned
+    } imu_event_stats_t;
+
+    /**
+     * Let the IMU's own engines watch for the configured events and raise
+     * INT2, so the CPU does no polling and may light-sleep until one fires.
+     * Thresholds follow the accel range at the time of the call.
+     */
+    esp_err_t imu_events_start(const imu_event_config_t *config);
+    esp_err_t imu_events_stop(void);
+
+    /**
+     * Call cb, on the event task, for every event in mask. Up to four
+     * callbacks; they can't be removed.
+     */
+    esp_err_t imu_register_event_cb(uint32_t mask, imu_event_cb_t cb, void *arg);
+
+    void imu_events_get_stats(imu_event_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
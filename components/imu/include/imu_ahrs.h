@@ -0,0 +1,51 @@
+#ifndef IMU_AHRS_H
+#define IMU_AHRS_H
+
+// Orientation filter kernel behind imu_get_orientation(). Float math on
+// caller-owned state only; the driver feeds it, and tools/host_tests
+// feeds it a trace with ground truth to check accuracy and cost.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct
+    {
+        float w;
+        float x;
+        float y;
+        float z;
+    } imu_quaternion_t;
+
+    typedef struct
+    {
+        imu_quaternion_t q; // sensor frame to world frame
+        float beta;         // gradient-descent gain; higher trusts the accelerometer more
+        int initialized;
+    } imu_ahrs_t;
+
+    void imu_ahrs_init(imu_ahrs_t *ahrs, float beta);
+
+    /**
+     * One Madgwick update from gyro rates in rad/s and an accelerometer
+     * vector in any unit (it is normalized). The first call, and any call
+     * after imu_ahrs_init(), levels the quaternion from the accelerometer
+     * instead of waiting for the filter to converge. Single precision
+     * throughout: no double literals and one reciprocal square root per
+     * normalization.
+     */
+    void imu_ahrs_update(imu_ahrs_t *ahrs, float gx, float gy, float gz,
+                         float ax, float ay, float az, float dt);
+
+    /**
+     * Roll, pitch and yaw in degrees (Z-Y-X order). Yaw is relative to the
+     * heading at start-up and drifts slowly, as there is no magnetometer.
+     */
+    void imu_ahrs_to_euler(const imu_quaternion_t *q, float *roll, float *pitch, float *yaw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMU_AHRS_H
@@ -1,6 +1,9 @@
 #include "imu.h"
-#include "driver/i2c.h" //for I2C communication
+#include "imu_internal.h"
+#include "i2c_bus.h" //for I2C communication
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
 #include <string.h>
 
 // define which ESP32 pins will be used for the I2C bus:
@@ -8,16 +11,16 @@
 #define I2C_MASTER_SDA_IO 20 // SDA GPIO
 
 // Specifying the ESP32 I2C hardware controllers (ESP32 has I2C_NUM_0 and I2C_NUM_1).
-// here we use I2C_NUM_0, which is the default I2C controller.
+// here we use I2C_NUM_0; I2C_NUM_1 belongs to the camera's SCCB.
 #define I2C_MASTER_NUM I2C_NUM_0
 
 // Sets I2C bus speed to 400kHz (fast mode compared to normal 100kHz) since the LSM6DS3 IMU supports it.
 #define I2C_MASTER_FREQ_HZ 400000
 
-// ESP-IDF’s I2C driver can use DMA buffers for sending/receiving,
-// but for most simple IMU reads we disable them (set to 0) because they’re unnecessary and take RAM.
-#define I2C_MASTER_TX_BUF_DISABLE 0
-#define I2C_MASTER_RX_BUF_DISABLE 0
+// The bus task runs the transfers the sampler waits on, so it must not sit
+// below it. A 12-byte read takes about 0.4 ms at 400 kHz.
+#define I2C_BUS_TASK_PRIO 21
+#define I2C_TIMEOUT_MS 10
 
 // I2C address of the LSM6DS3 IMU chip.
 #define LSM6DS3_ADDR 0x6A // or 0x6B depending on SA0
@@ -28,46 +31,115 @@
 #define WHO_AM_I_REG 0x0F
 #define WHO_AM_I_EXPECTED 0x69
 
-// configuration registers
+// configuration registers (addresses in imu_internal.h)
 // CTRL1_XL → accelerometer settings
 // CTRL2_G → gyroscope settings
-#define CTRL1_XL 0x10
-#define CTRL2_G 0x11
-
-// starting register addresses for reading data
-// OUTX_L_G → gyroscope data
-// OUTX_L_XL → accelerometer data
-// read from these addresses (and the following registers) to get raw X/Y/Z sensor values.
+// CTRL3_C → BDU (bit 6) keeps the low and high bytes of a sample together,
+//           IF_INC (bit 2) lets one read walk through consecutive registers
+#define CTRL3_C_BDU_IF_INC 0x44
+// CTRL4_C → XL_BW_SCAL_ODR (bit 7) makes the accel use BW_XL instead of
+//           choosing its anti-aliasing bandwidth from the ODR
+#define CTRL4_C 0x13
+#define CTRL4_C_XL_BW_SCAL_ODR 0x80
+
+// starting register address for reading data
+// OUTX_L_G → gyroscope data, followed directly by the accelerometer at
+// OUTX_L_XL (0x28), so one auto-increment read covers both
 #define OUTX_L_G 0x22
-#define OUTX_L_XL 0x28
 
 // Tag for logging
 static const char *TAG = "IMU";
 
 static bool initialized = false;
+static i2c_bus_device_t *dev = NULL;
+
+// Gyro X/Y/Z bias then accel X/Y/Z offset, in counts, from imu_calibrate()
+static int16_t offsets[6];
+
+// Sensitivity per full-scale code, from the LSM6DS3 datasheet
+// FS_XL (CTRL1_XL bits 3:2): ±2 g, ±16 g, ±4 g, ±8 g
+static const float accel_mg_per_lsb[4] = {0.061f, 0.488f, 0.122f, 0.244f};
+// FS_G (CTRL2_G bits 3:2): ±245, ±500, ±1000, ±2000 dps; FS_125 (bit 1) overrides
+static const float gyro_mdps_per_lsb[4] = {8.75f, 17.5f, 35.0f, 70.0f};
+#define GYRO_125_MDPS_PER_LSB 4.375f
+
+// Follows whatever full scale was last written to CTRL1_XL/CTRL2_G
+static imu_scale_t scale = {.gyro_dps_per_lsb = 0.00875f, .accel_g_per_lsb = 0.000061f};
+
+static imu_config_t config = IMU_CONFIG_DEFAULT();
 
 /**
  * I2C write helper
  * This function writes a single byte of data to a specified register of the LSM6DS3 IMU.
- * It constructs a buffer with the register address and data, then uses the I2C master write function to send it.
+ * Register writes are configuration, so they queue at low priority behind sample reads.
  */
 
-static esp_err_t i2c_write(uint8_t reg, uint8_t data)
+esp_err_t imu_reg_write(uint8_t reg, uint8_t data)
 {
     uint8_t buf[2] = {reg, data};
-    return i2c_master_write_to_device(I2C_MASTER_NUM, LSM6DS3_ADDR,
-                                      buf, 2, pdMS_TO_TICKS(100));
+    return i2c_bus_write_read(dev, I2C_BUS_PRIO_LOW, buf, 2, NULL, 0, I2C_TIMEOUT_MS);
 }
 
 /**
  * I2C read helper
  * This function reads a specified number of bytes from a given register of the LSM6DS3 IMU.
- * It uses the I2C master write-read function to first write the register address and then read the data.
+ * It writes the register address and then reads the data, ahead of any queued writes.
  */
-static esp_err_t i2c_read(uint8_t reg, uint8_t *data, size_t len)
+esp_err_t imu_reg_read(uint8_t reg, uint8_t *data, size_t len)
+{
+    return i2c_bus_write_read(dev, I2C_BUS_PRIO_HIGH, &reg, 1, data, len, I2C_TIMEOUT_MS);
+}
+
+uint32_t imu_odr_hz(imu_odr_t odr)
+{
+    // Datasheet rates; the top two are not exact doublings
+    static const uint16_t rates[] = {104, 208, 416, 833, 1660};
+    if (odr < IMU_ODR_104HZ || odr > IMU_ODR_1660HZ)
+        return 0;
+    return rates[odr - IMU_ODR_104HZ];
+}
+
+esp_err_t imu_reg_update(uint8_t reg, uint8_t mask, uint8_t value)
+{
+    uint8_t v;
+    esp_err_t ret = imu_reg_read(reg, &v, 1);
+    if (ret != ESP_OK)
+        return ret;
+    return imu_reg_write(reg, (v & ~mask) | (value & mask));
+}
+
+static bool config_valid(const imu_config_t *c)
 {
-    return i2c_master_write_read_device(I2C_MASTER_NUM, LSM6DS3_ADDR,
-                                        &reg, 1, data, len, pdMS_TO_TICKS(100));
+    if (c->odr < IMU_ODR_104HZ || c->odr > IMU_ODR_1660HZ || c->accel_bw > IMU_ACCEL_BW_AUTO)
+        return false;
+    if (c->accel_fs & ~0x0C)
+        return false;
+    return c->gyro_fs == IMU_GYRO_FS_125DPS || (c->gyro_fs & ~0x0C) == 0;
+}
+
+static esp_err_t apply_config(const imu_config_t *c)
+{
+    bool auto_bw = c->accel_bw == IMU_ACCEL_BW_AUTO;
+    uint8_t ctrl1 = (c->odr << 4) | c->accel_fs | (auto_bw ? 0 : c->accel_bw);
+    uint8_t ctrl2 = (c->odr << 4) | c->gyro_fs;
+
+    uint8_t ctrl4;
+    esp_err_t ret = imu_reg_read(CTRL4_C, &ctrl4, 1);
+    if (ret != ESP_OK)
+        return ret;
+    ctrl4 = auto_bw ? ctrl4 & ~CTRL4_C_XL_BW_SCAL_ODR : ctrl4 | CTRL4_C_XL_BW_SCAL_ODR;
+
+    ret = imu_reg_write(CTRL4_C, ctrl4);
+    if (ret == ESP_OK)
+        ret = imu_reg_write(CTRL1_XL, ctrl1);
+    if (ret == ESP_OK)
+        ret = imu_reg_write(CTRL2_G, ctrl2);
+    if (ret != ESP_OK)
+        return ret;
+
+    imu_update_scale(ctrl1, ctrl2);
+    config = *c;
+    return ESP_OK;
 }
 
 /**
@@ -81,27 +153,31 @@ esp_err_t imu_init(void)
 {
     esp_err_t ret;
 
-    // Configure I2C bus
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ};
-    ret = i2c_param_config(I2C_MASTER_NUM, &conf);
-    if (ret != ESP_OK)
-        return ret;
-
-    ret = i2c_driver_install(I2C_MASTER_NUM, conf.mode,
-                             I2C_MASTER_RX_BUF_DISABLE,
-                             I2C_MASTER_TX_BUF_DISABLE, 0);
-    if (ret != ESP_OK)
-        return ret;
+    // Join the shared bus, creating it if no other driver has yet
+    i2c_bus_t *bus = i2c_bus_get(I2C_MASTER_NUM);
+    if (!bus)
+    {
+        i2c_bus_config_t conf = {
+            .port = I2C_MASTER_NUM,
+            .sda_gpio = I2C_MASTER_SDA_IO,
+            .scl_gpio = I2C_MASTER_SCL_IO,
+            .task_priority = I2C_BUS_TASK_PRIO,
+            .task_core = tskNO_AFFINITY,
+        };
+        ret = i2c_bus_create(&conf, &bus);
+        if (ret != ESP_OK)
+            return ret;
+    }
+    if (!dev)
+    {
+        ret = i2c_bus_add_device(bus, LSM6DS3_ADDR, I2C_MASTER_FREQ_HZ, &dev);
+        if (ret != ESP_OK)
+            return ret;
+    }
 
     // WHO_AM_I check
     uint8_t whoami;
-    ret = i2c_read(WHO_AM_I_REG, &whoami, 1);
+    ret = imu_reg_read(WHO_AM_I_REG, &whoami, 1);
     if (ret != ESP_OK)
         return ret;
 
@@ -112,18 +188,49 @@ esp_err_t imu_init(void)
     }
     ESP_LOGI(TAG, "LSM6DS3 detected, WHO_AM_I=0x%02X", whoami);
 
-    // Configure accelerometer: 104 Hz, ±2g
-    i2c_write(CTRL1_XL, 0x40);
-    // Configure gyroscope: 104 Hz, ±245 dps
-    i2c_write(CTRL2_G, 0x40);
+    imu_reg_write(CTRL3_C, CTRL3_C_BDU_IF_INC);
+    imu_config_t defaults = IMU_CONFIG_DEFAULT();
+    ret = apply_config(&defaults);
+    if (ret != ESP_OK)
+        return ret;
+
+    // Without a stored calibration the readings are simply uncorrected
+    if (imu_calibration_load() != ESP_OK)
+        ESP_LOGW(TAG, "No stored calibration, run imu_calibrate()");
 
     initialized = true;
     return ESP_OK;
 }
 
+esp_err_t imu_configure(const imu_config_t *c)
+{
+    if (!initialized)
+        return ESP_ERR_INVALID_STATE;
+    if (!c || !config_valid(c))
+        return ESP_ERR_INVALID_ARG;
+    // The FIFO's own ODR and its timing are set up for the current rate
+    if (imu_fifo_is_running() && c->odr != config.odr)
+        return ESP_ERR_INVALID_STATE;
+    // Raw samples carry no scale; consumers convert them with the current
+    // one, so samples already queued would be read at the wrong range
+    if ((imu_fifo_is_running() || imu_sampler_is_running()) &&
+        (c->accel_fs != config.accel_fs || c->gyro_fs != config.gyro_fs))
+        return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = apply_config(c);
+    if (ret == ESP_OK)
+        ESP_LOGI(TAG, "Configured: ODR code %d, accel FS 0x%02X, gyro FS 0x%02X, accel BW %d", c->odr,
+                 c->accel_fs, c->gyro_fs, c->accel_bw);
+    return ret;
+}
+
+void imu_get_config(imu_config_t *out)
+{
+    *out = config;
+}
+
 /**
- * Read 6 bytes from gyro starting at OUTX_L_G
- * Read 6 bytes from accel starting at OUTX_L_XL
+ * Read all 12 output bytes, gyro then accel, in one burst
  * Converts the raw data into physical units (dps for gyro, m/s² for accel).
  * Store them into data->accelerometer and data->gyroscope
  * Returns ESP_OK on success, or an error code on failure.
@@ -137,43 +244,164 @@ esp_err_t imu_read_data(imu_data_t *data)
         return ESP_ERR_INVALID_ARG;
 
     uint8_t raw[12];
-
-    // Read gyro (6 bytes)
-    esp_err_t ret = i2c_read(OUTX_L_G, raw, 6);
+    esp_err_t ret = imu_read_output(raw);
     if (ret != ESP_OK)
         return ret;
 
-    // Read accel (6 bytes)
-    ret = i2c_read(OUTX_L_XL, raw + 6, 6);
+    imu_convert(raw, data);
+    return ESP_OK;
+}
+
+esp_err_t imu_read_raw(imu_raw_sample_t *out, imu_scale_t *scale_out)
+{
+    if (!initialized)
+        return ESP_ERR_INVALID_STATE;
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+
+    uint8_t raw[12];
+    esp_err_t ret = imu_read_output(raw);
     if (ret != ESP_OK)
         return ret;
 
-    int16_t gx = (int16_t)(raw[1] << 8 | raw[0]);
-    int16_t gy = (int16_t)(raw[3] << 8 | raw[2]);
-    int16_t gz = (int16_t)(raw[5] << 8 | raw[4]);
+    imu_unpack_raw(raw, out);
+    out->timestamp_us = esp_timer_get_time();
+    out->seq = 0;
+    if (scale_out)
+        *scale_out = scale;
+    return ESP_OK;
+}
+
+esp_err_t imu_read_output(uint8_t raw[12])
+{
+    // OUTX_L_G..OUTZ_H_XL are contiguous and IF_INC is set, so this is one
+    // I2C transaction instead of two. BDU keeps each axis' bytes paired.
+    return imu_reg_read(OUTX_L_G, raw, 12);
+}
 
-    int16_t ax = (int16_t)(raw[7] << 8 | raw[6]);
-    int16_t ay = (int16_t)(raw[9] << 8 | raw[8]);
-    int16_t az = (int16_t)(raw[11] << 8 | raw[10]);
+/**
+ * Sensor counts with the calibration offsets taken off, saturated so a
+ * reading near full scale can't wrap around.
+ */
+static inline int16_t corrected(const uint8_t *p, int16_t offset)
+{
+    int32_t v = (int16_t)(p[1] << 8 | p[0]) - offset;
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)v;
+}
+
+void imu_unpack_raw(const uint8_t raw[12], imu_raw_sample_t *out)
+{
+    out->gyroscope.x = corrected(raw + 0, offsets[0]);
+    out->gyroscope.y = corrected(raw + 2, offsets[1]);
+    out->gyroscope.z = corrected(raw + 4, offsets[2]);
+    out->accelerometer.x = corrected(raw + 6, offsets[3]);
+    out->accelerometer.y = corrected(raw + 8, offsets[4]);
+    out->accelerometer.z = corrected(raw + 10, offsets[5]);
+}
+
+void imu_convert(const uint8_t raw[12], imu_data_t *data)
+{
+    imu_raw_sample_t c;
+    imu_unpack_raw(raw, &c);
 
     // Convert to physical units
-    data->gyroscope.x = gx * (245.0f / 32768.0f); // dps
-    data->gyroscope.y = gy * (245.0f / 32768.0f);
-    data->gyroscope.z = gz * (245.0f / 32768.0f);
+    float g = scale.gyro_dps_per_lsb;
+    float a = scale.accel_g_per_lsb * IMU_STANDARD_GRAVITY;
+    data->gyroscope.x = c.gyroscope.x * g; // dps
+    data->gyroscope.y = c.gyroscope.y * g;
+    data->gyroscope.z = c.gyroscope.z * g;
+
+    data->accelerometer.x = c.accelerometer.x * a; // m/s²
+    data->accelerometer.y = c.accelerometer.y * a;
+    data->accelerometer.z = c.accelerometer.z * a;
+}
 
-    data->accelerometer.x = ax * (2.0f / 32768.0f) * 9.80665f; // m/s²
-    data->accelerometer.y = ay * (2.0f / 32768.0f) * 9.80665f;
-    data->accelerometer.z = az * (2.0f / 32768.0f) * 9.80665f;
+/**
+ * The six values of a raw sample sit next to each other, so each sample is
+ * converted as one 8-lane vector (two lanes of padding) instead of six
+ * scalar multiplies. GCC lowers the vector to SIMD on the host and to
+ * unrolled FPU code on the ESP32-S3.
+ */
+typedef float v8f __attribute__((vector_size(32)));
 
-    return ESP_OK;
+void imu_convert_batch(const imu_raw_sample_t *restrict in, imu_sample_t *restrict out, size_t n,
+                       const imu_scale_t *s)
+{
+    imu_scale_t local;
+    if (!s)
+    {
+        local = scale;
+        s = &local;
+    }
+    float g = s->gyro_dps_per_lsb;
+    float a = s->accel_g_per_lsb * IMU_STANDARD_GRAVITY;
+    const v8f k = {g, g, g, a, a, a, 0.0f, 0.0f};
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const imu_raw_sample_t *r = &in[i];
+        v8f v = {r->gyroscope.x, r->gyroscope.y, r->gyroscope.z,
+                 r->accelerometer.x, r->accelerometer.y, r->accelerometer.z, 0.0f, 0.0f};
+        v *= k;
+        out[i].data.gyroscope.x = v[0];
+        out[i].data.gyroscope.y = v[1];
+        out[i].data.gyroscope.z = v[2];
+        out[i].data.accelerometer.x = v[3];
+        out[i].data.accelerometer.y = v[4];
+        out[i].data.accelerometer.z = v[5];
+        out[i].timestamp_us = r->timestamp_us;
+    }
 }
 
-esp_err_t imu_calibrate(void)
+void imu_update_scale(uint8_t ctrl1_xl, uint8_t ctrl2_g)
 {
-    if (!initialized)
-        return ESP_ERR_INVALID_STATE;
-    // Optional: implement offset calibration
-    return ESP_OK;
+    imu_scale_t old = scale;
+    imu_scale_t s;
+    s.accel_g_per_lsb = accel_mg_per_lsb[(ctrl1_xl >> 2) & 0x03] * 0.001f;
+    s.gyro_dps_per_lsb = (ctrl2_g & 0x02 ? GYRO_125_MDPS_PER_LSB : gyro_mdps_per_lsb[(ctrl2_g >> 2) & 0x03]) * 0.001f;
+    scale = s;
+
+    // Offsets are in counts, so they follow the range
+    int16_t o[6];
+    memcpy(o, offsets, sizeof(o));
+    imu_set_offsets(o, &old);
+}
+
+void imu_get_scale(imu_scale_t *out)
+{
+    *out = scale;
+}
+
+static int16_t rescale_count(int16_t count, float from, float to)
+{
+    float v = count * from / to;
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)lrintf(v);
+}
+
+void imu_set_offsets(const int16_t new_offsets[6], const imu_scale_t *at)
+{
+    int16_t o[6];
+    for (int i = 0; i < 3; i++)
+    {
+        o[i] = rescale_count(new_offsets[i], at->gyro_dps_per_lsb, scale.gyro_dps_per_lsb);
+        o[3 + i] = rescale_count(new_offsets[3 + i], at->accel_g_per_lsb, scale.accel_g_per_lsb);
+    }
+    // Plain stores: a sample decoded mid-update mixes old and new offsets
+    // on one axis at worst, once
+    memcpy(offsets, o, sizeof(offsets));
+}
+
+void imu_get_offsets(int16_t out[6])
+{
+    memcpy(out, offsets, sizeof(offsets));
 }
 
 bool imu_is_initialized(void)
@@ -0,0 +1,109 @@
+#include "imu_ahrs.h"
+#include <math.h>
+
+#define RAD_TO_DEG 57.29577951f
+
+static inline float inv_sqrt(float x)
+{
+    return 1.0f / sqrtf(x);
+}
+
+void imu_ahrs_init(imu_ahrs_t *ahrs, float beta)
+{
+    ahrs->q.w = 1.0f;
+    ahrs->q.x = 0.0f;
+    ahrs->q.y = 0.0f;
+    ahrs->q.z = 0.0f;
+    ahrs->beta = beta;
+    ahrs->initialized = 0;
+}
+
+/**
+ * Roll and pitch from gravity alone, yaw zero.
+ */
+static void level_from_accel(imu_ahrs_t *ahrs, float ax, float ay, float az)
+{
+    float roll = atan2f(ay, az);
+    float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+    ahrs->q.w = cr * cp;
+    ahrs->q.x = sr * cp;
+    ahrs->q.y = cr * sp;
+    ahrs->q.z = -sr * sp;
+    ahrs->initialized = 1;
+}
+
+void imu_ahrs_update(imu_ahrs_t *ahrs, float gx, float gy, float gz,
+                     float ax, float ay, float az, float dt)
+{
+    float a_norm = ax * ax + ay * ay + az * az;
+    if (!ahrs->initialized)
+    {
+        if (a_norm > 0.0f)
+            level_from_accel(ahrs, ax, ay, az);
+        return;
+    }
+
+    float q0 = ahrs->q.w, q1 = ahrs->q.x, q2 = ahrs->q.y, q3 = ahrs->q.z;
+
+    // Rate of change of the quaternion from the gyro
+    float qdot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qdot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qdot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qdot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    // A zero accelerometer vector (free fall, or no data) can't correct anything
+    if (a_norm > 0.0f)
+    {
+        float r = inv_sqrt(a_norm);
+        ax *= r;
+        ay *= r;
+        az *= r;
+
+        float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+        float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+        float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+        float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+        // Gradient of the error between measured and predicted gravity
+        float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+        float s_norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+        if (s_norm > 0.0f)
+        {
+            float k = ahrs->beta * inv_sqrt(s_norm);
+            qdot0 -= k * s0;
+            qdot1 -= k * s1;
+            qdot2 -= k * s2;
+            qdot3 -= k * s3;
+        }
+    }
+
+    q0 += qdot0 * dt;
+    q1 += qdot1 * dt;
+    q2 += qdot2 * dt;
+    q3 += qdot3 * dt;
+
+    float r = inv_sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    ahrs->q.w = q0 * r;
+    ahrs->q.x = q1 * r;
+    ahrs->q.y = q2 * r;
+    ahrs->q.z = q3 * r;
+}
+
+void imu_ahrs_to_euler(const imu_quaternion_t *q, float *roll, float *pitch, float *yaw)
+{
+    float sinp = 2.0f * (q->w * q->y - q->z * q->x);
+    if (sinp > 1.0f)
+        sinp = 1.0f;
+    else if (sinp < -1.0f)
+        sinp = -1.0f;
+
+    *roll = atan2f(2.0f * (q->w * q->x + q->y * q->z), 1.0f - 2.0f * (q->x * q->x + q->y * q->y)) * RAD_TO_DEG;
+    *pitch = asinf(sinp) * RAD_TO_DEG;
+    *yaw = atan2f(2.0f * (q->w * q->z + q->x * q->y), 1.0f - 2.0f * (q->y * q->y + q->z * q->z)) * RAD_TO_DEG;
+}
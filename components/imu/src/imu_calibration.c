@@ -0,0 +1,199 @@
+#include "imu.h"
+#include "imu_internal.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+#define NS "imu_cal"
+#define KEY "offsets"
+#define CAL_VERSION 2
+
+#define STATUS_REG 0x1E
+#define STATUS_GDA 0x02 // new gyro sample
+
+// About 2.5 s at the default 104 Hz
+#define CAL_SAMPLES 256
+#define CAL_SAMPLE_TIMEOUT_MS 100
+
+// A robot standing still shows only sensor noise, well under these. Anything
+// above means it was touched or a motor was running.
+#define MAX_GYRO_STDDEV_DPS 0.5f
+#define MAX_ACCEL_STDDEV_G 0.02f
+
+// The accel offset assumes gravity is all on +Z; reject a run that is
+// visibly tilted instead of baking the tilt into the offsets
+#define MAX_LEVEL_ERROR_G 0.1f
+
+// Tag for logging
+static const char *TAG = "IMU_CAL";
+
+typedef struct
+{
+    uint32_t version;
+    int16_t offsets[6];
+    imu_scale_t scale; // the ranges the offsets were measured at
+} cal_blob_t;
+
+/**
+ * Welford's running mean and variance; stays accurate where summing
+ * squares of large counts in float would cancel.
+ */
+typedef struct
+{
+    uint32_t n;
+    float mean;
+    float m2;
+} running_stats_t;
+
+static void running_add(running_stats_t *s, float x)
+{
+    s->n++;
+    float d = x - s->mean;
+    s->mean += d / s->n;
+    s->m2 += d * (x - s->mean);
+}
+
+static float running_stddev(const running_stats_t *s)
+{
+    return s->n > 1 ? sqrtf(s->m2 / (s->n - 1)) : 0.0f;
+}
+
+static int16_t round_counts(float x)
+{
+    return (int16_t)lrintf(x);
+}
+
+esp_err_t imu_calibration_load(void)
+{
+    nvs_handle_t h;
+    esp_err_t e = nvs_open(NS, NVS_READONLY, &h);
+    if (e != ESP_OK)
+        return e;
+    cal_blob_t b;
+    size_t sz = sizeof(b);
+    e = nvs_get_blob(h, KEY, &b, &sz);
+    nvs_close(h);
+    if (e != ESP_OK)
+        return e;
+    if (sz != sizeof(b) || b.version != CAL_VERSION)
+        return ESP_ERR_INVALID_VERSION;
+
+    imu_set_offsets(b.offsets, &b.scale);
+    ESP_LOGI(TAG, "Calibration loaded: gyro %d/%d/%d, accel %d/%d/%d", b.offsets[0], b.offsets[1],
+             b.offsets[2], b.offsets[3], b.offsets[4], b.offsets[5]);
+    return ESP_OK;
+}
+
+static esp_err_t calibration_save(const int16_t offsets[6], const imu_scale_t *scale)
+{
+    cal_blob_t b = {.version = CAL_VERSION, .scale = *scale};
+    memcpy(b.offsets, offsets, sizeof(b.offsets));
+
+    nvs_handle_t h;
+    esp_err_t e = nvs_open(NS, NVS_READWRITE, &h);
+    if (e != ESP_OK)
+        return e;
+    e = nvs_set_blob(h, KEY, &b, sizeof(b));
+    if (e == ESP_OK)
+        e = nvs_commit(h);
+    nvs_close(h);
+    return e;
+}
+
+static esp_err_t wait_for_sample(void)
+{
+    for (int waited = 0; waited < CAL_SAMPLE_TIMEOUT_MS; waited += portTICK_PERIOD_MS)
+    {
+        uint8_t status;
+        esp_err_t ret = imu_reg_read(STATUS_REG, &status, 1);
+        if (ret != ESP_OK)
+            return ret;
+        if (status & STATUS_GDA)
+            return ESP_OK;
+        vTaskDelay(1);
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t imu_calibrate(void)
+{
+    if (!imu_is_initialized())
+        return ESP_ERR_INVALID_STATE;
+    // Both would race this loop for the output registers
+    if (imu_sampler_is_running() || imu_fifo_is_running())
+        return ESP_ERR_INVALID_STATE;
+
+    running_stats_t axes[6];
+    memset(axes, 0, sizeof(axes));
+
+    ESP_LOGI(TAG, "Calibrating, keep the robot still and level");
+    for (int i = 0; i < CAL_SAMPLES; i++)
+    {
+        uint8_t raw[12];
+        esp_err_t ret = wait_for_sample();
+        if (ret == ESP_OK)
+            ret = imu_read_output(raw);
+        if (ret != ESP_OK)
+            return ret;
+
+        // Uncorrected counts, so the result doesn't depend on the old offsets
+        for (int a = 0; a < 6; a++)
+            running_add(&axes[a], (int16_t)(raw[2 * a + 1] << 8 | raw[2 * a]));
+    }
+
+    imu_scale_t scale;
+    imu_get_scale(&scale);
+    for (int a = 0; a < 3; a++)
+    {
+        float gyro_sd = running_stddev(&axes[a]) * scale.gyro_dps_per_lsb;
+        float accel_sd = running_stddev(&axes[3 + a]) * scale.accel_g_per_lsb;
+        if (gyro_sd > MAX_GYRO_STDDEV_DPS || accel_sd > MAX_ACCEL_STDDEV_G)
+        {
+            ESP_LOGW(TAG, "Robot moved during calibration (axis %d: gyro sd %.2f dps, accel sd %.3f g)", a,
+                     gyro_sd, accel_sd);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+
+    const float one_g = 1.0f / scale.accel_g_per_lsb;
+    float ax = axes[3].mean * scale.accel_g_per_lsb;
+    float ay = axes[4].mean * scale.accel_g_per_lsb;
+    float az = axes[5].mean * scale.accel_g_per_lsb;
+    if (fabsf(ax) > MAX_LEVEL_ERROR_G || fabsf(ay) > MAX_LEVEL_ERROR_G || fabsf(az - 1.0f) > MAX_LEVEL_ERROR_G)
+    {
+        ESP_LOGW(TAG, "Robot not level during calibration (%.2f, %.2f, %.2f g)", ax, ay, az);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    int16_t offsets[6] = {
+        round_counts(axes[0].mean),
+        round_counts(axes[1].mean),
+        round_counts(axes[2].mean),
+        round_counts(axes[3].mean),
+        round_counts(axes[4].mean),
+        round_counts(axes[5].mean - one_g),
+    };
+    imu_set_offsets(offsets, &scale);
+    ESP_LOGI(TAG, "Calibrated: gyro %d/%d/%d, accel %d/%d/%d", offsets[0], offsets[1], offsets[2], offsets[3],
+             offsets[4], offsets[5]);
+
+    esp_err_t ret = calibration_save(offsets, &scale);
+    if (ret != ESP_OK)
+        ESP_LOGW(TAG, "Calibration applied but not saved: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+void imu_get_calibration(imu_calibration_t *out)
+{
+    int16_t o[6];
+    imu_get_offsets(o);
+    out->gyro_bias.x = o[0];
+    out->gyro_bias.y = o[1];
+    out->gyro_bias.z = o[2];
+    out->accel_offset.x = o[3];
+    out->accel_offset.y = o[4];
+    out->accel_offset.z = o[5];
+}
@@ -0,0 +1,353 @@
+#include "imu.h"
+#include "imu_internal.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+// Event sources; reading them clears the latched interrupt
+#define WAKE_UP_SRC 0x1B // FF_IA (bit 5), WU_IA (bit 3), X/Y/Z_WU (bits 2:0)
+#define TAP_SRC 0x1C     // SINGLE_TAP (bit 5), DOUBLE_TAP (bit 4), TAP_SIGN (bit 3), X/Y/Z_TAP (bits 2:0)
+#define FUNC_SRC 0x53    // TILT_IA (bit 5)
+
+// Embedded function configuration
+#define CTRL10_C 0x19    // FUNC_EN (bit 2), needed for tilt
+#define TAP_THS_6D 0x59  // TAP_THS (bits 4:0)
+#define INT_DUR2 0x5A    // double-tap gap, quiet and shock windows
+#define WAKE_UP_THS 0x5B // SINGLE_DOUBLE_TAP (bit 7), WK_THS (bits 5:0)
+#define FREE_FALL 0x5D   // FF_DUR[4:0] (bits 7:3), FF_THS (bits 2:0)
+#define MD2_CFG 0x5F     // routing to INT2
+
+#define TAP_CFG_TILT_EN 0x20
+#define TAP_CFG_TAP_XYZ_EN 0x0E
+#define TAP_CFG_LIR 0x01 // latch until the source register is read
+#define CTRL10_C_FUNC_EN 0x04
+#define WAKE_UP_DUR_FF_DUR5 0x80
+
+#define MD2_SINGLE_TAP 0x40
+#define MD2_WU 0x20
+#define MD2_FF 0x10
+#define MD2_DOUBLE_TAP 0x08
+#define MD2_TILT 0x02
+
+// Longest windows, so double taps at a relaxed pace still count
+#define INT_DUR2_RELAXED 0x7F
+
+#define EVENT_TASK_STACK 3072
+#define EVENT_TASK_PRIO 19
+#define MAX_CALLBACKS 4
+
+// Tag for logging
+static const char *TAG = "IMU_EVENTS";
+
+// Free-fall thresholds for FF_THS codes 0..7, in mg
+static const uint16_t ff_threshold_mg[8] = {156, 219, 250, 312, 344, 406, 469, 500};
+
+typedef struct
+{
+    uint32_t mask;
+    imu_event_cb_t cb;
+    void *arg;
+} callback_t;
+
+static imu_event_config_t cfg;
+static volatile bool running = false;
+static SemaphoreHandle_t irq_sem = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+static volatile int64_t irq_time_us = 0;
+
+static portMUX_TYPE cb_mux = portMUX_INITIALIZER_UNLOCKED;
+static callback_t callbacks[MAX_CALLBACKS];
+static int callback_count = 0;
+static imu_event_stats_t stats;
+
+/**
+ * INT2 is level-triggered and latched, so it stays high until the event
+ * task reads the sources. The ISR masks itself until then; that way no
+ * event is lost between edges, and the same level can wake light sleep.
+ */
+static void IRAM_ATTR int2_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    gpio_intr_disable(cfg.int2_gpio);
+    irq_time_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(irq_sem, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// X/Y/Z flags come as bits 2/1/0 in both source registers
+static uint8_t axes_from_src(uint8_t src)
+{
+    return (src & 0x04 ? IMU_AXIS_X : 0) | (src & 0x02 ? IMU_AXIS_Y : 0) | (src & 0x01 ? IMU_AXIS_Z : 0);
+}
+
+static int event_index(imu_event_t e)
+{
+    return __builtin_ctz(e);
+}
+
+static void dispatch(const imu_event_info_t *info)
+{
+    if (!(cfg.events & info->event))
+        return;
+
+    callback_t list[MAX_CALLBACKS];
+    portENTER_CRITICAL(&cb_mux);
+    int n = callback_count;
+    memcpy(list, callbacks, n * sizeof(callback_t));
+    stats.counts[event_index(info->event)]++;
+    portEXIT_CRITICAL(&cb_mux);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (list[i].mask & info->event)
+            list[i].cb(info, list[i].arg);
+    }
+}
+
+static void handle_irq(int64_t ts)
+{
+    uint8_t src[3]; // WAKE_UP_SRC, TAP_SRC, D6D_SRC
+    uint8_t func = 0;
+    if (imu_reg_read(WAKE_UP_SRC, src, sizeof(src)) != ESP_OK)
+        return;
+    if (cfg.events & IMU_EVENT_TILT)
+        imu_reg_read(FUNC_SRC, &func, 1);
+
+    imu_event_info_t info = {.timestamp_us = ts};
+    if (src[0] & 0x20)
+    {
+        info.event = IMU_EVENT_FREE_FALL;
+        dispatch(&info);
+    }
+    if (src[0] & 0x08)
+    {
+        info.event = IMU_EVENT_WAKE;
+        info.axes = axes_from_src(src[0]);
+        dispatch(&info);
+    }
+    if (src[1] & 0x30)
+    {
+        info.event = src[1] & 0x10 ? IMU_EVENT_DOUBLE_TAP : IMU_EVENT_SINGLE_TAP;
+        info.axes = axes_from_src(src[1]);
+        info.negative = src[1] & 0x08;
+        dispatch(&info);
+    }
+    if (func & 0x20)
+    {
+        info.event = IMU_EVENT_TILT;
+        info.axes = 0;
+        info.negative = false;
+        dispatch(&info);
+    }
+
+    uint32_t latency = esp_timer_get_time() - ts;
+    portENTER_CRITICAL(&cb_mux);
+    if (latency > stats.max_latency_us)
+        stats.max_latency_us = latency;
+    portEXIT_CRITICAL(&cb_mux);
+}
+
+static void event_task(void *arg)
+{
+    while (running)
+    {
+        xSemaphoreTake(irq_sem, portMAX_DELAY);
+        if (!running)
+            break;
+        handle_irq(irq_time_us);
+        gpio_intr_enable(cfg.int2_gpio);
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+static uint8_t clamp_code(uint32_t v, uint8_t lo, uint8_t hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/**
+ * Thresholds are fractions of the accel range, so they are worked out from
+ * the range in use now.
+ */
+static esp_err_t configure_engines(void)
+{
+    imu_scale_t scale;
+    imu_config_t sensor;
+    imu_get_scale(&scale);
+    imu_get_config(&sensor);
+    uint32_t fs_mg = (uint32_t)(scale.accel_g_per_lsb * 32768.0f * 1000.0f + 0.5f);
+
+    uint8_t wk_ths = clamp_code((cfg.wake_mg * 64 + fs_mg / 2) / fs_mg, 1, 63);
+    uint8_t tap_ths = clamp_code((cfg.tap_mg * 32 + fs_mg / 2) / fs_mg, 1, 31);
+    uint8_t ff_ths = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        if (ff_threshold_mg[i] <= cfg.free_fall_mg)
+            ff_ths = i;
+    }
+    uint8_t ff_dur = clamp_code(cfg.free_fall_ms * imu_odr_hz(sensor.odr) / 1000, 1, 63);
+
+    bool tap = cfg.events & (IMU_EVENT_SINGLE_TAP | IMU_EVENT_DOUBLE_TAP);
+    bool tilt = cfg.events & IMU_EVENT_TILT;
+    uint8_t md2 = 0;
+    if (cfg.events & IMU_EVENT_WAKE)
+        md2 |= MD2_WU;
+    if (cfg.events & IMU_EVENT_FREE_FALL)
+        md2 |= MD2_FF;
+    if (cfg.events & IMU_EVENT_SINGLE_TAP)
+        md2 |= MD2_SINGLE_TAP;
+    if (cfg.events & IMU_EVENT_DOUBLE_TAP)
+        md2 |= MD2_DOUBLE_TAP;
+    if (tilt)
+        md2 |= MD2_TILT;
+
+    esp_err_t ret = imu_reg_write(WAKE_UP_THS, ((cfg.events & IMU_EVENT_DOUBLE_TAP) ? 0x80 : 0) | wk_ths);
+    if (ret == ESP_OK)
+        ret = imu_reg_write(TAP_THS_6D, tap_ths);
+    if (ret == ESP_OK)
+        ret = imu_reg_write(INT_DUR2, INT_DUR2_RELAXED);
+    if (ret == ESP_OK)
+        ret = imu_reg_write(FREE_FALL, (ff_dur & 0x1F) << 3 | ff_ths);
+    // Leaves TIMER_HR to the FIFO; wake and sleep durations at their minimum
+    if (ret == ESP_OK)
+        ret = imu_reg_update(WAKE_UP_DUR, 0xEF, ff_dur & 0x20 ? WAKE_UP_DUR_FF_DUR5 : 0);
+    if (ret == ESP_OK)
+        ret = imu_reg_update(CTRL10_C, CTRL10_C_FUNC_EN, tilt ? CTRL10_C_FUNC_EN : 0);
+    // Leaves TIMER_EN to the FIFO
+    if (ret == ESP_OK)
+        ret = imu_reg_update(TAP_CFG, TAP_CFG_TILT_EN | TAP_CFG_TAP_XYZ_EN | TAP_CFG_LIR,
+                             (tilt ? TAP_CFG_TILT_EN : 0) | (tap ? TAP_CFG_TAP_XYZ_EN : 0) | TAP_CFG_LIR);
+    if (ret == ESP_OK)
+        ret = imu_reg_write(MD2_CFG, md2);
+    if (ret == ESP_OK)
+        ESP_LOGI(TAG, "Events 0x%02lX: wake %lu mg, tap %lu mg, free fall %u mg for %u samples",
+                 (unsigned long)cfg.events, (unsigned long)(wk_ths * fs_mg / 64),
+                 (unsigned long)(tap_ths * fs_mg / 32), ff_threshold_mg[ff_ths], ff_dur);
+    return ret;
+}
+
+esp_err_t imu_events_start(const imu_event_config_t *config)
+{
+    if (!imu_is_initialized() || running)
+        return ESP_ERR_INVALID_STATE;
+
+    imu_event_config_t defaults = IMU_EVENT_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.events == 0 || (cfg.events & ~IMU_EVENT_ALL))
+        return ESP_ERR_INVALID_ARG;
+
+    if (!irq_sem)
+    {
+        irq_sem = xSemaphoreCreateBinary();
+        stopped_sem = xSemaphoreCreateBinary();
+        if (!irq_sem || !stopped_sem)
+            return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = configure_engines();
+    if (ret != ESP_OK)
+        return ret;
+
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << cfg.int2_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        // Armed only once the handler is attached: a level already high
+        // would otherwise fire with nothing there to mask it
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ret = gpio_config(&io);
+    if (ret != ESP_OK)
+        return ret;
+    // Someone else may have installed the ISR service already
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+        return ret;
+
+    portENTER_CRITICAL(&cb_mux);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&cb_mux);
+
+    running = true;
+    if (xTaskCreate(event_task, "imu_events", EVENT_TASK_STACK, NULL, EVENT_TASK_PRIO, NULL) != pdPASS)
+    {
+        running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    ret = gpio_isr_handler_add(cfg.int2_gpio, int2_isr, NULL);
+    if (ret == ESP_OK)
+        ret = gpio_set_intr_type(cfg.int2_gpio, GPIO_INTR_HIGH_LEVEL);
+    if (ret == ESP_OK)
+        ret = gpio_intr_enable(cfg.int2_gpio);
+    if (ret != ESP_OK)
+    {
+        imu_events_stop();
+        return ret;
+    }
+
+    if (cfg.wake_from_light_sleep)
+    {
+        ret = gpio_wakeup_enable(cfg.int2_gpio, GPIO_INTR_HIGH_LEVEL);
+        if (ret == ESP_OK)
+            ret = esp_sleep_enable_gpio_wakeup();
+        if (ret != ESP_OK)
+            ESP_LOGW(TAG, "Light-sleep wake on GPIO %d unavailable: %s", cfg.int2_gpio, esp_err_to_name(ret));
+    }
+
+    // Anything latched before the handler was attached
+    xSemaphoreGive(irq_sem);
+    return ESP_OK;
+}
+
+esp_err_t imu_events_stop(void)
+{
+    if (!running)
+        return ESP_ERR_INVALID_STATE;
+
+    running = false;
+    xSemaphoreGive(irq_sem);
+    xSemaphoreTake(stopped_sem, portMAX_DELAY);
+
+    // The task no longer re-arms the pin; disarm it before the handler
+    // goes, since INT2 may still be latched high
+    gpio_intr_disable(cfg.int2_gpio);
+    gpio_set_intr_type(cfg.int2_gpio, GPIO_INTR_DISABLE);
+    gpio_isr_handler_remove(cfg.int2_gpio);
+    if (cfg.wake_from_light_sleep)
+        gpio_wakeup_disable(cfg.int2_gpio);
+
+    imu_reg_write(MD2_CFG, 0x00);
+    imu_reg_update(TAP_CFG, TAP_CFG_TILT_EN | TAP_CFG_TAP_XYZ_EN | TAP_CFG_LIR, 0);
+    imu_reg_update(CTRL10_C, CTRL10_C_FUNC_EN, 0);
+    return ESP_OK;
+}
+
+esp_err_t imu_register_event_cb(uint32_t mask, imu_event_cb_t cb, void *arg)
+{
+    if (!cb || mask == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&cb_mux);
+    if (callback_count == MAX_CALLBACKS)
+        ret = ESP_ERR_NO_MEM;
+    else
+        callbacks[callback_count++] = (callback_t){mask, cb, arg};
+    portEXIT_CRITICAL(&cb_mux);
+    return ret;
+}
+
+void imu_events_get_stats(imu_event_stats_t *out)
+{
+    portENTER_CRITICAL(&cb_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&cb_mux);
+}
@@ -0,0 +1,364 @@
+#include "imu.h"
+#include "imu_internal.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+// FIFO configuration registers
+#define FIFO_CTRL1 0x06 // watermark threshold [7:0], in 16-bit words
+#define FIFO_CTRL2 0x07 // TIMER_PEDO_FIFO_EN (bit 7), threshold [11:8]
+#define FIFO_CTRL3 0x08 // gyro (bits 5:3) and accel (bits 2:0) decimation
+#define FIFO_CTRL4 0x09 // timestamp/step data set decimation (bits 5:3)
+#define FIFO_CTRL5 0x0A // FIFO ODR (bits 6:3), FIFO mode (bits 2:0)
+#define INT1_FTH 0x08   // INT1_CTRL: FIFO watermark on INT1
+
+// FIFO status: unread words, flags and which word comes out next
+#define FIFO_STATUS1 0x3A
+#define FIFO_DATA_OUT_L 0x3E
+
+// The 24-bit timestamp counter
+#define TAP_CFG_TIMER_EN 0x80
+#define WAKE_UP_DUR_TIMER_HR 0x10 // 25 us per tick instead of 6.4 ms
+#define TIMESTAMP2_REG 0x42
+#define TIMESTAMP_RESET 0xAA
+#define TIMESTAMP_TICK_US 25
+
+#define FIFO_MODE_BYPASS 0x00
+#define FIFO_MODE_CONTINUOUS 0x06
+#define FIFO_NO_DECIMATION 0x01
+
+// Each sample is three data sets in this order: gyro X/Y/Z, accel X/Y/Z and
+// timestamp/step counter, 3 words each. FIFO_PATTERN counts words from the
+// start of a sample.
+#define FIFO_SAMPLE_WORDS 9
+#define FIFO_SAMPLE_BYTES (FIFO_SAMPLE_WORDS * 2)
+#define FIFO_MAX_WORDS 4095 // the threshold field is 12 bits
+
+// One burst read moves this many samples; a drain loops until the FIFO is empty
+#define BURST_SAMPLES 64
+
+// Samples waiting for consumers
+#define SAMPLE_RING_LEN 256
+
+#define FIFO_TASK_STACK 3072
+#define FIFO_TASK_PRIO 6
+
+// Tag for logging
+static const char *TAG = "IMU_FIFO";
+
+static imu_fifo_config_t cfg;
+static volatile bool running = false;
+static TaskHandle_t fifo_task_handle = NULL;
+static SemaphoreHandle_t watermark_sem = NULL;
+static SemaphoreHandle_t data_sem = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// Burst buffer and its decoded samples, only touched by the drain task.
+// Samples stay in counts until a reader asks for units.
+static uint8_t burst[BURST_SAMPLES * FIFO_SAMPLE_BYTES];
+static imu_raw_sample_t decoded[BURST_SAMPLES];
+static uint32_t seq = 0;
+
+// imu_fifo_read() converts this many at a time
+#define READ_CHUNK 32
+
+// IMU timer unwrapping and mapping onto esp_timer time
+static uint32_t last_ticks = 0;
+static int64_t imu_time_us = 0;
+static int64_t clock_offset_us = 0;
+static bool clock_anchored = false;
+
+static portMUX_TYPE ring_mux = portMUX_INITIALIZER_UNLOCKED;
+static imu_raw_sample_t ring[SAMPLE_RING_LEN];
+static size_t ring_head = 0;
+static size_t ring_count = 0;
+static imu_fifo_stats_t stats;
+
+static void IRAM_ATTR watermark_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(watermark_sem, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * The timestamp data set stores its 24 bits out of order:
+ * TIMESTAMP[15:8], TIMESTAMP[23:16], unused, TIMESTAMP[7:0], STEP[7:0], STEP[15:8]
+ */
+static int64_t unwrap_timestamp(const uint8_t *ts)
+{
+    uint32_t ticks = (uint32_t)ts[1] << 16 | (uint32_t)ts[0] << 8 | ts[3];
+    imu_time_us += (int64_t)((ticks - last_ticks) & 0xFFFFFF) * TIMESTAMP_TICK_US;
+    last_ticks = ticks;
+    return imu_time_us;
+}
+
+static void ring_push(const imu_raw_sample_t *samples, size_t n)
+{
+    portENTER_CRITICAL(&ring_mux);
+    for (size_t i = 0; i < n; i++)
+    {
+        // Full: the oldest sample goes, consumers want fresh data
+        if (ring_count == SAMPLE_RING_LEN)
+        {
+            ring_head = (ring_head + 1) % SAMPLE_RING_LEN;
+            ring_count--;
+            stats.dropped++;
+        }
+        ring[(ring_head + ring_count) % SAMPLE_RING_LEN] = samples[i];
+        ring_count++;
+    }
+    portEXIT_CRITICAL(&ring_mux);
+}
+
+/**
+ * Read everything the FIFO holds. The status registers say how many words
+ * are waiting and where in a sample the read pointer is; a partial sample
+ * at the front (after an overrun) is skipped so the rest lines up.
+ */
+static void fifo_drain(void)
+{
+    int64_t start = esp_timer_get_time();
+    uint8_t st[4];
+    if (imu_reg_read(FIFO_STATUS1, st, sizeof(st)) != ESP_OK)
+        return;
+
+    uint32_t words = (uint32_t)(st[1] & 0x0F) << 8 | st[0];
+    uint32_t pattern = (uint32_t)(st[3] & 0x03) << 8 | st[2];
+    bool overrun = st[1] & 0x40;
+
+    if (pattern != 0)
+    {
+        uint32_t skip = FIFO_SAMPLE_WORDS - pattern;
+        if (skip > words)
+            return;
+        if (imu_reg_read(FIFO_DATA_OUT_L, burst, skip * 2) != ESP_OK)
+            return;
+        words -= skip;
+    }
+
+    uint32_t total = 0;
+    imu_raw_sample_t *out = decoded;
+    while (words >= FIFO_SAMPLE_WORDS)
+    {
+        uint32_t n = words / FIFO_SAMPLE_WORDS;
+        if (n > BURST_SAMPLES)
+            n = BURST_SAMPLES;
+        if (imu_reg_read(FIFO_DATA_OUT_L, burst, n * FIFO_SAMPLE_BYTES) != ESP_OK)
+            break;
+        words -= n * FIFO_SAMPLE_WORDS;
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            const uint8_t *p = burst + i * FIFO_SAMPLE_BYTES;
+            imu_unpack_raw(p, &out[i]);
+            out[i].timestamp_us = unwrap_timestamp(p + 12);
+            out[i].seq = seq++;
+        }
+
+        // The newest sample left the IMU at most one period ago. Track the
+        // offset between the two clocks slowly so I2C jitter doesn't show
+        // up in the timestamps.
+        if (words < FIFO_SAMPLE_WORDS)
+        {
+            int64_t offset = esp_timer_get_time() - out[n - 1].timestamp_us;
+            clock_offset_us = clock_anchored ? clock_offset_us + (offset - clock_offset_us) / 16 : offset;
+            clock_anchored = true;
+        }
+        for (uint32_t i = 0; i < n; i++)
+            out[i].timestamp_us += clock_offset_us;
+
+        ring_push(out, n);
+        imu_consumers_publish(out, n);
+        total += n;
+    }
+
+    uint32_t drain_us = esp_timer_get_time() - start;
+    portENTER_CRITICAL(&ring_mux);
+    stats.batches++;
+    stats.samples += total;
+    if (overrun)
+        stats.overruns++;
+    if (total > stats.max_batch)
+        stats.max_batch = total;
+    if (drain_us > stats.max_drain_us)
+        stats.max_drain_us = drain_us;
+    portEXIT_CRITICAL(&ring_mux);
+
+    if (total)
+        xSemaphoreGive(data_sem);
+}
+
+/**
+ * Sleeps until the watermark interrupt. The timeout is a backstop in case
+ * an edge is missed while the FIFO was being read.
+ */
+static void fifo_task(void *arg)
+{
+    TickType_t backstop = pdMS_TO_TICKS(2000 * cfg.watermark / imu_odr_hz(cfg.odr)) + 1;
+    while (running)
+    {
+        xSemaphoreTake(watermark_sem, backstop);
+        if (running)
+            fifo_drain();
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t imu_fifo_start(const imu_fifo_config_t *config)
+{
+    if (!imu_is_initialized())
+        return ESP_ERR_INVALID_STATE;
+    if (running || imu_sampler_is_running())
+        return ESP_ERR_INVALID_STATE;
+
+    imu_fifo_config_t defaults = IMU_FIFO_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.odr < IMU_ODR_104HZ || cfg.odr > IMU_ODR_1660HZ || cfg.watermark == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    uint32_t fth = cfg.watermark * FIFO_SAMPLE_WORDS;
+    if (fth > FIFO_MAX_WORDS)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!watermark_sem)
+    {
+        watermark_sem = xSemaphoreCreateBinary();
+        data_sem = xSemaphoreCreateBinary();
+        stopped_sem = xSemaphoreCreateBinary();
+        if (!watermark_sem || !data_sem || !stopped_sem)
+            return ESP_ERR_NO_MEM;
+    }
+
+    // Sensor ODR follows the FIFO's; ranges and filtering stay as configured
+    imu_config_t sensor;
+    imu_get_config(&sensor);
+    sensor.odr = cfg.odr;
+    esp_err_t ret = imu_configure(&sensor);
+    if (ret != ESP_OK)
+        return ret;
+
+    // Timestamp counter at 25 us resolution, restarted from zero
+    // Both registers are shared with the embedded event functions
+    imu_reg_update(TAP_CFG, TAP_CFG_TIMER_EN, TAP_CFG_TIMER_EN);
+    imu_reg_update(WAKE_UP_DUR, WAKE_UP_DUR_TIMER_HR, WAKE_UP_DUR_TIMER_HR);
+    imu_reg_write(TIMESTAMP2_REG, TIMESTAMP_RESET);
+    last_ticks = 0;
+    imu_time_us = 0;
+    clock_anchored = false;
+
+    // Bypass mode empties the FIFO before it is reconfigured
+    imu_reg_write(FIFO_CTRL5, FIFO_MODE_BYPASS);
+    imu_reg_write(FIFO_CTRL1, fth & 0xFF);
+    imu_reg_write(FIFO_CTRL2, 0x80 | (fth >> 8));
+    imu_reg_write(FIFO_CTRL3, (FIFO_NO_DECIMATION << 3) | FIFO_NO_DECIMATION);
+    imu_reg_write(FIFO_CTRL4, FIFO_NO_DECIMATION << 3);
+    imu_reg_write(INT1_CTRL, INT1_FTH);
+
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << cfg.int_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    ret = gpio_config(&io);
+    if (ret != ESP_OK)
+        return ret;
+    // Someone else may have installed the ISR service already
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+        return ret;
+    ret = gpio_isr_handler_add(cfg.int_gpio, watermark_isr, NULL);
+    if (ret != ESP_OK)
+        return ret;
+
+    portENTER_CRITICAL(&ring_mux);
+    ring_head = ring_count = 0;
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&ring_mux);
+
+    running = true;
+    if (xTaskCreate(fifo_task, "imu_fifo", FIFO_TASK_STACK, NULL, FIFO_TASK_PRIO, &fifo_task_handle) != pdPASS)
+    {
+        running = false;
+        gpio_isr_handler_remove(cfg.int_gpio);
+        return ESP_ERR_NO_MEM;
+    }
+
+    imu_reg_write(FIFO_CTRL5, (cfg.odr << 3) | FIFO_MODE_CONTINUOUS);
+    ESP_LOGI(TAG, "FIFO running at %lu Hz, watermark %u samples", (unsigned long)imu_odr_hz(cfg.odr), cfg.watermark);
+    return ESP_OK;
+}
+
+esp_err_t imu_fifo_stop(void)
+{
+    if (!running)
+        return ESP_ERR_INVALID_STATE;
+
+    running = false;
+    xSemaphoreGive(watermark_sem);
+    xSemaphoreTake(stopped_sem, portMAX_DELAY);
+    fifo_task_handle = NULL;
+
+    gpio_isr_handler_remove(cfg.int_gpio);
+    imu_reg_write(INT1_CTRL, 0x00);
+    imu_reg_write(FIFO_CTRL5, FIFO_MODE_BYPASS);
+    return ESP_OK;
+}
+
+size_t imu_read_batch(imu_raw_sample_t *out, size_t max, uint32_t timeout_ms, imu_scale_t *scale)
+{
+    if (!out || max == 0 || !data_sem)
+        return 0;
+    if (scale)
+        imu_get_scale(scale);
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    while (true)
+    {
+        size_t n = 0;
+        portENTER_CRITICAL(&ring_mux);
+        while (n < max && ring_count > 0)
+        {
+            out[n++] = ring[ring_head];
+            ring_head = (ring_head + 1) % SAMPLE_RING_LEN;
+            ring_count--;
+        }
+        portEXIT_CRITICAL(&ring_mux);
+        if (n > 0)
+            return n;
+
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0)
+            return 0;
+        xSemaphoreTake(data_sem, deadline - now);
+    }
+}
+
+size_t imu_fifo_read(imu_sample_t *out, size_t max, uint32_t timeout_ms)
+{
+    imu_raw_sample_t raw[READ_CHUNK];
+    imu_scale_t scale;
+    size_t n = imu_read_batch(raw, max < READ_CHUNK ? max : READ_CHUNK, timeout_ms, &scale);
+    imu_convert_batch(raw, out, n, &scale);
+    return n;
+}
+
+bool imu_fifo_is_running(void)
+{
+    return running;
+}
+
+void imu_fifo_get_stats(imu_fifo_stats_t *out)
+{
+    portENTER_CRITICAL(&ring_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&ring_mux);
+}
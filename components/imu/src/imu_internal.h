@@ -0,0 +1,69 @@
+#ifndef IMU_INTERNAL_H
+#define IMU_INTERNAL_H
+
+// Shared between the IMU driver's source files; not part of the public API.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "imu.h"
+
+// LSM6DS3 registers used by more than one file
+#define CTRL1_XL 0x10
+#define CTRL2_G 0x11
+#define CTRL3_C 0x12
+#define INT1_CTRL 0x0D
+#define TAP_CFG 0x58     // timestamp timer enable, tilt/tap enables, interrupt latching
+#define WAKE_UP_DUR 0x5C // timestamp resolution, wake-up and free-fall durations
+
+#define IMU_STANDARD_GRAVITY 9.80665f
+
+esp_err_t imu_reg_write(uint8_t reg, uint8_t data);
+esp_err_t imu_reg_read(uint8_t reg, uint8_t *data, size_t len);
+
+// Read-modify-write of the bits in mask, for registers shared between features
+esp_err_t imu_reg_update(uint8_t reg, uint8_t mask, uint8_t value);
+
+/**
+ * Current gyro and accel output registers, 12 bytes in imu_convert() order.
+ */
+esp_err_t imu_read_output(uint8_t raw[12]);
+
+/**
+ * Hand samples to every registered consumer ring. Only one acquisition path
+ * (FIFO drain or DRDY sampler) runs at a time, so there is a single producer.
+ */
+void imu_consumers_publish(const imu_raw_sample_t *samples, size_t n);
+
+bool imu_fifo_is_running(void);
+bool imu_sampler_is_running(void);
+
+/**
+ * Little-endian gyro X/Y/Z followed by accel X/Y/Z, as laid out both in the
+ * output registers and in each FIFO sample, converted to dps and m/s².
+ */
+void imu_convert(const uint8_t raw[12], imu_data_t *data);
+
+/**
+ * Same layout as imu_convert(), kept as sensor counts. Both take the
+ * calibration offsets off in integer space before anything else.
+ */
+void imu_unpack_raw(const uint8_t raw[12], imu_raw_sample_t *out);
+
+/**
+ * Recompute imu_get_scale() from the values just written to CTRL1_XL and
+ * CTRL2_G. Call after every full-scale change.
+ */
+void imu_update_scale(uint8_t ctrl1_xl, uint8_t ctrl2_g);
+
+// Gyro X/Y/Z then accel X/Y/Z, in counts at the given scale; they are
+// converted to the current one
+void imu_set_offsets(const int16_t offsets[6], const imu_scale_t *at);
+void imu_get_offsets(int16_t out[6]);
+
+/**
+ * Apply the calibration stored in NVS, if there is one.
+ */
+esp_err_t imu_calibration_load(void);
+
+#endif // IMU_INTERNAL_H
@@ -0,0 +1,138 @@
+#include "imu.h"
+#include "imu_ahrs.h"
+#include "imu_internal.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ORIENTATION_TASK_STACK 3072
+#define ORIENTATION_RING_LEN 64
+#define ORIENTATION_BATCH 16
+
+// A gap this long means the samples stopped; integrating across it would
+// just add the gyro bias times the gap
+#define MAX_DT_US 100000
+
+#define DEG_TO_RAD 0.01745329252f
+
+// Tag for logging
+static const char *TAG = "IMU_AHRS";
+
+static imu_orientation_config_t cfg;
+static TaskHandle_t orientation_task_handle = NULL;
+static imu_ring_t *ring = NULL;
+
+static portMUX_TYPE state_mux = portMUX_INITIALIZER_UNLOCKED;
+static imu_quaternion_t latest_q;
+static int64_t latest_ts = 0;
+static bool have_estimate = false;
+static imu_orientation_stats_t stats;
+
+static void orientation_task(void *arg)
+{
+    imu_ahrs_t ahrs;
+    imu_ahrs_init(&ahrs, cfg.beta);
+    imu_raw_sample_t batch[ORIENTATION_BATCH];
+    int64_t last_ts = 0;
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Counts to rad/s in one multiply; the accelerometer is normalized
+        // by the filter, so it stays in counts
+        imu_scale_t scale;
+        imu_get_scale(&scale);
+        const float gyro_scale = scale.gyro_dps_per_lsb * DEG_TO_RAD;
+
+        size_t n;
+        while ((n = imu_ring_pop(ring, batch, ORIENTATION_BATCH)) > 0)
+        {
+            uint32_t gaps = 0;
+            uint32_t start = esp_cpu_get_cycle_count();
+            for (size_t i = 0; i < n; i++)
+            {
+                const imu_raw_sample_t *s = &batch[i];
+                int64_t dt_us = s->timestamp_us - last_ts;
+                last_ts = s->timestamp_us;
+                if (ahrs.initialized && (dt_us <= 0 || dt_us > MAX_DT_US))
+                {
+                    imu_ahrs_init(&ahrs, cfg.beta);
+                    gaps++;
+                }
+                imu_ahrs_update(&ahrs,
+                                s->gyroscope.x * gyro_scale, s->gyroscope.y * gyro_scale, s->gyroscope.z * gyro_scale,
+                                s->accelerometer.x, s->accelerometer.y, s->accelerometer.z,
+                                dt_us * 1e-6f);
+            }
+            uint32_t cycles = (esp_cpu_get_cycle_count() - start) / n;
+
+            portENTER_CRITICAL(&state_mux);
+            latest_q = ahrs.q;
+            latest_ts = last_ts;
+            have_estimate = ahrs.initialized;
+            stats.updates += n;
+            stats.gaps += gaps;
+            stats.last_update_cycles = cycles;
+            if (cycles > stats.max_update_cycles)
+                stats.max_update_cycles = cycles;
+            portEXIT_CRITICAL(&state_mux);
+        }
+    }
+}
+
+esp_err_t imu_orientation_start(const imu_orientation_config_t *config)
+{
+    if (orientation_task_handle)
+        return ESP_ERR_INVALID_STATE;
+
+    imu_orientation_config_t defaults = IMU_ORIENTATION_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.beta <= 0.0f || cfg.core < 0 || cfg.core >= portNUM_PROCESSORS || cfg.priority >= configMAX_PRIORITIES)
+        return ESP_ERR_INVALID_ARG;
+
+    if (xTaskCreatePinnedToCore(orientation_task, "imu_ahrs", ORIENTATION_TASK_STACK, NULL, cfg.priority,
+                                &orientation_task_handle, cfg.core) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    // Producers can push, and wake the task, as soon as the ring is
+    // registered; hold the task until ring points at it
+    vTaskSuspend(orientation_task_handle);
+    ring = imu_ring_create(ORIENTATION_RING_LEN, orientation_task_handle);
+    if (!ring)
+    {
+        vTaskDelete(orientation_task_handle);
+        orientation_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    vTaskResume(orientation_task_handle);
+
+    ESP_LOGI(TAG, "Orientation filter running, beta %.3f", cfg.beta);
+    return ESP_OK;
+}
+
+esp_err_t imu_get_orientation(imu_orientation_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&state_mux);
+    bool valid = have_estimate;
+    out->q = latest_q;
+    out->timestamp_us = latest_ts;
+    portEXIT_CRITICAL(&state_mux);
+    if (!valid)
+        return ESP_ERR_INVALID_STATE;
+
+    // Outside the lock; the trig is most of the cost
+    imu_ahrs_to_euler(&out->q, &out->roll, &out->pitch, &out->yaw);
+    return ESP_OK;
+}
+
+void imu_orientation_get_stats(imu_orientation_stats_t *out)
+{
+    portENTER_CRITICAL(&state_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&state_mux);
+}
@@ -0,0 +1,146 @@
+#include "imu.h"
+#include "imu_internal.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define IMU_MAX_CONSUMERS 4
+
+/**
+ * head is only written by the producer and tail only by the consumer; each
+ * side publishes its index with release ordering after touching the slots,
+ * and reads the other side's index with acquire ordering. Indices run
+ * freely and are masked on access.
+ */
+struct imu_ring
+{
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    uint32_t mask;
+    TaskHandle_t notify;
+
+    // Producer side
+    uint32_t pushed;
+    uint32_t overruns;
+
+    // Consumer side
+    uint32_t popped;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+
+    imu_raw_sample_t slots[];
+};
+
+static imu_ring_t *consumers[IMU_MAX_CONSUMERS];
+static _Atomic int consumer_count = 0;
+static portMUX_TYPE register_mux = portMUX_INITIALIZER_UNLOCKED;
+
+imu_ring_t *imu_ring_create(size_t capacity, TaskHandle_t notify_task)
+{
+    if (capacity < 2)
+        capacity = 2;
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    imu_ring_t *r = heap_caps_calloc(1, sizeof(imu_ring_t) + size * sizeof(imu_raw_sample_t),
+                                     MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!r)
+        return NULL;
+    r->mask = size - 1;
+    r->notify = notify_task;
+
+    // The slot is filled before the count makes it visible to the producer
+    portENTER_CRITICAL(&register_mux);
+    int n = atomic_load_explicit(&consumer_count, memory_order_relaxed);
+    if (n == IMU_MAX_CONSUMERS)
+    {
+        portEXIT_CRITICAL(&register_mux);
+        heap_caps_free(r);
+        return NULL;
+    }
+    consumers[n] = r;
+    atomic_store_explicit(&consumer_count, n + 1, memory_order_release);
+    portEXIT_CRITICAL(&register_mux);
+    return r;
+}
+
+static void ring_push(imu_ring_t *r, const imu_raw_sample_t *samples, size_t n)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t space = r->mask + 1 - (head - tail);
+    size_t take = n < space ? n : space;
+
+    for (size_t i = 0; i < take; i++)
+        r->slots[(head + i) & r->mask] = samples[i];
+    atomic_store_explicit(&r->head, head + take, memory_order_release);
+
+    r->pushed += take;
+    r->overruns += n - take;
+    if (take && r->notify)
+        xTaskNotifyGive(r->notify);
+}
+
+void imu_consumers_publish(const imu_raw_sample_t *samples, size_t n)
+{
+    int count = atomic_load_explicit(&consumer_count, memory_order_acquire);
+    for (int i = 0; i < count; i++)
+        ring_push(consumers[i], samples, n);
+}
+
+static void note_latency(imu_ring_t *r, const imu_raw_sample_t *newest, uint32_t count)
+{
+    int64_t age = esp_timer_get_time() - newest->timestamp_us;
+    uint32_t age_us = age < 0 ? 0 : (uint32_t)age;
+    r->popped += count;
+    r->latency_sum_us += (uint64_t)age_us * count;
+    if (age_us > r->latency_max_us)
+        r->latency_max_us = age_us;
+}
+
+size_t imu_ring_pop(imu_ring_t *r, imu_raw_sample_t *out, size_t max)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t avail = head - tail;
+    size_t n = avail < max ? avail : max;
+    if (n == 0)
+        return 0;
+
+    for (size_t i = 0; i < n; i++)
+        out[i] = r->slots[(tail + i) & r->mask];
+    atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+
+    // Latency is measured on the newest sample handed over; older ones in
+    // the same batch are older by design
+    note_latency(r, &out[n - 1], n);
+    return n;
+}
+
+bool imu_ring_pop_latest(imu_ring_t *r, imu_raw_sample_t *out)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (head == tail)
+        return false;
+
+    *out = r->slots[(head - 1) & r->mask];
+    atomic_store_explicit(&r->tail, head, memory_order_release);
+    note_latency(r, out, 1);
+    return true;
+}
+
+void imu_ring_get_stats(imu_ring_t *r, imu_ring_stats_t *out)
+{
+    // Plain counters written by one side each; a torn read only skews a
+    // single report
+    out->pushed = r->pushed;
+    out->overruns = r->overruns;
+    out->popped = r->popped;
+    out->latency_mean_us = r->popped ? r->latency_sum_us / r->popped : 0;
+    out->latency_max_us = r->latency_max_us;
+}
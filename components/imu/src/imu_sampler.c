@@ -0,0 +1,179 @@
+#include "imu.h"
+#include "imu_internal.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+#define DRDY_PULSE_CFG_G 0x0B // DRDY_PULSED (bit 7): 75 us pulses instead of a latched level
+#define INT1_DRDY_G 0x02      // INT1_CTRL: gyro data-ready on INT1
+
+#define SAMPLER_TASK_STACK 3072
+
+// Tag for logging
+static const char *TAG = "IMU_SAMPLER";
+
+static imu_sampler_config_t cfg;
+static volatile bool running = false;
+static TaskHandle_t sampler_task_handle = NULL;
+static SemaphoreHandle_t stopped_sem = NULL;
+
+// Written by the ISR, read by the task after the notification
+static volatile int64_t drdy_time_us = 0;
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static imu_sampler_stats_t stats;
+
+/**
+ * The interrupt time is the sample time: the IMU raises DRDY as the sample
+ * lands in the output registers, so I2C latency doesn't move the timestamp.
+ */
+static void IRAM_ATTR drdy_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    drdy_time_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(sampler_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void sampler_task(void *arg)
+{
+    uint32_t seq = 0;
+    uint8_t raw[12];
+    imu_raw_sample_t sample;
+
+    while (running)
+    {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        if (!running)
+            break;
+        if (pending == 0)
+            continue;
+
+        int64_t ts = drdy_time_us;
+        esp_err_t ret = imu_read_output(raw);
+
+        portENTER_CRITICAL(&stats_mux);
+        // More than one pending edge means a sample was overwritten unread
+        stats.missed += pending - 1;
+        if (ret != ESP_OK)
+            stats.read_errors++;
+        portEXIT_CRITICAL(&stats_mux);
+
+        seq += pending;
+        if (ret != ESP_OK)
+            continue;
+
+        imu_unpack_raw(raw, &sample);
+        sample.timestamp_us = ts;
+        sample.seq = seq - 1;
+        imu_consumers_publish(&sample, 1);
+
+        uint32_t read_us = esp_timer_get_time() - ts;
+        portENTER_CRITICAL(&stats_mux);
+        stats.samples++;
+        if (read_us > stats.max_read_us)
+            stats.max_read_us = read_us;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t imu_sampler_start(const imu_sampler_config_t *config)
+{
+    if (!imu_is_initialized())
+        return ESP_ERR_INVALID_STATE;
+    if (running || imu_fifo_is_running())
+        return ESP_ERR_INVALID_STATE;
+
+    imu_sampler_config_t defaults = IMU_SAMPLER_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.core < 0 || cfg.core >= portNUM_PROCESSORS || cfg.priority >= configMAX_PRIORITIES)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!stopped_sem)
+    {
+        stopped_sem = xSemaphoreCreateBinary();
+        if (!stopped_sem)
+            return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&stats_mux);
+
+    // The task must exist before the ISR can notify it
+    running = true;
+    if (xTaskCreatePinnedToCore(sampler_task, "imu_sampler", SAMPLER_TASK_STACK, NULL, cfg.priority,
+                                &sampler_task_handle, cfg.core) != pdPASS)
+    {
+        running = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << cfg.int_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    esp_err_t ret = gpio_config(&io);
+    if (ret == ESP_OK)
+    {
+        // Someone else may have installed the ISR service already
+        ret = gpio_install_isr_service(0);
+        if (ret == ESP_ERR_INVALID_STATE)
+            ret = ESP_OK;
+    }
+    if (ret == ESP_OK)
+        ret = gpio_isr_handler_add(cfg.int_gpio, drdy_isr, NULL);
+    if (ret != ESP_OK)
+    {
+        imu_sampler_stop();
+        return ret;
+    }
+
+    imu_reg_write(DRDY_PULSE_CFG_G, 0x80);
+    imu_reg_write(INT1_CTRL, INT1_DRDY_G);
+
+    // Clears a data-ready that was already latched, so the first edge comes
+    uint8_t raw[12];
+    imu_read_output(raw);
+
+    ESP_LOGI(TAG, "Sampling on DRDY, GPIO %d, core %d, priority %d", cfg.int_gpio, cfg.core, cfg.priority);
+    return ESP_OK;
+}
+
+esp_err_t imu_sampler_stop(void)
+{
+    if (!running)
+        return ESP_ERR_INVALID_STATE;
+
+    gpio_isr_handler_remove(cfg.int_gpio);
+    running = false;
+    xTaskNotifyGive(sampler_task_handle);
+    xSemaphoreTake(stopped_sem, portMAX_DELAY);
+    sampler_task_handle = NULL;
+
+    imu_reg_write(INT1_CTRL, 0x00);
+    imu_reg_write(DRDY_PULSE_CFG_G, 0x00);
+    return ESP_OK;
+}
+
+bool imu_sampler_is_running(void)
+{
+    return running;
+}
+
+void imu_sampler_get_stats(imu_sampler_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
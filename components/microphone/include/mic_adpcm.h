@@ -0,0 +1,40 @@
+#pragma once
+
+// IMA-ADPCM encoder for mic_stream, producing the block layout of WAV
+// format 0x11, so anything it writes can be checked against a desktop
+// decoder.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Mono blocks of 256 bytes: a 4-byte header carrying the first sample,
+// then 504 samples at 4 bits each
+#define MIC_ADPCM_BLOCK_BYTES    256
+#define MIC_ADPCM_BLOCK_SAMPLES  505
+
+typedef struct {
+    int32_t predictor;
+    int32_t index;      // into the step table; carries from block to block
+} mic_adpcm_t;
+
+void mic_adpcm_init(mic_adpcm_t *enc);
+
+/**
+ * Encode MIC_ADPCM_BLOCK_SAMPLES samples into one MIC_ADPCM_BLOCK_BYTES block.
+ */
+void mic_adpcm_encode_block(mic_adpcm_t *enc, const int16_t *in, uint8_t *out);
+
+/**
+ * WAV header for an endless mono stream, 16-bit PCM or IMA-ADPCM, with the
+ * size fields left at their maximum. Returns the length written (44 or 48
+ * bytes); buf needs 64.
+ */
+size_t mic_wav_header(uint8_t *buf, uint32_t rate_hz, int adpcm);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "mic_spectrum.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIC_CLASSIFIER_MAX_TEMPLATES 8
+
+/**
+ * Called from the classifier task for every hop; keep it short.
+ */
+typedef void (*mic_features_cb_t)(const mic_features_t *features, int64_t timestamp_us, void *arg);
+
+typedef struct {
+    int match;                // template index, or -1 for an unknown sound
+    char name[16];            // template name, or "unknown"
+    float distance;           // to the nearest template, dB
+    int64_t timestamp_us;     // onset, in esp_timer time
+} mic_class_result_t;
+
+typedef void (*mic_class_cb_t)(const mic_class_result_t *result, void *arg);
+
+typedef struct {
+    uint16_t segment_hops;    // hops after an onset averaged into one shape
+    int core;
+    int priority;
+    mic_spectrum_config_t spectrum;
+} mic_classifier_config_t;
+
+#define MIC_CLASSIFIER_CONFIG_DEFAULT() {        \
+    .segment_hops = 8,                           \
+    .core = 0,                                   \
+    .priority = 4,                               \
+    .spectrum = MIC_SPECTRUM_CONFIG_DEFAULT(),   \
+}
+
+typedef struct {
+    uint32_t hops;
+    uint32_t onsets;
+    uint32_t matched;
+    uint32_t unknown;
+    uint32_t overruns;        // times the classifier fell a ring behind
+    uint32_t mean_hop_cycles;
+    uint32_t max_hop_cycles;
+    uint32_t budget_permille; // mean hop cost over the cycles one core has per hop
+} mic_classifier_stats_t;
+
+/**
+ * Start a task that reads the capture ring (starting capture if needed),
+ * produces mic_features_t every MIC_HOP samples, and classifies the few
+ * hops after each onset against the templates.
+ */
+esp_err_t mic_classifier_start(const mic_classifier_config_t *config);
+
+/**
+ * Add or replace (by name) a template. Up to MIC_CLASSIFIER_MAX_TEMPLATES.
+ */
+esp_err_t mic_classifier_set_template(const mic_sound_template_t *tmpl);
+
+/**
+ * Store the shape of the most recent onset segment as a template, e.g.
+ * right after the dog barked. ESP_ERR_INVALID_STATE if there is none yet.
+ */
+esp_err_t mic_classifier_learn(const char *name, float max_distance);
+
+esp_err_t mic_classifier_register_features_cb(mic_features_cb_t cb, void *arg);
+esp_err_t mic_classifier_register_cb(mic_class_cb_t cb, void *arg);
+
+/**
+ * Latest features. ESP_ERR_INVALID_STATE until the first hop.
+ */
+esp_err_t mic_classifier_get_features(mic_features_t *out);
+
+void mic_classifier_get_stats(mic_classifier_stats_t *out);
+
+/**
+ * Register GET /api/audio/features with an existing server.
+ */
+esp_err_t mic_classifier_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
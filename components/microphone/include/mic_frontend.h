@@ -0,0 +1,61 @@
+#pragma once
+
+// Sample conditioning between the I2S DMA and the capture ring. Works on
+// plain sample buffers, so raw frames dumped from the DMA can be pushed
+// through it and timed on a desktop.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int32_t gain_q8;    // 256 is the level of the old raw >> 14 conversion; up to 16x
+    uint8_t dc_shift;   // DC estimate moves 1/2^shift of the way to each block's mean; 0 disables
+} mic_frontend_config_t;
+
+#define MIC_FRONTEND_CONFIG_DEFAULT() { \
+    .gain_q8 = 256,                     \
+    .dc_shift = 3,                      \
+}
+
+#define MIC_FRONTEND_MAX_GAIN_Q8 (16 * 256)
+
+typedef struct {
+    mic_frontend_config_t cfg;
+    int32_t dc_q8;      // in units of raw >> 14, with 8 fraction bits
+} mic_frontend_t;
+
+void mic_frontend_init(mic_frontend_t *fe, const mic_frontend_config_t *cfg);
+
+/**
+ * Turn n raw INMP441 frames (24 bits, MSB aligned in 32) into 16-bit PCM:
+ * shift, subtract the DC estimate, apply gain and saturate, in one pass.
+ * The DC estimate is updated from the block afterwards, so its corner
+ * frequency depends on the block size: about rate / n / 2^dc_shift / 2π.
+ * Returns the number of samples that clipped.
+ */
+uint32_t mic_frontend_process(mic_frontend_t *fe, const int32_t *raw, int16_t *out, size_t n);
+
+/**
+ * 2:1 decimation through a 7-tap half-band low-pass, streaming across
+ * calls. Odd counts are fine; the phase carries over.
+ */
+typedef struct {
+    int16_t hist[6];    // last inputs, newest last
+    uint8_t phase;
+} mic_decimator_t;
+
+void mic_decimator_init(mic_decimator_t *dec);
+
+/**
+ * out may equal in. Returns the number of samples written, about n / 2.
+ */
+size_t mic_decimate2(mic_decimator_t *dec, const int16_t *in, int16_t *out, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
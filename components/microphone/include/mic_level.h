@@ -0,0 +1,85 @@
+#pragma once
+
+// Per-block level measurement and activity detection behind mic_monitor.
+// mic_monitor owns the task and the locking; what is here is arithmetic,
+// which is what makes tuning against recorded barks practical.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// dBFS reported for digital silence
+#define MIC_LEVEL_FLOOR_DBFS (-100.0f)
+
+typedef struct {
+    float rms_dbfs;
+    float peak_dbfs;
+    uint16_t rms;
+    uint16_t peak;          // largest magnitude in the block
+    uint32_t crossings;     // sign changes in the block
+} mic_level_t;
+
+/**
+ * RMS, peak and zero crossings of one block in a single pass. Nothing is
+ * kept between blocks.
+ */
+void mic_level_measure(const int16_t *x, size_t n, mic_level_t *out);
+
+typedef struct {
+    float margin_db;        // above the noise floor to count as active
+    float min_dbfs;         // never active below this, however quiet the room
+    uint32_t zcr_max_hz;    // crossing rate above this is hiss, not a voice
+    uint16_t attack_ms;     // activity must last this long to start an event
+    uint16_t hangover_ms;   // and stop for this long to end it
+    uint16_t floor_window_ms; // the floor is the quietest block in this long
+} mic_vad_config_t;
+
+#define MIC_VAD_CONFIG_DEFAULT() {  \
+    .margin_db = 12.0f,             \
+    .min_dbfs = -55.0f,             \
+    .zcr_max_hz = 5000,             \
+    .attack_ms = 48,                \
+    .hangover_ms = 300,             \
+    .floor_window_ms = 5000,        \
+}
+
+typedef enum {
+    MIC_VAD_NONE = 0,
+    MIC_VAD_START,
+    MIC_VAD_STOP,
+} mic_vad_event_t;
+
+// The floor window is tracked as this many sub-windows, so it slides in
+// steps of a quarter window rather than keeping every block's level
+#define MIC_VAD_FLOOR_SUBWINDOWS 4
+
+typedef struct {
+    mic_vad_config_t cfg;
+    float noise_dbfs;       // tracked floor
+    float sub_min[MIC_VAD_FLOOR_SUBWINDOWS]; // quietest block of each finished sub-window
+    float cur_min;          // quietest block of the sub-window being filled
+    uint32_t sub_ms;        // how much of it is filled
+    uint8_t sub_next;       // slot the current sub-window goes into
+    bool active;
+    uint32_t run_ms;        // how long the current candidate state has held
+} mic_vad_t;
+
+void mic_vad_init(mic_vad_t *vad, const mic_vad_config_t *cfg);
+
+/**
+ * Feed one block's level. block_ms is the block length, rate_hz the rate
+ * the block was taken at (for the crossing rate). The noise floor is the
+ * minimum over the last floor_window_ms, loud blocks included: a bark is
+ * shorter than the window and never reaches it, while a noise that stays
+ * (a fan, a running tap) becomes the floor within about a window and ends the
+ * event it started.
+ */
+mic_vad_event_t mic_vad_update(mic_vad_t *vad, const mic_level_t *level, uint32_t block_ms, uint32_t rate_hz);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "mic_level.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MIC_SOUND_START = 0,
+    MIC_SOUND_STOP,
+} mic_sound_event_type_t;
+
+typedef struct {
+    mic_sound_event_type_t type;
+    float rms_dbfs;           // level of the block that triggered it
+    int64_t timestamp_us;     // estimated onset or end, in esp_timer time
+    uint32_t duration_ms;     // on STOP, how long the sound lasted
+} mic_sound_event_t;
+
+/**
+ * Called from the monitor task; keep it short.
+ */
+typedef void (*mic_sound_cb_t)(const mic_sound_event_t *event, void *arg);
+
+typedef struct {
+    uint16_t block_ms;        // analysis block length
+    int core;
+    int priority;
+    mic_vad_config_t vad;
+} mic_monitor_config_t;
+
+#define MIC_MONITOR_CONFIG_DEFAULT() {   \
+    .block_ms = 16,                      \
+    .core = 0,                           \
+    .priority = 5,                       \
+    .vad = MIC_VAD_CONFIG_DEFAULT(),     \
+}
+
+typedef struct {
+    mic_level_t level;        // latest block
+    float noise_dbfs;
+    bool active;
+    int64_t timestamp_us;     // end of the latest block
+} mic_monitor_level_t;
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t events;          // sounds started
+    uint32_t overruns;        // times the monitor fell a ring behind
+    uint32_t max_block_cycles;
+    uint32_t load_permille;   // analysis cycles over the audio time they cover
+} mic_monitor_stats_t;
+
+/**
+ * Start a task that reads the capture ring (starting capture if needed),
+ * measures every block and runs the activity detector on it.
+ */
+esp_err_t mic_monitor_start(const mic_monitor_config_t *config);
+
+/**
+ * Latest levels. ESP_ERR_INVALID_STATE until the first block.
+ */
+esp_err_t mic_monitor_get_level(mic_monitor_level_t *out);
+
+void mic_monitor_get_stats(mic_monitor_stats_t *out);
+
+esp_err_t mic_monitor_register_cb(mic_sound_cb_t cb, void *arg);
+
+/**
+ * Register GET /api/audio/level with an existing server.
+ */
+esp_err_t mic_monitor_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
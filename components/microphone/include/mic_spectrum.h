@@ -0,0 +1,86 @@
+#pragma once
+
+// Spectral features and nearest-centroid matching behind mic_classifier.
+// No ESP-IDF dependencies: on the target the FFT is esp-dsp's radix-2
+// kernel, on the host a plain C one, so recorded clips can be run through
+// the same code off the robot.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIC_FFT_SIZE    512     // 32 ms at 16 kHz
+#define MIC_HOP         256     // 50% overlap
+#define MIC_MEL_BANDS   20
+
+typedef struct {
+    float onset_ratio;      // flux must exceed its running mean by this factor
+    float onset_min_db;     // and this absolute amount, per band on average
+    uint16_t refractory;    // hops after an onset before the next can fire
+} mic_spectrum_config_t;
+
+#define MIC_SPECTRUM_CONFIG_DEFAULT() { \
+    .onset_ratio = 2.5f,                \
+    .onset_min_db = 2.0f,               \
+    .refractory = 8,                    \
+}
+
+typedef struct {
+    float mel[MIC_MEL_BANDS];   // band energies in dB, about 0 dB for a full-scale sine
+    float flux;                 // mean rise in dB per band since the previous hop
+    bool onset;
+} mic_features_t;
+
+typedef struct {
+    mic_spectrum_config_t cfg;
+    float window[MIC_FFT_SIZE];
+    float fft[2 * MIC_FFT_SIZE];    // interleaved re/im work buffer
+    // Triangular mel filters with shared edges: each bin sits between two
+    // edges, rising into one band and falling out of the previous
+    uint8_t bin_seg[MIC_FFT_SIZE / 2 + 1];
+    float bin_frac[MIC_FFT_SIZE / 2 + 1];
+    float prev_mel[MIC_MEL_BANDS];
+    float flux_mean;
+    uint32_t since_onset;
+    bool primed;
+} mic_spectrum_t;
+
+/**
+ * Build the window and filter bank for rate_hz. Returns false if the FFT
+ * tables can't be set up.
+ */
+bool mic_spectrum_init(mic_spectrum_t *sp, uint32_t rate_hz, const mic_spectrum_config_t *cfg);
+
+/**
+ * Window and transform the newest MIC_FFT_SIZE samples, oldest first.
+ * Call once per MIC_HOP new samples.
+ */
+void mic_spectrum_process(mic_spectrum_t *sp, const int16_t *frame, mic_features_t *out);
+
+typedef struct {
+    char name[16];
+    float shape[MIC_MEL_BANDS];     // from mic_spectrum_shape()
+    float max_distance;             // dB; further than this is no match
+} mic_sound_template_t;
+
+/**
+ * Level-independent spectral shape: the bands relative to the loudest,
+ * floored 40 dB down, minus their mean. The same bark matches close by or
+ * across the room.
+ */
+void mic_spectrum_shape(const float mel[MIC_MEL_BANDS], float shape[MIC_MEL_BANDS]);
+
+/**
+ * Index of the nearest template by RMS band difference, or -1 if none is
+ * within its max_distance. distance, if set, gets the nearest one's.
+ */
+int mic_spectrum_match(const mic_sound_template_t *templates, size_t n, const float shape[MIC_MEL_BANDS],
+                       float *distance);
+
+#ifdef __cplusplus
+}
+#endif
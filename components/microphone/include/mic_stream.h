@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MIC_STREAM_MAX_CLIENTS 2
+
+typedef struct {
+    uint32_t clients;         // connected now
+    uint32_t blocks;          // sent since boot
+    uint32_t dropped_blocks;  // skipped because a client fell behind
+    uint32_t max_send_us;
+    uint32_t mean_latency_ms; // oldest sample in a block, capture to handed to TCP
+    uint32_t max_latency_ms;
+} mic_stream_stats_t;
+
+void mic_stream_get_stats(mic_stream_stats_t *out);
+
+/**
+ * Register GET /api/audio/stream[?format=wav|adpcm] with an existing server.
+ * Both are endless chunked WAV; adpcm is IMA-ADPCM at a quarter of the
+ * bandwidth. Starts capture if it isn't running.
+ */
+esp_err_t mic_stream_register_handlers(httpd_handle_t server);
+
+#ifdef __cplusplus
+}
+#endif
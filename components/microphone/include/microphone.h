@@ -3,6 +3,8 @@
 #include "esp_err.h"
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include "mic_frontend.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,6 +19,10 @@ esp_err_t microphone_init(void);
 
 /**
  * @brief Read sound amplitude from microphone.
+ *
+ * Compatibility wrapper over the capture ring: starts capture with the
+ * defaults if needed and blocks until all samples have arrived. Call it
+ * from one task at a time.
  * 
  * @param buffer   Pointer to int16_t array for audio samples.
  * @param samples  Number of samples to read.
@@ -24,6 +30,100 @@ esp_err_t microphone_init(void);
  */
 size_t microphone_read(int16_t *buffer, size_t samples);
 
+// ======= Continuous capture =======
+
+typedef struct {
+    uint32_t block_frames;  // frames per DMA drain, rounded up to a power of two
+    uint32_t ring_ms;       // history kept for readers, rounded up to a power of two frames
+    int core;               // core the capture task is pinned to
+    int priority;
+    mic_frontend_config_t frontend;
+} mic_capture_config_t;
+
+#define MIC_CAPTURE_CONFIG_DEFAULT() {         \
+    .block_frames = 256,                       \
+    .ring_ms = 1000,                           \
+    .core = 0,                                 \
+    .priority = 15,                            \
+    .frontend = MIC_FRONTEND_CONFIG_DEFAULT(), \
+}
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t frames;
+    uint32_t read_errors;
+    uint32_t clipped;       // samples saturated by the gain stage
+    uint32_t max_block_us;  // converting and publishing one block
+} mic_capture_stats_t;
+
+/**
+ * @brief Start a task that drains the I2S DMA one block at a time, runs it
+ *        through the front end (DC removal, gain, saturation) and stores
+ *        16-bit frames in a ring (PSRAM when available). Calls microphone_init().
+ *
+ * The ring is allocated on the first start and keeps its size afterwards.
+ */
+esp_err_t mic_capture_start(const mic_capture_config_t *config);
+esp_err_t mic_capture_stop(void);
+bool mic_capture_is_running(void);
+uint32_t mic_capture_sample_rate(void);
+void mic_capture_get_stats(mic_capture_stats_t *out);
+
+/**
+ * @brief Change the front-end gain; applies from the next block.
+ * @param gain_q8 256 for unity, up to MIC_FRONTEND_MAX_GAIN_Q8.
+ */
+esp_err_t mic_capture_set_gain(int32_t gain_q8);
+
+/**
+ * A reader keeps its own cursor into the capture ring, so a slow reader
+ * never holds up the capture task or the other readers. A reader that
+ * falls more than a ring behind skips ahead to the oldest intact block and
+ * counts an overrun.
+ */
+typedef struct mic_reader mic_reader_t;
+
+typedef struct {
+    uint32_t frames;    // taken from the ring, before any decimation
+    uint32_t overruns;  // times the reader was lapped
+    uint32_t dropped;   // frames skipped because of overruns
+} mic_reader_stats_t;
+
+/**
+ * @brief Add a reader starting at the newest frame. Up to six readers;
+ *        they are never removed, but one can be handed on with mic_reader_reset().
+ * @param half_rate Decimate 2:1 on the way out (8 kHz from a 16 kHz ring),
+ *        for readers that don't need the full bandwidth.
+ */
+mic_reader_t *mic_reader_create(bool half_rate);
+
+/**
+ * @brief Copy up to max frames, oldest first, waiting up to timeout_ms
+ *        for at least one. A half-rate reader gets about half as many.
+ * @return Frames copied.
+ */
+size_t mic_reader_read(mic_reader_t *reader, int16_t *out, size_t max, uint32_t timeout_ms);
+
+/**
+ * @brief Ring frames waiting for this reader, at most a ring's worth.
+ */
+size_t mic_reader_available(mic_reader_t *reader);
+
+/**
+ * @brief Skip up to frames of the oldest waiting frames, e.g. whole blocks
+ *        a slow network client can't keep up with. They count as dropped.
+ * @return Frames skipped.
+ */
+size_t mic_reader_drop(mic_reader_t *reader, size_t frames);
+
+/**
+ * @brief Move the reader to the newest frame and clear its decimator, for
+ *        reuse by a new owner. Statistics are kept.
+ */
+void mic_reader_reset(mic_reader_t *reader);
+
+void mic_reader_get_stats(mic_reader_t *reader, mic_reader_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,114 @@
+#include "mic_adpcm.h"
+#include <string.h>
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+void mic_adpcm_init(mic_adpcm_t *enc)
+{
+    enc->predictor = 0;
+    enc->index = 0;
+}
+
+// One sample to a 4-bit code, updating the decoder model the same way a
+// decoder will
+static uint8_t encode_sample(mic_adpcm_t *enc, int32_t sample)
+{
+    int32_t step = step_table[enc->index];
+    int32_t diff = sample - enc->predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+
+    int32_t delta = step >> 3;
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    int32_t p = enc->predictor + (code & 8 ? -delta : delta);
+    enc->predictor = p > INT16_MAX ? INT16_MAX : p < INT16_MIN ? INT16_MIN : p;
+    int32_t i = enc->index + index_table[code & 7];
+    enc->index = i < 0 ? 0 : i > 88 ? 88 : i;
+    return code;
+}
+
+void mic_adpcm_encode_block(mic_adpcm_t *enc, const int16_t *in, uint8_t *out)
+{
+    // The header sample is exact, so errors never carry across blocks
+    enc->predictor = in[0];
+    out[0] = (uint8_t)(in[0] & 0xFF);
+    out[1] = (uint8_t)((uint16_t)in[0] >> 8);
+    out[2] = (uint8_t)enc->index;
+    out[3] = 0;
+
+    uint8_t *p = out + 4;
+    for (int i = 1; i < MIC_ADPCM_BLOCK_SAMPLES; i += 2) {
+        uint8_t lo = encode_sample(enc, in[i]);
+        uint8_t hi = encode_sample(enc, in[i + 1]);
+        *p++ = lo | (hi << 4);
+    }
+}
+
+static uint8_t *put_le(uint8_t *p, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) *p++ = (uint8_t)(v >> (8 * i));
+    return p;
+}
+
+size_t mic_wav_header(uint8_t *buf, uint32_t rate_hz, int adpcm)
+{
+    uint8_t *p = buf;
+    memcpy(p, "RIFF", 4);
+    p = put_le(p + 4, 0xFFFFFFFF, 4);
+    memcpy(p, "WAVEfmt ", 8);
+    p += 8;
+
+    if (adpcm) {
+        // Bytes per second as players compute it from whole blocks
+        uint32_t byte_rate = rate_hz * MIC_ADPCM_BLOCK_BYTES / MIC_ADPCM_BLOCK_SAMPLES;
+        p = put_le(p, 20, 4);
+        p = put_le(p, 0x11, 2);                     // IMA ADPCM
+        p = put_le(p, 1, 2);
+        p = put_le(p, rate_hz, 4);
+        p = put_le(p, byte_rate, 4);
+        p = put_le(p, MIC_ADPCM_BLOCK_BYTES, 2);
+        p = put_le(p, 4, 2);
+        p = put_le(p, 2, 2);                        // extra format bytes
+        p = put_le(p, MIC_ADPCM_BLOCK_SAMPLES, 2);
+    } else {
+        p = put_le(p, 16, 4);
+        p = put_le(p, 1, 2);                        // PCM
+        p = put_le(p, 1, 2);
+        p = put_le(p, rate_hz, 4);
+        p = put_le(p, rate_hz * 2, 4);
+        p = put_le(p, 2, 2);
+        p = put_le(p, 16, 2);
+    }
+
+    memcpy(p, "data", 4);
+    p = put_le(p + 4, 0xFFFFFFFF, 4);
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,301 @@
+#include "microphone.h"
+#include "audio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "MIC_CAPTURE";
+
+#define MIC_MAX_READERS         6
+#define CAPTURE_TASK_STACK      3072
+
+/**
+ * One ring shared by every reader. head counts frames ever written and runs
+ * freely; the capture task fills the block at head before publishing it
+ * with release ordering, so the block being written is always the oldest
+ * one in the ring. That leaves size - block frames a reader can trust.
+ */
+struct mic_reader {
+    uint32_t cursor;                // only touched by the reader's owner
+    SemaphoreHandle_t ready;        // given once per published block
+    bool half_rate;
+    mic_decimator_t dec;
+    mic_reader_stats_t stats;
+};
+
+static int16_t *ring = NULL;
+static uint32_t ring_mask = 0;
+static uint32_t block_frames = 0;
+static _Atomic uint32_t head = 0;
+
+static mic_reader_t *readers[MIC_MAX_READERS];
+static _Atomic int reader_count = 0;
+static portMUX_TYPE reader_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static mic_capture_config_t cfg;
+static volatile bool running = false;
+static SemaphoreHandle_t stopped_sem = NULL;
+static _Atomic int32_t pending_gain = -1;  // picked up by the task between blocks
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static mic_capture_stats_t stats;
+
+static uint32_t round_pow2(uint32_t v)
+{
+    uint32_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+static void capture_task(void *arg)
+{
+    int32_t *raw = heap_caps_malloc(block_frames * sizeof(int32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    size_t have = 0;
+    mic_frontend_t fe;
+    mic_frontend_init(&fe, &cfg.frontend);
+
+    while (running && raw) {
+        size_t got = 0;
+        // Short timeout so a stop request is seen even if the clock dies
+        esp_err_t ret = audio_read(raw + have, block_frames - have, &got, 100);
+        if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
+            portENTER_CRITICAL(&stats_mux);
+            stats.read_errors++;
+            portEXIT_CRITICAL(&stats_mux);
+        }
+        have += got;
+        if (have < block_frames) continue;
+        have = 0;
+
+        int32_t gain = atomic_exchange_explicit(&pending_gain, -1, memory_order_relaxed);
+        if (gain >= 0) fe.cfg.gain_q8 = gain;
+
+        int64_t t0 = esp_timer_get_time();
+        uint32_t h = atomic_load_explicit(&head, memory_order_relaxed);
+        // Block-aligned, so a block never wraps
+        uint32_t clipped = mic_frontend_process(&fe, raw, ring + (h & ring_mask), block_frames);
+        atomic_store_explicit(&head, h + block_frames, memory_order_release);
+
+        int n = atomic_load_explicit(&reader_count, memory_order_acquire);
+        for (int i = 0; i < n; i++) {
+            xSemaphoreGive(readers[i]->ready);
+        }
+
+        uint32_t block_us = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&stats_mux);
+        stats.blocks++;
+        stats.frames += block_frames;
+        stats.clipped += clipped;
+        if (block_us > stats.max_block_us) stats.max_block_us = block_us;
+        portEXIT_CRITICAL(&stats_mux);
+    }
+
+    if (!raw) ESP_LOGE(TAG, "No memory for the DMA block");
+    heap_caps_free(raw);
+    running = false;
+    xSemaphoreGive(stopped_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t mic_capture_start(const mic_capture_config_t *config)
+{
+    if (running) return ESP_ERR_INVALID_STATE;
+
+    mic_capture_config_t defaults = MIC_CAPTURE_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.block_frames == 0 || cfg.ring_ms == 0) return ESP_ERR_INVALID_ARG;
+    if (cfg.frontend.gain_q8 < 0 || cfg.frontend.gain_q8 > MIC_FRONTEND_MAX_GAIN_Q8) return ESP_ERR_INVALID_ARG;
+    if (cfg.core < 0 || cfg.core >= portNUM_PROCESSORS || cfg.priority >= configMAX_PRIORITIES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = microphone_init();
+    if (ret != ESP_OK) return ret;
+
+    uint32_t block = round_pow2(cfg.block_frames);
+    uint32_t size = round_pow2((uint64_t)audio_get_sample_rate() * cfg.ring_ms / 1000);
+    if (size < 2 * block) size = 2 * block;
+
+    if (!ring) {
+        ring = heap_caps_calloc(size, sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!ring) ring = heap_caps_calloc(size, sizeof(int16_t), MALLOC_CAP_8BIT);
+        if (!ring) return ESP_ERR_NO_MEM;
+        ring_mask = size - 1;
+        block_frames = block;
+    } else if (size != ring_mask + 1 || block != block_frames) {
+        // Readers hold cursors into the existing ring
+        ESP_LOGE(TAG, "Ring already sized for %lu frames in blocks of %lu",
+                 (unsigned long)(ring_mask + 1), (unsigned long)block_frames);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!stopped_sem) {
+        stopped_sem = xSemaphoreCreateBinary();
+        if (!stopped_sem) return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&stats_mux);
+
+    atomic_store(&pending_gain, -1);
+    running = true;
+    if (xTaskCreatePinnedToCore(capture_task, "mic_capture", CAPTURE_TASK_STACK, NULL, cfg.priority,
+                                NULL, cfg.core) != pdPASS) {
+        running = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Capturing in %lu-frame blocks, %lu-frame ring, core %d, priority %d",
+             (unsigned long)block_frames, (unsigned long)(ring_mask + 1), cfg.core, cfg.priority);
+    return ESP_OK;
+}
+
+esp_err_t mic_capture_stop(void)
+{
+    if (!running) return ESP_ERR_INVALID_STATE;
+
+    running = false;
+    xSemaphoreTake(stopped_sem, portMAX_DELAY);
+    return ESP_OK;
+}
+
+bool mic_capture_is_running(void)
+{
+    return running;
+}
+
+uint32_t mic_capture_sample_rate(void)
+{
+    return audio_get_sample_rate();
+}
+
+void mic_capture_get_stats(mic_capture_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+esp_err_t mic_capture_set_gain(int32_t gain_q8)
+{
+    if (gain_q8 < 0 || gain_q8 > MIC_FRONTEND_MAX_GAIN_Q8) return ESP_ERR_INVALID_ARG;
+    if (!running) return ESP_ERR_INVALID_STATE;
+    atomic_store_explicit(&pending_gain, gain_q8, memory_order_relaxed);
+    return ESP_OK;
+}
+
+mic_reader_t *mic_reader_create(bool half_rate)
+{
+    mic_reader_t *r = heap_caps_calloc(1, sizeof(mic_reader_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!r) return NULL;
+    r->ready = xSemaphoreCreateBinary();
+    if (!r->ready) {
+        heap_caps_free(r);
+        return NULL;
+    }
+    r->half_rate = half_rate;
+    mic_decimator_init(&r->dec);
+    r->cursor = atomic_load_explicit(&head, memory_order_acquire);
+
+    // The slot is filled before the count makes it visible to the capture task
+    portENTER_CRITICAL(&reader_mux);
+    int n = atomic_load_explicit(&reader_count, memory_order_relaxed);
+    if (n == MIC_MAX_READERS) {
+        portEXIT_CRITICAL(&reader_mux);
+        vSemaphoreDelete(r->ready);
+        heap_caps_free(r);
+        return NULL;
+    }
+    readers[n] = r;
+    atomic_store_explicit(&reader_count, n + 1, memory_order_release);
+    portEXIT_CRITICAL(&reader_mux);
+    return r;
+}
+
+// Frames between the cursor and head, after skipping anything the capture
+// task may already be overwriting
+static uint32_t catch_up(mic_reader_t *r, uint32_t h)
+{
+    uint32_t safe = ring_mask + 1 - block_frames;
+    uint32_t avail = h - r->cursor;
+    if (avail > safe) {
+        r->stats.overruns++;
+        r->stats.dropped += avail - safe;
+        r->cursor = h - safe;
+        avail = safe;
+    }
+    return avail;
+}
+
+size_t mic_reader_read(mic_reader_t *r, int16_t *out, size_t max, uint32_t timeout_ms)
+{
+    if (!r || !out || !ring) return 0;
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    for (;;) {
+        uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+        uint32_t avail = catch_up(r, h);
+        size_t n = avail < max ? avail : max;
+
+        if (n > 0) {
+            uint32_t start = r->cursor & ring_mask;
+            size_t first = ring_mask + 1 - start;
+            if (first > n) first = n;
+            memcpy(out, ring + start, first * sizeof(int16_t));
+            memcpy(out + first, ring, (n - first) * sizeof(int16_t));
+
+            // If the capture task lapped us during the copy, part of it is torn
+            uint32_t after = atomic_load_explicit(&head, memory_order_acquire);
+            if (after - r->cursor > ring_mask + 1 - block_frames) {
+                catch_up(r, after);
+                continue;
+            }
+            r->cursor += n;
+            r->stats.frames += n;
+            if (r->half_rate) n = mic_decimate2(&r->dec, out, out, n);
+            // A single odd frame may leave nothing to hand out yet
+            if (n > 0) return n;
+            continue;
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (timeout_ms == 0 || (int32_t)(deadline - now) <= 0) return 0;
+        xSemaphoreTake(r->ready, deadline - now);
+    }
+}
+
+size_t mic_reader_available(mic_reader_t *r)
+{
+    if (!r || !ring) return 0;
+    uint32_t avail = atomic_load_explicit(&head, memory_order_acquire) - r->cursor;
+    uint32_t safe = ring_mask + 1 - block_frames;
+    return avail > safe ? safe : avail;
+}
+
+size_t mic_reader_drop(mic_reader_t *r, size_t frames)
+{
+    if (!r || !ring) return 0;
+    size_t avail = catch_up(r, atomic_load_explicit(&head, memory_order_acquire));
+    size_t n = frames < avail ? frames : avail;
+    if (n == 0) return 0;
+    r->cursor += n;
+    r->stats.dropped += n;
+    return n;
+}
+
+void mic_reader_reset(mic_reader_t *r)
+{
+    mic_decimator_init(&r->dec);
+    r->cursor = atomic_load_explicit(&head, memory_order_acquire);
+}
+
+void mic_reader_get_stats(mic_reader_t *r, mic_reader_stats_t *out)
+{
+    *out = r->stats;
+}
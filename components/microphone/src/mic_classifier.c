@@ -0,0 +1,308 @@
+#include "mic_classifier.h"
+#include "microphone.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "MIC_CLASSIFIER";
+
+#define CLASSIFIER_TASK_STACK   4096
+#define CLASSIFIER_MAX_CBS      4
+
+static mic_classifier_config_t cfg;
+static bool running = false;
+
+// Working state of the task; too big for its stack
+static mic_spectrum_t spectrum;
+static int16_t frame[MIC_FFT_SIZE];
+
+// Templates and the last segment, shared with mic_classifier_set_template/learn
+static SemaphoreHandle_t template_lock = NULL;
+static mic_sound_template_t templates[MIC_CLASSIFIER_MAX_TEMPLATES];
+static int template_count = 0;
+static float last_shape[MIC_MEL_BANDS];
+static bool have_shape = false;
+
+static portMUX_TYPE state_mux = portMUX_INITIALIZER_UNLOCKED;
+static mic_features_t latest;
+static bool have_features = false;
+static mic_class_result_t last_result;
+static mic_classifier_stats_t stats;
+static uint64_t total_cycles = 0;
+
+static struct {
+    mic_features_cb_t cb;
+    void *arg;
+} feature_cbs[CLASSIFIER_MAX_CBS];
+static int feature_cb_count = 0;
+
+static struct {
+    mic_class_cb_t cb;
+    void *arg;
+} class_cbs[CLASSIFIER_MAX_CBS];
+static int class_cb_count = 0;
+
+// Templates can be set up before the task starts
+static bool lock_templates(void)
+{
+    static portMUX_TYPE lock_mux = portMUX_INITIALIZER_UNLOCKED;
+    if (!template_lock) {
+        SemaphoreHandle_t m = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&lock_mux);
+        if (!template_lock) {
+            template_lock = m;
+            m = NULL;
+        }
+        portEXIT_CRITICAL(&lock_mux);
+        if (m) vSemaphoreDelete(m);
+    }
+    return template_lock && xSemaphoreTake(template_lock, portMAX_DELAY) == pdTRUE;
+}
+
+static void classify(const float *mel_sum, uint32_t hops, int64_t onset_us)
+{
+    float mel[MIC_MEL_BANDS];
+    for (int b = 0; b < MIC_MEL_BANDS; b++) mel[b] = mel_sum[b] / hops;
+
+    mic_class_result_t res = {.timestamp_us = onset_us};
+    lock_templates();
+    mic_spectrum_shape(mel, last_shape);
+    have_shape = true;
+    res.match = mic_spectrum_match(templates, template_count, last_shape, &res.distance);
+    snprintf(res.name, sizeof(res.name), "%s", res.match >= 0 ? templates[res.match].name : "unknown");
+    xSemaphoreGive(template_lock);
+
+    portENTER_CRITICAL(&state_mux);
+    last_result = res;
+    if (res.match >= 0) stats.matched++;
+    else stats.unknown++;
+    portEXIT_CRITICAL(&state_mux);
+
+    ESP_LOGI(TAG, "Sound: %s (%.1f dB away)", res.name, res.distance);
+    for (int i = 0; i < class_cb_count; i++) class_cbs[i].cb(&res, class_cbs[i].arg);
+}
+
+static void classifier_task(void *arg)
+{
+    mic_reader_t *reader = (mic_reader_t *)arg;
+    uint32_t rate = mic_capture_sample_rate();
+    // Cycles one core has per hop
+    uint64_t hop_budget = (uint64_t)MIC_HOP * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000 / rate;
+
+    float mel_sum[MIC_MEL_BANDS];
+    uint32_t segment_left = 0;
+    uint32_t segment_hops = 0;
+    int64_t onset_us = 0;
+    size_t have = MIC_FFT_SIZE - MIC_HOP;   // the first window starts half silent
+
+    for (;;) {
+        have += mic_reader_read(reader, frame + have, MIC_FFT_SIZE - have, 1000);
+        if (have < MIC_FFT_SIZE) continue;
+
+        // Time of the newest sample in the window
+        int64_t ts = esp_timer_get_time() - (int64_t)mic_reader_available(reader) * 1000000 / rate;
+
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        mic_features_t f;
+        mic_spectrum_process(&spectrum, frame, &f);
+        uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+
+        // Slide by one hop for the next window
+        memmove(frame, frame + MIC_HOP, (MIC_FFT_SIZE - MIC_HOP) * sizeof(int16_t));
+        have = MIC_FFT_SIZE - MIC_HOP;
+
+        mic_reader_stats_t rs;
+        mic_reader_get_stats(reader, &rs);
+
+        portENTER_CRITICAL(&state_mux);
+        latest = f;
+        have_features = true;
+        stats.hops++;
+        if (f.onset) stats.onsets++;
+        stats.overruns = rs.overruns;
+        total_cycles += cycles;
+        stats.mean_hop_cycles = (uint32_t)(total_cycles / stats.hops);
+        if (cycles > stats.max_hop_cycles) stats.max_hop_cycles = cycles;
+        stats.budget_permille = (uint32_t)(stats.mean_hop_cycles * 1000ULL / hop_budget);
+        portEXIT_CRITICAL(&state_mux);
+
+        for (int i = 0; i < feature_cb_count; i++) feature_cbs[i].cb(&f, ts, feature_cbs[i].arg);
+
+        if (f.onset && segment_left == 0) {
+            // The onset sits in the newer half of the window
+            onset_us = ts - (int64_t)MIC_HOP * 1000000 / rate;
+            segment_left = cfg.segment_hops;
+            segment_hops = 0;
+            memset(mel_sum, 0, sizeof(mel_sum));
+        }
+        if (segment_left) {
+            for (int b = 0; b < MIC_MEL_BANDS; b++) mel_sum[b] += f.mel[b];
+            segment_hops++;
+            if (--segment_left == 0) classify(mel_sum, segment_hops, onset_us);
+        }
+    }
+}
+
+esp_err_t mic_classifier_start(const mic_classifier_config_t *config)
+{
+    if (running) return ESP_ERR_INVALID_STATE;
+
+    mic_classifier_config_t defaults = MIC_CLASSIFIER_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.segment_hops == 0) return ESP_ERR_INVALID_ARG;
+    if (cfg.core < 0 || cfg.core >= portNUM_PROCESSORS || cfg.priority >= configMAX_PRIORITIES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!lock_templates()) return ESP_ERR_NO_MEM;
+    xSemaphoreGive(template_lock);
+
+    if (!mic_capture_is_running()) {
+        esp_err_t ret = mic_capture_start(NULL);
+        if (ret != ESP_OK) return ret;
+    }
+    if (!mic_spectrum_init(&spectrum, mic_capture_sample_rate(), &cfg.spectrum)) {
+        ESP_LOGE(TAG, "FFT setup failed");
+        return ESP_FAIL;
+    }
+    memset(frame, 0, sizeof(frame));
+
+    mic_reader_t *reader = mic_reader_create(false);
+    if (!reader) return ESP_ERR_NO_MEM;
+
+    running = true;
+    if (xTaskCreatePinnedToCore(classifier_task, "mic_classifier", CLASSIFIER_TASK_STACK, reader, cfg.priority,
+                                NULL, cfg.core) != pdPASS) {
+        running = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%d-point FFT every %d samples, %d mel bands", MIC_FFT_SIZE, MIC_HOP, MIC_MEL_BANDS);
+    return ESP_OK;
+}
+
+esp_err_t mic_classifier_set_template(const mic_sound_template_t *tmpl)
+{
+    if (!tmpl || !tmpl->name[0]) return ESP_ERR_INVALID_ARG;
+    if (!lock_templates()) return ESP_ERR_NO_MEM;
+
+    esp_err_t ret = ESP_OK;
+    int slot = 0;
+    while (slot < template_count && strncmp(templates[slot].name, tmpl->name, sizeof(tmpl->name)) != 0) slot++;
+    if (slot == MIC_CLASSIFIER_MAX_TEMPLATES) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        templates[slot] = *tmpl;
+        templates[slot].name[sizeof(templates[slot].name) - 1] = '\0';
+        if (slot == template_count) template_count++;
+    }
+    xSemaphoreGive(template_lock);
+    return ret;
+}
+
+esp_err_t mic_classifier_learn(const char *name, float max_distance)
+{
+    if (!name || !name[0] || max_distance <= 0.0f) return ESP_ERR_INVALID_ARG;
+    if (!lock_templates()) return ESP_ERR_NO_MEM;
+
+    mic_sound_template_t t = {.max_distance = max_distance};
+    snprintf(t.name, sizeof(t.name), "%s", name);
+    bool ok = have_shape;
+    memcpy(t.shape, last_shape, sizeof(t.shape));
+    xSemaphoreGive(template_lock);
+    if (!ok) return ESP_ERR_INVALID_STATE;
+
+    return mic_classifier_set_template(&t);
+}
+
+esp_err_t mic_classifier_register_features_cb(mic_features_cb_t cb, void *arg)
+{
+    if (!cb) return ESP_ERR_INVALID_ARG;
+    if (feature_cb_count >= CLASSIFIER_MAX_CBS) return ESP_ERR_NO_MEM;
+    feature_cbs[feature_cb_count].cb = cb;
+    feature_cbs[feature_cb_count].arg = arg;
+    feature_cb_count++;
+    return ESP_OK;
+}
+
+esp_err_t mic_classifier_register_cb(mic_class_cb_t cb, void *arg)
+{
+    if (!cb) return ESP_ERR_INVALID_ARG;
+    if (class_cb_count >= CLASSIFIER_MAX_CBS) return ESP_ERR_NO_MEM;
+    class_cbs[class_cb_count].cb = cb;
+    class_cbs[class_cb_count].arg = arg;
+    class_cb_count++;
+    return ESP_OK;
+}
+
+esp_err_t mic_classifier_get_features(mic_features_t *out)
+{
+    portENTER_CRITICAL(&state_mux);
+    bool ok = have_features;
+    *out = latest;
+    portEXIT_CRITICAL(&state_mux);
+    return ok ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+void mic_classifier_get_stats(mic_classifier_stats_t *out)
+{
+    portENTER_CRITICAL(&state_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&state_mux);
+}
+
+// GET /api/audio/features -> {mel:[...], flux, onsets, matched, unknown, hop_cycles, max_hop_cycles,
+//                             budget_pct, last:{name, distance, timestamp_ms}}
+static esp_err_t h_features(httpd_req_t *req)
+{
+    mic_features_t f;
+    if (mic_classifier_get_features(&f) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "audio classifier not running");
+    }
+
+    portENTER_CRITICAL(&state_mux);
+    mic_class_result_t res = last_result;
+    mic_classifier_stats_t st = stats;
+    portEXIT_CRITICAL(&state_mux);
+
+    cJSON *o = cJSON_CreateObject();
+    cJSON *mel = cJSON_AddArrayToObject(o, "mel");
+    for (int b = 0; b < MIC_MEL_BANDS; b++) {
+        // A tenth of a dB is plenty and keeps the response short
+        cJSON_AddItemToArray(mel, cJSON_CreateNumber((int)(f.mel[b] * 10.0f) / 10.0));
+    }
+    cJSON_AddNumberToObject(o, "flux", f.flux);
+    cJSON_AddNumberToObject(o, "onsets", st.onsets);
+    cJSON_AddNumberToObject(o, "matched", st.matched);
+    cJSON_AddNumberToObject(o, "unknown", st.unknown);
+    cJSON_AddNumberToObject(o, "hop_cycles", st.mean_hop_cycles);
+    cJSON_AddNumberToObject(o, "max_hop_cycles", st.max_hop_cycles);
+    cJSON_AddNumberToObject(o, "budget_pct", st.budget_permille / 10.0);
+    if (st.matched + st.unknown) {
+        cJSON *l = cJSON_AddObjectToObject(o, "last");
+        cJSON_AddStringToObject(l, "name", res.name);
+        cJSON_AddNumberToObject(l, "distance", res.distance);
+        cJSON_AddNumberToObject(l, "timestamp_ms", res.timestamp_us / 1000);
+    }
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+esp_err_t mic_classifier_register_handlers(httpd_handle_t server)
+{
+    const httpd_uri_t uri = {.uri = "/api/audio/features", .method = HTTP_GET, .handler = h_features};
+    return httpd_register_uri_handler(server, &uri);
+}
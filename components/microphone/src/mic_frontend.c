@@ -0,0 +1,82 @@
+#include "mic_frontend.h"
+#include <string.h>
+
+// Sums of raw >> 14 (18 bits) over this many samples stay inside 31 bits
+#define FOLD_EVERY 4096
+
+static inline int32_t sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+void mic_frontend_init(mic_frontend_t *fe, const mic_frontend_config_t *cfg)
+{
+    mic_frontend_config_t defaults = MIC_FRONTEND_CONFIG_DEFAULT();
+    fe->cfg = cfg ? *cfg : defaults;
+    if (fe->cfg.gain_q8 < 0) fe->cfg.gain_q8 = 0;
+    if (fe->cfg.gain_q8 > MIC_FRONTEND_MAX_GAIN_Q8) fe->cfg.gain_q8 = MIC_FRONTEND_MAX_GAIN_Q8;
+    fe->dc_q8 = 0;
+}
+
+uint32_t mic_frontend_process(mic_frontend_t *fe, const int32_t *raw, int16_t *out, size_t n)
+{
+    // raw >> 14 is 18 bits; times a gain of at most 2^12 stays inside 31
+    const int32_t gain = fe->cfg.gain_q8;
+    const int32_t dc = fe->cfg.dc_shift ? fe->dc_q8 >> 8 : 0;
+    int64_t sum = 0;
+    uint32_t clipped = 0;
+
+    // One branch-free pass. The S3's PIE SIMD isn't reachable from C and
+    // 8-lane GCC vector types measured slower than this on the host, so it
+    // stays scalar; the saturation compiles to min/max
+    for (size_t base = 0; base < n; base += FOLD_EVERY) {
+        size_t end = n - base < FOLD_EVERY ? n : base + FOLD_EVERY;
+        int32_t part = 0;
+        uint32_t clips = 0;
+        for (size_t i = base; i < end; i++) {
+            int32_t s = raw[i] >> 14;
+            int32_t y = ((s - dc) * gain) >> 8;
+            int32_t c = sat16(y);
+            part += s;
+            clips += c != y;
+            out[i] = (int16_t)c;
+        }
+        sum += part;
+        clipped += clips;
+    }
+
+    if (fe->cfg.dc_shift && n > 0) {
+        int32_t mean_q8 = (int32_t)((sum * 256) / (int64_t)n);
+        fe->dc_q8 += (mean_q8 - fe->dc_q8) >> fe->cfg.dc_shift;
+    }
+    return clipped;
+}
+
+void mic_decimator_init(mic_decimator_t *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+}
+
+// Half-band taps -1 0 9 16 9 0 -1, over 32. Every other tap is zero, so
+// each output costs four multiplies.
+static inline int16_t halfband(const int16_t x[7])
+{
+    int32_t acc = 16 * x[3] + 9 * (x[2] + x[4]) - (x[0] + x[6]);
+    return (int16_t)sat16((acc + 16) >> 5);
+}
+
+size_t mic_decimate2(mic_decimator_t *dec, const int16_t *in, int16_t *out, size_t n)
+{
+    int16_t win[7];
+    size_t produced = 0;
+
+    memcpy(win, dec->hist, sizeof(dec->hist));
+    for (size_t i = 0; i < n; i++) {
+        win[6] = in[i];
+        if (dec->phase) out[produced++] = halfband(win);
+        dec->phase ^= 1;
+        memmove(win, win + 1, 6 * sizeof(int16_t));
+    }
+    memcpy(dec->hist, win, sizeof(dec->hist));
+    return produced;
+}
@@ -0,0 +1,89 @@
+#include "mic_level.h"
+#include <math.h>
+
+static float to_dbfs(float v)
+{
+    if (v < 1.0f) return MIC_LEVEL_FLOOR_DBFS;
+    float db = 20.0f * log10f(v / 32768.0f);
+    return db < MIC_LEVEL_FLOOR_DBFS ? MIC_LEVEL_FLOOR_DBFS : db;
+}
+
+void mic_level_measure(const int16_t *x, size_t n, mic_level_t *out)
+{
+    uint64_t energy = 0;
+    int32_t peak = 0;
+    uint32_t crossings = 0;
+    int16_t prev = n ? x[0] : 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t s = x[i];
+        int32_t a = s < 0 ? -s : s;
+        energy += (uint32_t)(s * s);
+        peak = a > peak ? a : peak;
+        crossings += (s ^ prev) < 0;
+        prev = (int16_t)s;
+    }
+
+    float rms = n ? sqrtf((float)energy / (float)n) : 0.0f;
+    out->rms = (uint16_t)rms;
+    out->peak = (uint16_t)(peak > UINT16_MAX ? UINT16_MAX : peak);
+    out->rms_dbfs = to_dbfs(rms);
+    out->peak_dbfs = to_dbfs((float)peak);
+    out->crossings = crossings;
+}
+
+void mic_vad_init(mic_vad_t *vad, const mic_vad_config_t *cfg)
+{
+    mic_vad_config_t defaults = MIC_VAD_CONFIG_DEFAULT();
+    vad->cfg = cfg ? *cfg : defaults;
+    if (vad->cfg.floor_window_ms < MIC_VAD_FLOOR_SUBWINDOWS) vad->cfg.floor_window_ms = MIC_VAD_FLOOR_SUBWINDOWS;
+    // Start high so the first quiet blocks pull it down to the real floor;
+    // a room louder than min_dbfs takes over once the window has turned
+    for (int i = 0; i < MIC_VAD_FLOOR_SUBWINDOWS; i++) vad->sub_min[i] = vad->cfg.min_dbfs;
+    vad->cur_min = vad->cfg.min_dbfs;
+    vad->sub_ms = 0;
+    vad->sub_next = 0;
+    vad->noise_dbfs = vad->cfg.min_dbfs;
+    vad->active = false;
+    vad->run_ms = 0;
+}
+
+mic_vad_event_t mic_vad_update(mic_vad_t *vad, const mic_level_t *level, uint32_t block_ms, uint32_t rate_hz)
+{
+    uint32_t samples = block_ms * rate_hz / 1000;
+    uint32_t zcr_hz = samples ? level->crossings * rate_hz / samples : 0;
+
+    float threshold = vad->noise_dbfs + vad->cfg.margin_db;
+    if (threshold < vad->cfg.min_dbfs) threshold = vad->cfg.min_dbfs;
+    bool loud = level->rms_dbfs > threshold && zcr_hz <= vad->cfg.zcr_max_hz;
+
+    // Minimum statistics: every block counts, so the floor can rise under
+    // a loud noise that doesn't go away, but only once the window has
+    // slid past everything quieter
+    if (level->rms_dbfs < vad->cur_min) vad->cur_min = level->rms_dbfs;
+    vad->sub_ms += block_ms;
+    float floor = vad->cur_min;
+    if (vad->sub_ms >= vad->cfg.floor_window_ms / MIC_VAD_FLOOR_SUBWINDOWS) {
+        vad->sub_min[vad->sub_next] = vad->cur_min;
+        vad->sub_next = (vad->sub_next + 1) % MIC_VAD_FLOOR_SUBWINDOWS;
+        vad->cur_min = 0.0f;
+        vad->sub_ms = 0;
+    }
+    for (int i = 0; i < MIC_VAD_FLOOR_SUBWINDOWS; i++) {
+        if (vad->sub_min[i] < floor) floor = vad->sub_min[i];
+    }
+    vad->noise_dbfs = floor;
+
+    // run_ms counts how long the block state has disagreed with active
+    if (loud == vad->active) {
+        vad->run_ms = 0;
+        return MIC_VAD_NONE;
+    }
+    vad->run_ms += block_ms;
+    uint32_t needed = vad->active ? vad->cfg.hangover_ms : vad->cfg.attack_ms;
+    if (vad->run_ms < needed) return MIC_VAD_NONE;
+
+    vad->active = loud;
+    vad->run_ms = 0;
+    return loud ? MIC_VAD_START : MIC_VAD_STOP;
+}
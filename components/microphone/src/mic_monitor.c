@@ -0,0 +1,207 @@
+#include "mic_monitor.h"
+#include "microphone.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "MIC_MONITOR";
+
+#define MONITOR_TASK_STACK  3072
+#define MONITOR_MAX_CBS     4
+
+static mic_monitor_config_t cfg;
+static bool running = false;
+
+static portMUX_TYPE state_mux = portMUX_INITIALIZER_UNLOCKED;
+static mic_monitor_level_t latest;
+static bool have_level = false;
+static mic_sound_event_t last_event;
+static mic_monitor_stats_t stats;
+static uint64_t busy_cycles = 0;
+
+static struct {
+    mic_sound_cb_t cb;
+    void *arg;
+} callbacks[MONITOR_MAX_CBS];
+static int callback_count = 0;
+
+static void emit(mic_sound_event_type_t type, float rms_dbfs, int64_t ts, uint32_t duration_ms)
+{
+    mic_sound_event_t ev = {.type = type, .rms_dbfs = rms_dbfs, .timestamp_us = ts, .duration_ms = duration_ms};
+
+    portENTER_CRITICAL(&state_mux);
+    last_event = ev;
+    if (type == MIC_SOUND_START) stats.events++;
+    portEXIT_CRITICAL(&state_mux);
+
+    ESP_LOGI(TAG, "Sound %s at %.1f dBFS", type == MIC_SOUND_START ? "start" : "stop", rms_dbfs);
+    for (int i = 0; i < callback_count; i++) callbacks[i].cb(&ev, callbacks[i].arg);
+}
+
+static void monitor_task(void *arg)
+{
+    mic_reader_t *reader = (mic_reader_t *)arg;
+    uint32_t rate = mic_capture_sample_rate();
+    size_t block = rate * cfg.block_ms / 1000;
+    int16_t *buf = heap_caps_malloc(block * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!buf) {
+        ESP_LOGE(TAG, "No memory for a %u-frame block", (unsigned)block);
+        running = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    mic_vad_t vad;
+    mic_vad_init(&vad, &cfg.vad);
+    int64_t onset_us = 0;
+    size_t have = 0;
+
+    for (;;) {
+        have += mic_reader_read(reader, buf + have, block - have, 1000);
+        if (have < block) continue;
+        have = 0;
+
+        // The reader is behind the capture head by whatever is still queued
+        int64_t ts = esp_timer_get_time() - (int64_t)mic_reader_available(reader) * 1000000 / rate;
+
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        mic_level_t level;
+        mic_level_measure(buf, block, &level);
+        mic_vad_event_t ev = mic_vad_update(&vad, &level, cfg.block_ms, rate);
+        uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+
+        mic_reader_stats_t rs;
+        mic_reader_get_stats(reader, &rs);
+
+        portENTER_CRITICAL(&state_mux);
+        latest.level = level;
+        latest.noise_dbfs = vad.noise_dbfs;
+        latest.active = vad.active;
+        latest.timestamp_us = ts;
+        have_level = true;
+        stats.blocks++;
+        stats.overruns = rs.overruns;
+        if (cycles > stats.max_block_cycles) stats.max_block_cycles = cycles;
+        busy_cycles += cycles;
+        // Cycles one core has in the audio covered so far
+        uint64_t budget = (uint64_t)stats.blocks * cfg.block_ms * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000;
+        stats.load_permille = budget ? (uint32_t)(busy_cycles * 1000 / budget) : 0;
+        portEXIT_CRITICAL(&state_mux);
+
+        // Both transitions are confirmed late by design; date them back
+        if (ev == MIC_VAD_START) {
+            onset_us = ts - (int64_t)cfg.vad.attack_ms * 1000;
+            emit(MIC_SOUND_START, level.rms_dbfs, onset_us, 0);
+        } else if (ev == MIC_VAD_STOP) {
+            int64_t end_us = ts - (int64_t)cfg.vad.hangover_ms * 1000;
+            emit(MIC_SOUND_STOP, level.rms_dbfs, end_us, (uint32_t)((end_us - onset_us) / 1000));
+        }
+    }
+}
+
+esp_err_t mic_monitor_start(const mic_monitor_config_t *config)
+{
+    if (running) return ESP_ERR_INVALID_STATE;
+
+    mic_monitor_config_t defaults = MIC_MONITOR_CONFIG_DEFAULT();
+    cfg = config ? *config : defaults;
+    if (cfg.block_ms == 0) return ESP_ERR_INVALID_ARG;
+    if (cfg.core < 0 || cfg.core >= portNUM_PROCESSORS || cfg.priority >= configMAX_PRIORITIES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!mic_capture_is_running()) {
+        esp_err_t ret = mic_capture_start(NULL);
+        if (ret != ESP_OK) return ret;
+    }
+
+    mic_reader_t *reader = mic_reader_create(false);
+    if (!reader) return ESP_ERR_NO_MEM;
+
+    running = true;
+    if (xTaskCreatePinnedToCore(monitor_task, "mic_monitor", MONITOR_TASK_STACK, reader, cfg.priority,
+                                NULL, cfg.core) != pdPASS) {
+        running = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Monitoring in %u ms blocks, core %d, priority %d", cfg.block_ms, cfg.core, cfg.priority);
+    return ESP_OK;
+}
+
+esp_err_t mic_monitor_get_level(mic_monitor_level_t *out)
+{
+    portENTER_CRITICAL(&state_mux);
+    bool ok = have_level;
+    *out = latest;
+    portEXIT_CRITICAL(&state_mux);
+    return ok ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+void mic_monitor_get_stats(mic_monitor_stats_t *out)
+{
+    portENTER_CRITICAL(&state_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&state_mux);
+}
+
+esp_err_t mic_monitor_register_cb(mic_sound_cb_t cb, void *arg)
+{
+    if (!cb) return ESP_ERR_INVALID_ARG;
+    if (callback_count >= MONITOR_MAX_CBS) return ESP_ERR_NO_MEM;
+    callbacks[callback_count].cb = cb;
+    callbacks[callback_count].arg = arg;
+    callback_count++;
+    return ESP_OK;
+}
+
+// GET /api/audio/level -> {rms_dbfs, peak_dbfs, rms, peak, noise_dbfs, active, events, load_pct,
+//                          last:{type, timestamp_ms, duration_ms}}
+static esp_err_t h_level(httpd_req_t *req)
+{
+    mic_monitor_level_t lv;
+    if (mic_monitor_get_level(&lv) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "audio monitor not running");
+    }
+
+    portENTER_CRITICAL(&state_mux);
+    mic_sound_event_t ev = last_event;
+    mic_monitor_stats_t st = stats;
+    portEXIT_CRITICAL(&state_mux);
+
+    cJSON *o = cJSON_CreateObject();
+    cJSON_AddNumberToObject(o, "rms_dbfs", lv.level.rms_dbfs);
+    cJSON_AddNumberToObject(o, "peak_dbfs", lv.level.peak_dbfs);
+    cJSON_AddNumberToObject(o, "rms", lv.level.rms);
+    cJSON_AddNumberToObject(o, "peak", lv.level.peak);
+    cJSON_AddNumberToObject(o, "noise_dbfs", lv.noise_dbfs);
+    cJSON_AddBoolToObject(o, "active", lv.active);
+    cJSON_AddNumberToObject(o, "events", st.events);
+    cJSON_AddNumberToObject(o, "load_pct", st.load_permille / 10.0);
+    if (st.events) {
+        cJSON *l = cJSON_AddObjectToObject(o, "last");
+        cJSON_AddStringToObject(l, "type", ev.type == MIC_SOUND_START ? "start" : "stop");
+        cJSON_AddNumberToObject(l, "timestamp_ms", ev.timestamp_us / 1000);
+        cJSON_AddNumberToObject(l, "duration_ms", ev.duration_ms);
+    }
+    char *out = cJSON_PrintUnformatted(o);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, out);
+    cJSON_Delete(o);
+    free(out);
+    return ESP_OK;
+}
+
+esp_err_t mic_monitor_register_handlers(httpd_handle_t server)
+{
+    const httpd_uri_t uri = {.uri = "/api/audio/level", .method = HTTP_GET, .handler = h_level};
+    return httpd_register_uri_handler(server, &uri);
+}
@@ -0,0 +1,204 @@
+#include "mic_spectrum.h"
+#include <math.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "dsps_fft2r.h"
+#include "dsp_err_codes.h"
+#endif
+
+#define MEL_FMIN_HZ     100.0f
+#define NO_SEGMENT      0xFF
+#define FLUX_MEAN_ALPHA 0.05f
+#define DB_EPSILON      1e-10f
+#define SHAPE_RANGE_DB  40.0f   // bands further below the loudest are all alike
+
+static const float two_pi = 6.28318530718f;
+
+static float hz_to_mel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float mel_to_hz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+#ifdef ESP_PLATFORM
+static bool fft_init(void)
+{
+    // The table is global to esp-dsp; someone else may have set it up
+    esp_err_t ret = dsps_fft2r_init_fc32(NULL, MIC_FFT_SIZE);
+    return ret == ESP_OK || ret == ESP_ERR_DSP_REINITIALIZED;
+}
+
+static void fft(float *data)
+{
+    dsps_fft2r_fc32(data, MIC_FFT_SIZE);
+    dsps_bit_rev_fc32(data, MIC_FFT_SIZE);
+}
+#else
+static bool fft_init(void)
+{
+    return true;
+}
+
+// Iterative radix-2, in place on interleaved re/im
+static void fft(float *data)
+{
+    const int n = MIC_FFT_SIZE;
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            float tr = data[2 * i], ti = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = tr;
+            data[2 * j + 1] = ti;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        float ang = -two_pi / len;
+        float wr = cosf(ang), wi = sinf(ang);
+        for (int i = 0; i < n; i += len) {
+            float cr = 1.0f, ci = 0.0f;
+            for (int k = 0; k < len / 2; k++) {
+                float *a = data + 2 * (i + k);
+                float *b = data + 2 * (i + k + len / 2);
+                float br = b[0] * cr - b[1] * ci;
+                float bi = b[0] * ci + b[1] * cr;
+                b[0] = a[0] - br;
+                b[1] = a[1] - bi;
+                a[0] += br;
+                a[1] += bi;
+                float t = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = t;
+            }
+        }
+    }
+}
+#endif
+
+bool mic_spectrum_init(mic_spectrum_t *sp, uint32_t rate_hz, const mic_spectrum_config_t *cfg)
+{
+    mic_spectrum_config_t defaults = MIC_SPECTRUM_CONFIG_DEFAULT();
+    memset(sp, 0, sizeof(*sp));
+    sp->cfg = cfg ? *cfg : defaults;
+    if (!fft_init()) return false;
+
+    for (int i = 0; i < MIC_FFT_SIZE; i++) {
+        sp->window[i] = 0.5f - 0.5f * cosf(two_pi * i / MIC_FFT_SIZE);
+    }
+
+    // MIC_MEL_BANDS + 2 edges evenly spaced in mel, in units of FFT bins
+    float edges[MIC_MEL_BANDS + 2];
+    float mel_lo = hz_to_mel(MEL_FMIN_HZ);
+    float mel_hi = hz_to_mel(rate_hz * 0.475f);
+    float bin_hz = (float)rate_hz / MIC_FFT_SIZE;
+    for (int e = 0; e < MIC_MEL_BANDS + 2; e++) {
+        float mel = mel_lo + (mel_hi - mel_lo) * e / (MIC_MEL_BANDS + 1);
+        edges[e] = mel_to_hz(mel) / bin_hz;
+    }
+
+    for (int k = 0; k <= MIC_FFT_SIZE / 2; k++) {
+        sp->bin_seg[k] = NO_SEGMENT;
+        for (int e = 0; e < MIC_MEL_BANDS + 1; e++) {
+            if (k >= edges[e] && k < edges[e + 1]) {
+                sp->bin_seg[k] = (uint8_t)e;
+                sp->bin_frac[k] = (k - edges[e]) / (edges[e + 1] - edges[e]);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void mic_spectrum_process(mic_spectrum_t *sp, const int16_t *frame, mic_features_t *out)
+{
+    // Scaled so a full-scale sine peaks at 1 after the Hann window's 1/2 gain
+    const float scale = 2.0f / (32768.0f * MIC_FFT_SIZE / 2);
+    for (int i = 0; i < MIC_FFT_SIZE; i++) {
+        sp->fft[2 * i] = frame[i] * sp->window[i] * scale;
+        sp->fft[2 * i + 1] = 0.0f;
+    }
+    fft(sp->fft);
+
+    // Segment e rises into band e and falls out of band e - 1
+    float energy[MIC_MEL_BANDS] = {0};
+    for (int k = 0; k <= MIC_FFT_SIZE / 2; k++) {
+        uint8_t e = sp->bin_seg[k];
+        if (e == NO_SEGMENT) continue;
+        float p = sp->fft[2 * k] * sp->fft[2 * k] + sp->fft[2 * k + 1] * sp->fft[2 * k + 1];
+        float f = sp->bin_frac[k];
+        if (e < MIC_MEL_BANDS) energy[e] += p * f;
+        if (e > 0) energy[e - 1] += p * (1.0f - f);
+    }
+
+    float flux = 0.0f;
+    for (int b = 0; b < MIC_MEL_BANDS; b++) {
+        float db = 10.0f * log10f(energy[b] + DB_EPSILON);
+        float rise = db - sp->prev_mel[b];
+        if (rise > 0.0f) flux += rise;
+        sp->prev_mel[b] = db;
+        out->mel[b] = db;
+    }
+    flux /= MIC_MEL_BANDS;
+
+    // The first frame has nothing to compare against
+    if (!sp->primed) {
+        sp->primed = true;
+        flux = 0.0f;
+    }
+    out->flux = flux;
+
+    float threshold = sp->flux_mean * sp->cfg.onset_ratio;
+    if (threshold < sp->cfg.onset_min_db) threshold = sp->cfg.onset_min_db;
+    sp->since_onset++;
+    out->onset = flux > threshold && sp->since_onset > sp->cfg.refractory;
+    if (out->onset) sp->since_onset = 0;
+    sp->flux_mean += (flux - sp->flux_mean) * FLUX_MEAN_ALPHA;
+}
+
+void mic_spectrum_shape(const float mel[MIC_MEL_BANDS], float shape[MIC_MEL_BANDS])
+{
+    // Quiet bands are mostly room noise, which changes with distance; cap
+    // how far below the peak they can sit before taking the mean out
+    float peak = mel[0];
+    for (int b = 1; b < MIC_MEL_BANDS; b++) peak = mel[b] > peak ? mel[b] : peak;
+
+    float mean = 0.0f;
+    for (int b = 0; b < MIC_MEL_BANDS; b++) {
+        float v = mel[b] - peak;
+        shape[b] = v < -SHAPE_RANGE_DB ? -SHAPE_RANGE_DB : v;
+        mean += shape[b];
+    }
+    mean /= MIC_MEL_BANDS;
+    for (int b = 0; b < MIC_MEL_BANDS; b++) shape[b] -= mean;
+}
+
+int mic_spectrum_match(const mic_sound_template_t *templates, size_t n, const float shape[MIC_MEL_BANDS],
+                       float *distance)
+{
+    int best = -1;
+    float best_d = INFINITY;
+    float nearest_d = INFINITY;
+
+    for (size_t t = 0; t < n; t++) {
+        float sum = 0.0f;
+        for (int b = 0; b < MIC_MEL_BANDS; b++) {
+            float d = shape[b] - templates[t].shape[b];
+            sum += d * d;
+        }
+        float d = sqrtf(sum / MIC_MEL_BANDS);
+        if (d < nearest_d) nearest_d = d;
+        if (d <= templates[t].max_distance && d < best_d) {
+            best_d = d;
+            best = (int)t;
+        }
+    }
+    if (distance) *distance = best >= 0 ? best_d : nearest_d;
+    return best;
+}
@@ -0,0 +1,256 @@
+#include "mic_stream.h"
+#include "microphone.h"
+#include "mic_adpcm.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "MIC_STREAM";
+
+// Same standing as the camera stream workers: below httpd, above idle work
+#define STREAM_TASK_STACK   4096
+#define STREAM_TASK_PRIO    4
+
+// Both formats go out in ADPCM-sized blocks of about 32 ms, so dropping
+// and latency behave the same
+#define STREAM_BLOCK        MIC_ADPCM_BLOCK_SAMPLES
+
+// Backlog a client may build up before whole blocks are skipped; with one
+// block being sent this keeps capture-to-socket under about 160 ms
+#define STREAM_MAX_BACKLOG_MS 120
+
+#define STREAM_READ_TIMEOUT_MS 1000
+
+typedef struct {
+    httpd_req_t *req;
+    bool adpcm;
+    int slot;
+} stream_job_t;
+
+static SemaphoreHandle_t stream_slots = NULL;
+static portMUX_TYPE slot_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool slot_busy[MIC_STREAM_MAX_CLIENTS];
+// Readers can't be removed, so each slot keeps its own for the next client
+static mic_reader_t *slot_reader[MIC_STREAM_MAX_CLIENTS];
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static mic_stream_stats_t stats;
+static uint64_t latency_sum_ms = 0;
+
+static void record_block(uint32_t send_us, uint32_t latency_ms, uint32_t dropped)
+{
+    portENTER_CRITICAL(&stats_mux);
+    stats.blocks++;
+    stats.dropped_blocks += dropped;
+    if (send_us > stats.max_send_us) stats.max_send_us = send_us;
+    latency_sum_ms += latency_ms;
+    stats.mean_latency_ms = (uint32_t)(latency_sum_ms / stats.blocks);
+    if (latency_ms > stats.max_latency_ms) stats.max_latency_ms = latency_ms;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+static bool read_block(mic_reader_t *reader, int16_t *block)
+{
+    size_t have = 0;
+    while (have < STREAM_BLOCK) {
+        size_t n = mic_reader_read(reader, block + have, STREAM_BLOCK - have, STREAM_READ_TIMEOUT_MS);
+        if (n == 0 && !mic_capture_is_running()) return false;
+        have += n;
+    }
+    return true;
+}
+
+/**
+ * Encodes and sends one block at a time from the capture ring until the
+ * client goes away. Capture never waits on the network: while a send is
+ * stuck the ring keeps filling, and the backlog is then cut back in whole
+ * blocks so the decoder never sees a partial one.
+ */
+static esp_err_t stream_audio(httpd_req_t *req, mic_reader_t *reader, bool adpcm)
+{
+    uint32_t rate = mic_capture_sample_rate();
+    size_t max_backlog = rate * STREAM_MAX_BACKLOG_MS / 1000;
+
+    int fd = httpd_req_to_sockfd(req);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    uint8_t head[64];
+    size_t hlen = mic_wav_header(head, rate, adpcm);
+    httpd_resp_set_type(req, "audio/wav");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    esp_err_t res = httpd_resp_send_chunk(req, (const char *)head, hlen);
+    bool client_gone = res != ESP_OK;
+
+    int16_t *pcm = malloc(STREAM_BLOCK * sizeof(int16_t));
+    uint8_t *enc = adpcm ? malloc(MIC_ADPCM_BLOCK_BYTES) : NULL;
+    if (!pcm || (adpcm && !enc)) res = ESP_ERR_NO_MEM;
+
+    mic_adpcm_t state;
+    mic_adpcm_init(&state);
+    mic_reader_reset(reader);
+
+    while (res == ESP_OK) {
+        uint32_t dropped = 0;
+        size_t backlog = mic_reader_available(reader);
+        if (backlog > max_backlog) {
+            dropped = (backlog - max_backlog + STREAM_BLOCK - 1) / STREAM_BLOCK;
+            mic_reader_drop(reader, dropped * STREAM_BLOCK);
+        }
+
+        if (!read_block(reader, pcm)) {
+            ESP_LOGE(TAG, "Capture stopped");
+            res = ESP_FAIL;
+            break;
+        }
+        // Age of the block's oldest sample: the block itself plus what queued behind it
+        uint32_t latency_ms = (STREAM_BLOCK + mic_reader_available(reader)) * 1000 / rate;
+
+        int64_t t0 = esp_timer_get_time();
+        if (adpcm) {
+            mic_adpcm_encode_block(&state, pcm, enc);
+            res = httpd_resp_send_chunk(req, (const char *)enc, MIC_ADPCM_BLOCK_BYTES);
+        } else {
+            // The S3 is little-endian, as WAV wants
+            res = httpd_resp_send_chunk(req, (const char *)pcm, STREAM_BLOCK * sizeof(int16_t));
+        }
+        uint32_t send_us = esp_timer_get_time() - t0;
+        client_gone = res != ESP_OK;
+        if (res == ESP_OK) record_block(send_us, latency_ms, dropped);
+    }
+    // Stopped on our side: end the chunked body before httpd gets the
+    // connection back
+    if (!client_gone) httpd_resp_send_chunk(req, NULL, 0);
+
+    free(pcm);
+    free(enc);
+    return res;
+}
+
+static int claim_slot(void)
+{
+    int slot = -1;
+    portENTER_CRITICAL(&slot_mux);
+    for (int i = 0; i < MIC_STREAM_MAX_CLIENTS && slot < 0; i++) {
+        if (!slot_busy[i]) {
+            slot_busy[i] = true;
+            slot = i;
+        }
+    }
+    portEXIT_CRITICAL(&slot_mux);
+    return slot;
+}
+
+static void release_slot(int slot)
+{
+    portENTER_CRITICAL(&slot_mux);
+    slot_busy[slot] = false;
+    portEXIT_CRITICAL(&slot_mux);
+    xSemaphoreGive(stream_slots);
+}
+
+static void stream_worker(void *arg)
+{
+    stream_job_t *job = (stream_job_t *)arg;
+    httpd_req_t *req = job->req;
+
+    ESP_LOGI(TAG, "Client on fd %d, %s", httpd_req_to_sockfd(req), job->adpcm ? "IMA-ADPCM" : "PCM");
+    stream_audio(req, slot_reader[job->slot], job->adpcm);
+    httpd_req_async_handler_complete(req);
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.clients--;
+    portEXIT_CRITICAL(&stats_mux);
+    release_slot(job->slot);
+    free(job);
+    vTaskDelete(NULL);
+}
+
+/**
+ * GET /api/audio/stream[?format=wav|adpcm]
+ * Detaches the request onto a worker task, as /stream does for video.
+ */
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    bool adpcm = false;
+    char q[32], val[16];
+    if (httpd_req_get_url_query_str(req, q, sizeof(q)) == ESP_OK &&
+        httpd_query_key_value(q, "format", val, sizeof(val)) == ESP_OK &&
+        strcmp(val, "adpcm") == 0) {
+        adpcm = true;
+    }
+
+    if (!mic_capture_is_running()) {
+        esp_err_t ret = mic_capture_start(NULL);
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            return httpd_resp_sendstr(req, "Microphone unavailable");
+        }
+    }
+
+    if (xSemaphoreTake(stream_slots, 0) != pdTRUE) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Too many listeners");
+    }
+    int slot = claim_slot();
+    if (!slot_reader[slot]) slot_reader[slot] = mic_reader_create(false);
+    if (!slot_reader[slot]) {
+        release_slot(slot);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "No free microphone reader");
+    }
+
+    stream_job_t *job = malloc(sizeof(*job));
+    if (!job) {
+        release_slot(slot);
+        return ESP_ERR_NO_MEM;
+    }
+    job->adpcm = adpcm;
+    job->slot = slot;
+
+    esp_err_t res = httpd_req_async_handler_begin(req, &job->req);
+    if (res != ESP_OK) {
+        free(job);
+        release_slot(slot);
+        return res;
+    }
+
+    portENTER_CRITICAL(&stats_mux);
+    stats.clients++;
+    portEXIT_CRITICAL(&stats_mux);
+
+    if (xTaskCreate(stream_worker, "mic_stream", STREAM_TASK_STACK, job, STREAM_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start stream worker");
+        portENTER_CRITICAL(&stats_mux);
+        stats.clients--;
+        portEXIT_CRITICAL(&stats_mux);
+        httpd_req_async_handler_complete(job->req);
+        free(job);
+        release_slot(slot);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void mic_stream_get_stats(mic_stream_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+esp_err_t mic_stream_register_handlers(httpd_handle_t server)
+{
+    if (!stream_slots) {
+        stream_slots = xSemaphoreCreateCounting(MIC_STREAM_MAX_CLIENTS, MIC_STREAM_MAX_CLIENTS);
+        if (!stream_slots) return ESP_ERR_NO_MEM;
+    }
+
+    const httpd_uri_t uri = {.uri = "/api/audio/stream", .method = HTTP_GET, .handler = stream_handler};
+    return httpd_register_uri_handler(server, &uri);
+}
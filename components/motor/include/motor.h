@@ -29,6 +29,8 @@ typedef enum {
 typedef struct {
     motor_config_t config;
     bool is_initialized;
+    motor_direction_t direction; // last commanded
+    uint8_t speed;               // last commanded, 0-100%
 } motor_t;
 
 /**
@@ -67,6 +69,36 @@ esp_err_t motor_stop(uint8_t motor_id);
  */
 esp_err_t motor_stop_all(void);
 
+/**
+ * @brief Stop all motors as fast as possible and refuse to drive again until
+ *        motor_clear_emergency_stop(). No logging, and the only lock is a
+ *        spinlock motor_set_speed() holds for a few register writes, so it
+ *        can be called from a time-critical task.
+ */
+void motor_emergency_stop(void);
+
+/**
+ * @brief Allow motor_set_speed() to drive again after an emergency stop
+ */
+void motor_clear_emergency_stop(void);
+
+/**
+ * @brief Whether an emergency stop is latched
+ */
+bool motor_is_emergency_stopped(void);
+
+/**
+ * @brief Highest commanded speed over all motors, for safety checks
+ * @return 0-100%
+ */
+uint8_t motor_get_max_speed(void);
+
+/**
+ * @brief Count of speed/direction commands so far; changes whenever the
+ *        motors were told to do something new
+ */
+uint32_t motor_get_command_seq(void);
+
 /**
  * @brief Get motor status
  * @param motor_id Motor identifier (0-3)
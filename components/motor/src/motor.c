@@ -1,6 +1,7 @@
 #include "motor.h"
 #include "esp_log.h"
 #include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
 #include <string.h>
 
 static const char *TAG = "MOTOR";
@@ -12,6 +13,13 @@ static const char *TAG = "MOTOR";
 
 static motor_t motors[MAX_MOTORS];
 static bool motor_system_initialized = false;
+static volatile bool emergency_stopped = false;
+static volatile uint32_t command_seq = 0;
+
+// Held across the latch check and the hardware writes in motor_set_speed(),
+// and across the whole of motor_emergency_stop(), so a command that passed
+// the check can't land after the stop and drive again.
+static portMUX_TYPE motor_mux = portMUX_INITIALIZER_UNLOCKED;
 
 esp_err_t motor_init(void)
 {
@@ -125,24 +133,23 @@ esp_err_t motor_set_speed(uint8_t motor_id, motor_direction_t direction, uint8_t
         return ESP_FAIL;
     }
 
-    motor_config_t *config = &motors[motor_id].config;
-    
-    // Set direction pins
+    // Direction pin levels
+    int dir1, dir2;
     switch (direction) {
         case MOTOR_STOP:
-            gpio_set_level(config->pin_dir1, 0);
-            gpio_set_level(config->pin_dir2, 0);
+            dir1 = 0;
+            dir2 = 0;
             speed = 0; // Ensure speed is 0 when stopping
             break;
         
         case MOTOR_FORWARD:
-            gpio_set_level(config->pin_dir1, 1);
-            gpio_set_level(config->pin_dir2, 0);
+            dir1 = 1;
+            dir2 = 0;
             break;
         
         case MOTOR_BACKWARD:
-            gpio_set_level(config->pin_dir1, 0);
-            gpio_set_level(config->pin_dir2, 1);
+            dir1 = 0;
+            dir2 = 1;
             break;
         
         default:
@@ -152,17 +159,35 @@ esp_err_t motor_set_speed(uint8_t motor_id, motor_direction_t direction, uint8_t
 
     // Convert speed percentage to PWM duty cycle
     uint32_t duty = (speed * PWM_MAX_DUTY) / 100;
-    
-    // Set PWM duty cycle
-    esp_err_t ret = ledc_set_duty(LEDC_LOW_SPEED_MODE, config->pwm_channel, duty);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set PWM duty: %s", esp_err_to_name(ret));
-        return ret;
+    motor_config_t *config = &motors[motor_id].config;
+
+    // No logging until the lock is released
+    const char *failed = NULL;
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&motor_mux);
+    bool latched = emergency_stopped && speed > 0;
+    if (!latched) {
+        gpio_set_level(config->pin_dir1, dir1);
+        gpio_set_level(config->pin_dir2, dir2);
+        ret = ledc_set_duty(LEDC_LOW_SPEED_MODE, config->pwm_channel, duty);
+        if (ret != ESP_OK) {
+            failed = "set";
+        } else if ((ret = ledc_update_duty(LEDC_LOW_SPEED_MODE, config->pwm_channel)) != ESP_OK) {
+            failed = "update";
+        } else {
+            motors[motor_id].direction = direction;
+            motors[motor_id].speed = speed;
+            command_seq++;
+        }
     }
+    portEXIT_CRITICAL(&motor_mux);
 
-    ret = ledc_update_duty(LEDC_LOW_SPEED_MODE, config->pwm_channel);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to update PWM duty: %s", esp_err_to_name(ret));
+    if (latched) {
+        ESP_LOGW(TAG, "Motor %d: emergency stop latched", motor_id);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (failed) {
+        ESP_LOGE(TAG, "Failed to %s PWM duty: %s", failed, esp_err_to_name(ret));
         return ret;
     }
 
@@ -170,6 +195,51 @@ esp_err_t motor_set_speed(uint8_t motor_id, motor_direction_t direction, uint8_t
     return ESP_OK;
 }
 
+void motor_emergency_stop(void)
+{
+    portENTER_CRITICAL(&motor_mux);
+    emergency_stopped = true;
+    for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+        if (!motors[i].is_initialized) continue;
+        motor_config_t *config = &motors[i].config;
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, config->pwm_channel, 0);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, config->pwm_channel);
+        gpio_set_level(config->pin_dir1, 0);
+        gpio_set_level(config->pin_dir2, 0);
+        motors[i].direction = MOTOR_STOP;
+        motors[i].speed = 0;
+    }
+    command_seq++;
+    portEXIT_CRITICAL(&motor_mux);
+}
+
+void motor_clear_emergency_stop(void)
+{
+    emergency_stopped = false;
+    ESP_LOGI(TAG, "Emergency stop cleared");
+}
+
+bool motor_is_emergency_stopped(void)
+{
+    return emergency_stopped;
+}
+
+uint8_t motor_get_max_speed(void)
+{
+    uint8_t max = 0;
+    for (uint8_t i = 0; i < MAX_MOTORS; i++) {
+        if (motors[i].is_initialized && motors[i].direction != MOTOR_STOP && motors[i].speed > max) {
+            max = motors[i].speed;
+        }
+    }
+    return max;
+}
+
+uint32_t motor_get_command_seq(void)
+{
+    return command_seq;
+}
+
 esp_err_t motor_stop(uint8_t motor_id)
 {
     return motor_set_speed(motor_id, MOTOR_STOP, 0);
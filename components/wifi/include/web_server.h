@@ -7,6 +7,13 @@ extern "C"
 {
 #endif
 
+    // Called with the running server so other components can add their routes
+    typedef esp_err_t (*petbot_web_register_fn)(httpd_handle_t server);
+
+    // Queue a route registration to run every time the server starts.
+    // Call before petbot_wifi_start(); the server may start in STA or AP mode.
+    esp_err_t petbot_web_add_handlers(petbot_web_register_fn fn);
+
     esp_err_t petbot_web_start(httpd_handle_t *server_out);
     void petbot_web_stop(httpd_handle_t server);
 
@@ -13,6 +13,21 @@
 
 static const char *TAG = "web";
 
+// ======= Routes contributed by other components =======
+#define EXTRA_HANDLERS_MAX 8
+static petbot_web_register_fn extra_handlers[EXTRA_HANDLERS_MAX];
+static size_t extra_handler_count = 0;
+
+esp_err_t petbot_web_add_handlers(petbot_web_register_fn fn)
+{
+    if (!fn)
+        return ESP_ERR_INVALID_ARG;
+    if (extra_handler_count >= EXTRA_HANDLERS_MAX)
+        return ESP_ERR_NO_MEM;
+    extra_handlers[extra_handler_count++] = fn;
+    return ESP_OK;
+}
+
 // ======= In‑memory log ring (very small & simple) =======
 #define LOG_MAX 256
 static char logbuf[LOG_MAX][160];
@@ -37,6 +52,8 @@ extern const uint8_t ota_html_start[] asm("_binary_ota_html_start");
 extern const uint8_t ota_html_end[] asm("_binary_ota_html_end");
 extern const uint8_t settings_html_start[] asm("_binary_settings_html_start");
 extern const uint8_t settings_html_end[] asm("_binary_settings_html_end");
+extern const uint8_t camera_html_start[] asm("_binary_camera_html_start");
+extern const uint8_t camera_html_end[] asm("_binary_camera_html_end");
 extern const uint8_t assets_main_js_start[] asm("_binary_main_js_start");
 extern const uint8_t assets_main_js_end[] asm("_binary_main_js_end");
 extern const uint8_t assets_style_css_start[] asm("_binary_style_css_start");
@@ -54,6 +71,7 @@ static esp_err_t h_root(httpd_req_t *req) { return send_blob(req, index_html_sta
 static esp_err_t h_logs(httpd_req_t *req) { return send_blob(req, logs_html_start, logs_html_end, "text/html"); }
 static esp_err_t h_ota(httpd_req_t *req) { return send_blob(req, ota_html_start, ota_html_end, "text/html"); }
 static esp_err_t h_settings(httpd_req_t *req) { return send_blob(req, settings_html_start, settings_html_end, "text/html"); }
+static esp_err_t h_camera(httpd_req_t *req) { return send_blob(req, camera_html_start, camera_html_end, "text/html"); }
 static esp_err_t h_js(httpd_req_t *req) { return send_blob(req, assets_main_js_start, assets_main_js_end, "application/javascript"); }
 static esp_err_t h_css(httpd_req_t *req) { return send_blob(req, assets_style_css_start, assets_style_css_end, "text/css"); }
 
@@ -205,6 +223,7 @@ static const httpd_uri_t routes[] = {
     {.uri = "/logs", .method = HTTP_GET, .handler = h_logs},
     {.uri = "/ota", .method = HTTP_GET, .handler = h_ota},
     {.uri = "/settings", .method = HTTP_GET, .handler = h_settings},
+    {.uri = "/camera", .method = HTTP_GET, .handler = h_camera},
     {.uri = "/assets/main.js", .method = HTTP_GET, .handler = h_js},
     {.uri = "/assets/style.css", .method = HTTP_GET, .handler = h_css},
 
@@ -223,7 +242,12 @@ esp_err_t petbot_web_start(httpd_handle_t *server_out)
 {
     httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
     cfg.server_port = 80;
-    cfg.max_uri_handlers = 16;
+    // The UI and captive portal routes plus everything added through
+    // petbot_web_add_handlers(), with room to grow
+    cfg.max_uri_handlers = 48;
+    // Long-lived streams hand their socket to a worker task; let new UI
+    // requests evict the least recently used connection instead of failing
+    cfg.lru_purge_enable = true;
 
     httpd_handle_t s = NULL;
     ESP_ERROR_CHECK(httpd_start(&s, &cfg));
@@ -232,6 +256,12 @@ esp_err_t petbot_web_start(httpd_handle_t *server_out)
     {
         httpd_register_uri_handler(s, &routes[i]);
     }
+    for (size_t i = 0; i < extra_handler_count; ++i)
+    {
+        esp_err_t err = extra_handlers[i](s);
+        if (err != ESP_OK)
+            ESP_LOGE(TAG, "Extra routes %u not registered: %s", (unsigned)i, esp_err_to_name(err));
+    }
 
     if (server_out)
         *server_out = s;
@@ -1,19 +1,27 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_system.h"
 #include "nvs_flash.h"
 #include "wifi.h"
+#include "web_server.h"
+#include "camera.h"
+#include "i2c_bus.h"
+#include "mic_monitor.h"
+#include "mic_classifier.h"
+#include "mic_stream.h"
 
 static const char *TAG = "main";
 
 void initialize(void);
+static void start_audio(void);
 
 void app_main(void)
 {
 
     initialize(); // Initialize NVS and Wi-Fi
 
-    // 3) Example: push some logs to the web log page
+    // 4) Example: push some logs to the web log page
     for (int i = 1;; ++i)
     {
         petbot_web_logf("Heartbeat %d: free heap=%lu", i, (unsigned long)esp_get_free_heap_size());
@@ -31,11 +39,44 @@ void initialize(void)
         ESP_ERROR_CHECK(nvs_flash_init());
     }
 
-    // 2) Bring up Wi‑Fi + web server (STA first, fall back to AP)
+    // 2) Camera capture; /stream is served by the main web server. A missing
+    // sensor must not keep Wi-Fi and OTA from coming up
+    if (init_camera() == ESP_OK)
+        ESP_ERROR_CHECK(petbot_web_add_handlers(camera_register_handlers));
+    else
+        ESP_LOGE(TAG, "Camera not started; camera routes disabled");
+
+    start_audio();
+
+    // Bus utilisation and per-priority latency at /api/i2c/stats
+    ESP_ERROR_CHECK(petbot_web_add_handlers(i2c_bus_register_handlers));
+
+    // 3) Bring up Wi‑Fi + web server (STA first, fall back to AP)
     petbot_net_cfg_t cfg = {
         .ap_ssid = "PetBot-Setup",
         .ap_pass = "petbot123", // keep simple for demo; change in production
         .ap_channel = 6,
     };
     ESP_ERROR_CHECK(petbot_wifi_start(&cfg));
-}
\ No newline at end of file
+}
+
+/**
+ * Microphone analysis and its web routes. The routes are registered even if
+ * a task fails to start, so the API answers 503 rather than 404.
+ */
+static void start_audio(void)
+{
+    // Sound levels and bark/whine detection at /api/audio/level
+    if (mic_monitor_start(NULL) != ESP_OK)
+        ESP_LOGW(TAG, "Audio monitor not started");
+    ESP_ERROR_CHECK(petbot_web_add_handlers(mic_monitor_register_handlers));
+
+    // Spectral features and sound templates at /api/audio/features
+    if (mic_classifier_start(NULL) != ESP_OK)
+        ESP_LOGW(TAG, "Audio classifier not started");
+    ESP_ERROR_CHECK(petbot_web_add_handlers(mic_classifier_register_handlers));
+
+    // Live audio as WAV or IMA-ADPCM at /api/audio/stream; capture starts
+    // with the first listener if the tasks above couldn't start it
+    ESP_ERROR_CHECK(petbot_web_add_handlers(mic_stream_register_handlers));
+}
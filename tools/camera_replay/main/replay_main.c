@@ -0,0 +1,31 @@
+#include "camera.h"
+#include "esp_log.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+
+static const char *TAG = "replay";
+
+/**
+ * Serves the camera routes on PETBOT_PORT (default 8080) from a directory
+ * of recorded frames, so many local clients can hammer /stream, /ws/camera
+ * and /api/camera/stats without a robot.
+ */
+void app_main(void) {
+    ESP_ERROR_CHECK(init_camera());
+
+    const char *port = getenv("PETBOT_PORT");
+    httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
+    cfg.server_port = port ? atoi(port) : 8080;
+    cfg.max_uri_handlers = 32;
+    cfg.max_open_sockets = CAMERA_MAX_STREAMS + CAMERA_MAX_WS_CLIENTS + 4;
+    cfg.lru_purge_enable = true;
+
+    httpd_handle_t server = NULL;
+    ESP_ERROR_CHECK(httpd_start(&server, &cfg));
+    ESP_ERROR_CHECK(camera_register_handlers(server));
+    ESP_LOGI(TAG, "Serving on port %u", cfg.server_port);
+
+    while (true) vTaskDelay(pdMS_TO_TICKS(1000));
+}
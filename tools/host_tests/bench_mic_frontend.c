@@ -0,0 +1,163 @@
+// Microphone front end: checks mic_frontend_process() sample for sample
+// against a plain reference, checks the half-band decimator, and times the
+// fused pass against the reference and the bare shift it replaced.
+
+#include "host_test.h"
+#include "mic_frontend.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK 256       // mic_capture's default DMA block
+#define ROUNDS 20000
+
+// Budget for the fused pass on the host; the old shift was well under 1
+#define FRONTEND_BUDGET_NS 10.0
+
+/**
+ * The obvious version: one sample at a time with branches, as the capture
+ * task would have written it without the fused kernel.
+ */
+static uint32_t reference_process(mic_frontend_t *fe, const int32_t *raw, int16_t *out, size_t n) {
+    int32_t dc = fe->cfg.dc_shift ? fe->dc_q8 >> 8 : 0;
+    int64_t sum = 0;
+    uint32_t clipped = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t s = raw[i] >> 14;
+        int32_t y = ((s - dc) * fe->cfg.gain_q8) >> 8;
+        if (y > INT16_MAX) {
+            y = INT16_MAX;
+            clipped++;
+        } else if (y < INT16_MIN) {
+            y = INT16_MIN;
+            clipped++;
+        }
+        out[i] = (int16_t)y;
+        sum += s;
+    }
+    if (fe->cfg.dc_shift && n > 0) {
+        int32_t mean_q8 = (int32_t)((sum * 256) / (int64_t)n);
+        fe->dc_q8 += (mean_q8 - fe->dc_q8) >> fe->cfg.dc_shift;
+    }
+    return clipped;
+}
+
+static void bare_shift(const int32_t *raw, int16_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (int16_t)(raw[i] >> 14);
+}
+
+// INMP441-style frames: 24 bits left aligned, a DC offset and a tone
+static void make_raw(int32_t *raw, size_t n, int amplitude, int offset, uint32_t seed) {
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        int32_t v = (int32_t)(amplitude * sin(i * 0.3)) + offset + (int32_t)(seed >> 26) - 32;
+        raw[i] = (int32_t)((uint32_t)v << 14);
+    }
+}
+
+static void test_against_reference(void) {
+    static const int32_t gains[] = {0, 64, 256, 1000, MIC_FRONTEND_MAX_GAIN_Q8};
+    int32_t raw[BLOCK];
+    int16_t a[BLOCK], b[BLOCK];
+    for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+        mic_frontend_config_t cfg = {.gain_q8 = gains[g], .dc_shift = 3};
+        mic_frontend_t fe, ref;
+        mic_frontend_init(&fe, &cfg);
+        mic_frontend_init(&ref, &cfg);
+        uint32_t clips_fe = 0, clips_ref = 0;
+        int mismatches = 0;
+        for (int blk = 0; blk < 64; blk++) {
+            make_raw(raw, BLOCK, 20000 + blk * 1500, 3000, blk);
+            clips_fe += mic_frontend_process(&fe, raw, a, BLOCK);
+            clips_ref += reference_process(&ref, raw, b, BLOCK);
+            mismatches += memcmp(a, b, sizeof(a)) != 0;
+        }
+        CHECK(mismatches == 0, "gain %d: %d blocks differ from the reference", (int)gains[g], mismatches);
+        CHECK(clips_fe == clips_ref, "gain %d: %u clips, reference %u", (int)gains[g], clips_fe, clips_ref);
+        CHECK(fe.dc_q8 == ref.dc_q8, "gain %d: dc %d, reference %d", (int)gains[g], (int)fe.dc_q8,
+              (int)ref.dc_q8);
+    }
+
+    // The DC tracker takes the offset out
+    mic_frontend_config_t cfg = MIC_FRONTEND_CONFIG_DEFAULT();
+    mic_frontend_t fe;
+    mic_frontend_init(&fe, &cfg);
+    for (int blk = 0; blk < 100; blk++) {
+        make_raw(raw, BLOCK, 0, 3000, blk);
+        mic_frontend_process(&fe, raw, a, BLOCK);
+    }
+    long mean = 0;
+    for (int i = 0; i < BLOCK; i++) mean += a[i];
+    mean /= BLOCK;
+    CHECK(labs(mean) < 50, "offset left after DC removal: %ld", mean);
+}
+
+static void test_decimator(void) {
+    mic_decimator_t dec;
+    int16_t x[64], y[64];
+
+    mic_decimator_init(&dec);
+    for (int i = 0; i < 64; i++) x[i] = 1000;
+    size_t k = mic_decimate2(&dec, x, y, 64);
+    CHECK(k == 32, "64 in, %zu out", k);
+    CHECK(y[k - 1] == 1000, "DC came out as %d", y[k - 1]);
+
+    // Nyquist is the half-band's zero; odd counts carry the phase
+    mic_decimator_init(&dec);
+    for (int i = 0; i < 64; i++) x[i] = (i & 1) ? 1000 : -1000;
+    k = mic_decimate2(&dec, x, y, 31);
+    k += mic_decimate2(&dec, x + 31, y + k, 33);
+    CHECK(k == 32, "31 + 33 in, %zu out", k);
+    CHECK(abs(y[k - 1]) <= 1, "Nyquist came out as %d", y[k - 1]);
+
+    // In place
+    for (int i = 0; i < 64; i++) x[i] = 500;
+    mic_decimator_init(&dec);
+    k = mic_decimate2(&dec, x, x, 64);
+    CHECK(x[k - 1] == 500, "in place gave %d", x[k - 1]);
+}
+
+typedef struct {
+    double ns;
+    double ticks;
+} cost_t;
+
+#define TIME_LOOP(cost, body)                                       \
+    do {                                                            \
+        uint64_t t0 = now_ns(), c0 = now_ticks();                   \
+        for (int r = 0; r < ROUNDS; r++) {                          \
+            body;                                                   \
+            keep(out);                                              \
+        }                                                           \
+        (cost).ticks = (double)(now_ticks() - c0) / ROUNDS / BLOCK; \
+        (cost).ns = (double)(now_ns() - t0) / ROUNDS / BLOCK;       \
+    } while (0)
+
+static void bench(void) {
+    static int32_t raw[BLOCK];
+    static int16_t out[BLOCK];
+    make_raw(raw, BLOCK, 12000, 4000, 1);
+    mic_frontend_config_t cfg = {.gain_q8 = 512, .dc_shift = 3};
+    mic_frontend_t fe, ref;
+    mic_frontend_init(&fe, &cfg);
+    mic_frontend_init(&ref, &cfg);
+
+    cost_t shift, naive, fused;
+    uint32_t clips = 0;
+    TIME_LOOP(shift, bare_shift(raw, out, BLOCK));
+    TIME_LOOP(naive, clips += reference_process(&ref, raw, out, BLOCK));
+    TIME_LOOP(fused, clips += mic_frontend_process(&fe, raw, out, BLOCK));
+    keep(&clips);
+
+    printf("per sample, %d-sample blocks: bare shift %.2f ns (%.1f ticks), reference %.2f ns (%.1f ticks), "
+           "mic_frontend %.2f ns (%.1f ticks)\n",
+           BLOCK, shift.ns, shift.ticks, naive.ns, naive.ticks, fused.ns, fused.ticks);
+    CHECK_BUDGET(fused.ns < FRONTEND_BUDGET_NS, "%.2f ns/sample over the %.0f ns budget", fused.ns, FRONTEND_BUDGET_NS);
+}
+
+int main(void) {
+    test_against_reference();
+    test_decimator();
+    bench();
+    return check_result("mic_frontend");
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""Writes the IMU traces the host tests replay, with ground truth.
+
+The traces are simulated rather than recorded so the truth is exact: a
+smooth attitude profile is differentiated into body rates, and gravity is
+rotated into the sensor frame. Sensor noise, gyro bias and driving
+vibration are added at LSM6DS3 levels (104 Hz, +-2 g, 245 dps). Re-run
+after changing the profile; the output is deterministic.
+
+  imu_orientation.csv  t_s,gx,gy,gz,ax,ay,az,roll,pitch,yaw
+                       rad/s, g and degrees (truth, Z-Y-X order)
+  imu_collision.csv    ax,ay,az,speed,cmd,impact at COLLISION_ODR_HZ
+                       milli-g, commanded speed in %, 1 on the sample
+                       a motor command changed, 1 where an impact starts
+"""
+import math
+import os
+import random
+
+ODR_HZ = 104
+COLLISION_ODR_HZ = 1660
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def q_mul(a, b):
+    aw, ax, ay, az = a
+    bw, bx, by, bz = b
+    return (aw * bw - ax * bx - ay * by - az * bz,
+            aw * bx + ax * bw + ay * bz - az * by,
+            aw * by - ax * bz + ay * bw + az * bx,
+            aw * bz + ax * by - ay * bx + az * bw)
+
+
+def q_conj(q):
+    return (q[0], -q[1], -q[2], -q[3])
+
+
+def q_from_euler(roll, pitch, yaw):
+    cr, sr = math.cos(roll / 2), math.sin(roll / 2)
+    cp, sp = math.cos(pitch / 2), math.sin(pitch / 2)
+    cy, sy = math.cos(yaw / 2), math.sin(yaw / 2)
+    return (cr * cp * cy + sr * sp * sy,
+            sr * cp * cy - cr * sp * sy,
+            cr * sp * cy + sr * cp * sy,
+            cr * cp * sy - sr * sp * cy)
+
+
+def world_to_sensor(q, v):
+    return q_mul(q_mul(q_conj(q), (0.0,) + tuple(v)), q)[1:]
+
+
+def smoothstep(t, t0, t1):
+    if t <= t0:
+        return 0.0
+    if t >= t1:
+        return 1.0
+    x = (t - t0) / (t1 - t0)
+    return x * x * (3 - 2 * x)
+
+
+def orientation_profile(t):
+    """Level, roll over, pitch up a ramp, rock while turning, level again."""
+    d = math.radians
+    roll = d(30) * (smoothstep(t, 2, 4) - smoothstep(t, 7, 9))
+    pitch = d(-20) * (smoothstep(t, 5, 6.5) - smoothstep(t, 10, 11.5))
+    rock = smoothstep(t, 12, 13) - smoothstep(t, 17, 18)
+    roll += d(8) * rock * math.sin(2 * math.pi * 0.7 * t)
+    pitch += d(6) * rock * math.sin(2 * math.pi * 0.45 * t + 1)
+    yaw = d(90) * smoothstep(t, 12, 18)
+    return roll, pitch, yaw
+
+
+def write_orientation(path, seconds=20.0):
+    rng = random.Random(13)
+    bias = (0.008, -0.006, 0.004)  # rad/s
+    gyro_noise = 0.004             # rad/s rms
+    accel_noise = 0.008            # g rms
+    dt = 1.0 / ODR_HZ
+    h = 1e-4
+    with open(path, "w") as f:
+        f.write("t_s,gx,gy,gz,ax,ay,az,roll,pitch,yaw\n")
+        for i in range(int(seconds * ODR_HZ)):
+            # Sample timestamps jitter like the DRDY interrupt does
+            t = i * dt + (rng.uniform(-50e-6, 50e-6) if i else 0.0)
+            q0 = q_from_euler(*orientation_profile(t - h))
+            q1 = q_from_euler(*orientation_profile(t + h))
+            q = q_from_euler(*orientation_profile(t))
+            dq = tuple((b - a) / (2 * h) for a, b in zip(q0, q1))
+            w = q_mul(q_conj(q), dq)[1:]
+            gyro = [2 * w[k] + bias[k] + rng.gauss(0, gyro_noise) for k in range(3)]
+            accel = list(world_to_sensor(q, (0.0, 0.0, 1.0)))
+            # Driving vibration, mostly vertical
+            vib = 0.03 * math.sin(2 * math.pi * 23 * t)
+            accel = [accel[0] + rng.gauss(0, accel_noise),
+                     accel[1] + rng.gauss(0, accel_noise),
+                     accel[2] + vib + rng.gauss(0, accel_noise)]
+            roll, pitch, yaw = (math.degrees(a) for a in orientation_profile(t))
+            f.write("%.5f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f\n"
+                    % (t, *gyro, *accel, roll, pitch, yaw))
+
+
+def half_sine(t, t0, width, peak):
+    if t0 <= t < t0 + width:
+        return peak * math.sin(math.pi * (t - t0) / width)
+    return 0.0
+
+
+def ramp(t, t0, width, level):
+    """Raised-cosine step from 0 to level over width seconds."""
+    if t < t0:
+        return 0.0
+    if t >= t0 + width:
+        return level
+    return level * 0.5 * (1 - math.cos(math.pi * (t - t0) / width))
+
+
+def write_collision(path, seconds=14.0):
+    """A short drive: starts, turns, floor seams, a slope, a wall, a
+    cushion that gives way slowly, a knock while parked, a threshold strip
+    at full speed. Speeds are in %, accelerations along x (forward)."""
+    rng = random.Random(19)
+    # (time, speed %) motor commands
+    commands = [(1.0, 60), (3.1, 0), (4.0, -40), (4.6, 0), (5.0, 50),
+                (6.2, 0), (7.0, 70), (9.5, 0), (11.0, 100), (12.5, 0)]
+    # Impacts: a wall at 2.8 s, a cushion at 5.9 s, a knock at 10.2 s
+    impacts = [2.8, 5.9, 10.2]
+    dt = 1.0 / COLLISION_ODR_HZ
+    with open(path, "w") as f:
+        f.write("# odr_hz=%d\n" % COLLISION_ODR_HZ)
+        f.write("ax,ay,az,speed,cmd,impact\n")
+        speed = 0
+        ci = 0
+        last_cmd_t = -10.0
+        last_speed = 0
+        marked = set()
+        for i in range(int(seconds * COLLISION_ODR_HZ)):
+            t = i * dt
+            cmd = 0
+            if ci < len(commands) and t >= commands[ci][0]:
+                last_speed, speed = speed, commands[ci][1]
+                last_cmd_t = commands[ci][0]
+                ci += 1
+                cmd = 1
+            # Speeding up or slowing down on command: 0.35 g over 120 ms
+            ax = half_sine(t, last_cmd_t, 0.12, 0.35 * (speed - last_speed) / 100.0)
+            ay = 0.0
+            # A turn in place pulls sideways
+            ay += half_sine(t, 4.0, 0.5, 0.08)
+            # Floor seams while driving: short vertical and forward bumps
+            for seam in (1.6, 2.1, 7.6, 8.3, 9.0):
+                ax += half_sine(t, seam, 0.03, -0.15)
+            az = 0.0
+            for seam in (1.6, 2.1, 7.6, 8.3, 9.0):
+                az += half_sine(t, seam, 0.03, 0.3)
+            # Threshold strip at full speed: a harder seam
+            ax += half_sine(t, 11.8, 0.025, -0.3)
+            az += half_sine(t, 11.8, 0.025, 0.6)
+            # Wall: 3 g stop in 10 ms, then the chassis rings
+            ax += half_sine(t, 2.8, 0.010, -3.0)
+            if 2.81 <= t < 2.9:
+                ax += 0.5 * math.exp(-(t - 2.81) / 0.02) * math.sin(2 * math.pi * 60 * (t - 2.81))
+            # Cushion: 0.7 g of deceleration building over 40 ms, held
+            # while the motors push, released on the stop command
+            if 5.9 <= t < 6.2:
+                ax += ramp(t, 5.9, 0.04, -0.7)
+            # Knocked while parked
+            ay += half_sine(t, 10.2, 0.006, 1.5)
+            # Up a 10 degree slope and back: gravity tips slowly
+            tilt = math.radians(10) * (smoothstep(t, 7.8, 8.8) - smoothstep(t, 9.2, 10.0))
+            gx, gz = -math.sin(tilt), math.cos(tilt)
+            # Motor vibration while driving, and sensor noise always
+            vib = 0.02 * abs(speed) / 100.0
+            motor = 0.03 * abs(speed) / 100.0 * math.sin(2 * math.pi * 37 * t)
+            ax += gx + motor * 0.3 + rng.gauss(0, vib) + rng.gauss(0, 0.004)
+            ay += rng.gauss(0, vib) + rng.gauss(0, 0.004)
+            az += gz + motor + rng.gauss(0, vib) + rng.gauss(0, 0.004)
+            impact = 0
+            for t0 in impacts:
+                if t >= t0 and t0 not in marked:
+                    marked.add(t0)
+                    impact = 1
+            f.write("%d,%d,%d,%d,%d,%d\n" % (round(ax * 1000), round(ay * 1000),
+                                             round(az * 1000), speed, cmd, impact))
+
+
+if __name__ == "__main__":
+    write_orientation(os.path.join(HERE, "imu_orientation.csv"))
+    write_collision(os.path.join(HERE, "imu_collision.csv"))
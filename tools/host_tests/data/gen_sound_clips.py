@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Writes the 16 kHz mono WAV clips the spectrum test replays.
+
+Simulated so that every event has an exact onset and label:
+  bark.wav, doorbell.wav  one clean example each, to learn templates from
+  scene.wav               6 s of room noise and fan hum with barks and
+                          doorbells at different distances, and a door slam
+  scene_labels.csv        onset_s,label of every event in scene.wav;
+                          "unknown" is a sound that must not match
+The barks and doorbells in the scene vary in pitch and length from the
+template examples. Output is deterministic.
+"""
+import math
+import os
+import random
+import struct
+import wave
+
+RATE = 16000
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def bark(rng, f0, length, gain):
+    """Harmonic yelp: pitch falls through the bark, with a breathy burst."""
+    out = []
+    phase = 0.0
+    n = int(length * RATE)
+    for i in range(n):
+        t = i / RATE
+        env = min(1.0, t / 0.008) * math.exp(-t / (length * 0.45))
+        f = f0 * (1.15 - 0.3 * t / length)
+        phase += 2 * math.pi * f / RATE
+        v = sum(math.sin(k * phase) / k for k in range(1, 7))
+        v += 0.4 * rng.uniform(-1, 1)
+        out.append(gain * env * v * 0.45)
+    return out
+
+
+def chime(f1, f2, length, gain):
+    """Doorbell strike: two bars struck together, decaying bell tones."""
+    out = []
+    for i in range(int(length * RATE)):
+        t = i / RATE
+        env = min(1.0, t / 0.003) * math.exp(-t / 0.15)
+        v = 0.0
+        for f in (f1, f2):
+            v += math.sin(2 * math.pi * f * t) + 0.3 * math.sin(2 * math.pi * 2.76 * f * t)
+        out.append(gain * env * v * 0.4)
+    return out
+
+
+def slam(rng, gain):
+    """Door slam: a broadband thump with a low ring."""
+    out = []
+    for i in range(int(0.25 * RATE)):
+        t = i / RATE
+        v = rng.uniform(-1, 1) * math.exp(-t / 0.02) + 0.6 * math.sin(2 * math.pi * 90 * t) * math.exp(-t / 0.06)
+        out.append(gain * v)
+    return out
+
+
+def room(rng, seconds):
+    """Fan hum and low room noise, about -55 dBFS."""
+    out = []
+    lp = 0.0
+    for i in range(int(seconds * RATE)):
+        lp += 0.2 * (rng.gauss(0, 1) - lp)
+        out.append(0.0015 * lp + 0.001 * math.sin(2 * math.pi * 120 * i / RATE))
+    return out
+
+
+def mix(base, clip, at):
+    """Adds clip at a time, faded out over its last 20 ms so the cut-off
+    tail isn't a click of its own."""
+    start = int(at * RATE)
+    fade = int(0.02 * RATE)
+    for i, v in enumerate(clip):
+        v *= min(1.0, (len(clip) - i) / fade)
+        if start + i < len(base):
+            base[start + i] += v
+
+
+def write_wav(name, samples):
+    with wave.open(os.path.join(HERE, name), "wb") as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(RATE)
+        w.writeframes(b"".join(struct.pack("<h", max(-32768, min(32767, round(s * 32767))))
+                               for s in samples))
+
+
+def main():
+    rng = random.Random(24)
+
+    # The classifier can't fire in its first few hops, so leave a gap
+    clip = room(rng, 0.9)
+    mix(clip, bark(rng, 520, 0.22, 0.5), 0.4)
+    write_wav("bark.wav", clip)
+
+    clip = room(rng, 1.1)
+    mix(clip, chime(880, 698, 0.6, 0.4), 0.4)
+    write_wav("doorbell.wav", clip)
+
+    scene = room(rng, 6.0)
+    events = [
+        (0.50, "bark", bark(rng, 560, 0.18, 0.6)),
+        (1.30, "bark", bark(rng, 480, 0.25, 0.5)),
+        (2.20, "doorbell", chime(880, 698, 0.6, 0.3)),
+        (3.30, "bark", bark(rng, 540, 0.2, 0.08)),      # across the room
+        (4.00, "doorbell", chime(880, 698, 0.6, 0.05)),  # from another floor
+        (5.20, "unknown", slam(rng, 0.5)),
+    ]
+    for at, _, clip in events:
+        mix(scene, clip, at)
+    write_wav("scene.wav", scene)
+    with open(os.path.join(HERE, "scene_labels.csv"), "w") as f:
+        f.write("onset_s,label\n")
+        for at, label, _ in events:
+            f.write("%.3f,%s\n" % (at, label))
+
+
+if __name__ == "__main__":
+    main()
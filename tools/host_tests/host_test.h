@@ -0,0 +1,74 @@
+#pragma once
+
+// Helpers shared by the host tests: a CHECK that records failures and
+// keeps going, an opt-in CHECK_BUDGET for timings, and a monotonic clock
+// for the benchmarks.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int check_failures;
+
+#define CHECK(cond, ...)                                                    \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, \
+                    #cond);                                                 \
+            fprintf(stderr, __VA_ARGS__);                                   \
+            fputc('\n', stderr);                                            \
+            check_failures++;                                               \
+        }                                                                   \
+    } while (0)
+
+/**
+ * Timing budgets depend on the machine and build, so a miss only fails
+ * the test when HOST_TEST_BUDGETS is set; otherwise it is reported.
+ */
+#ifdef HOST_TEST_BUDGETS
+#define CHECK_BUDGET(cond, ...) CHECK(cond, __VA_ARGS__)
+#else
+#define CHECK_BUDGET(cond, ...)                                             \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("over budget, not enforced: ");                          \
+            printf(__VA_ARGS__);                                            \
+            putchar('\n');                                                  \
+        }                                                                   \
+    } while (0)
+#endif
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Time-stamp counter ticks on x86, where they are close to core cycles;
+ * nanoseconds elsewhere.
+ */
+static inline uint64_t now_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+/**
+ * Keeps the optimizer from deleting a benchmark loop whose result is
+ * otherwise unused.
+ */
+static inline void keep(const void *p) {
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+static inline int check_result(const char *name) {
+    if (check_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Collision detector replay: feeds an IMU trace with marked impacts through
+// collision_detect_update() the way collision.c does, and counts detected
+// impacts and false alarms (see data/gen_imu_traces.py for the format).
+//   test_collision_detect [trace.csv]
+
+#include "host_test.h"
+#include "collision_detect.h"
+#include <stdlib.h>
+
+// An impact counts as detected if a detection follows within this long
+#define DETECT_WINDOW_S 0.05f
+
+#define EXPECTED_IMPACTS 3
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : DATA_DIR "/imu_collision.csv";
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    int odr_hz = 0;
+    if (fscanf(f, "# odr_hz=%d\n", &odr_hz) != 1 || odr_hz <= 0) {
+        fprintf(stderr, "%s: missing odr_hz line\n", path);
+        fclose(f);
+        return 1;
+    }
+    const float dt = 1.0f / odr_hz;
+
+    collision_detect_config_t cfg = COLLISION_DETECT_CONFIG_DEFAULT();
+    collision_detect_t det;
+    collision_detect_init(&det, &cfg);
+
+    int impacts = 0, detected = 0, false_alarms = 0, kinds[3] = {0};
+    float pending_since = -1.0f, worst_latency = 0.0f, max_quiet_ratio = 0.0f;
+    char line[128];
+    long n = 0;
+    uint64_t ns = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int ax, ay, az, speed, cmd, impact;
+        if (sscanf(line, "%d,%d,%d,%d,%d,%d", &ax, &ay, &az, &speed, &cmd, &impact) != 6)
+            continue; // the header
+        float t = n++ * dt;
+        if (impact) {
+            impacts++;
+            pending_since = t;
+        }
+
+        uint64_t t0 = now_ns();
+        collision_kind_t hit = collision_detect_update(&det, ax * 0.001f, ay * 0.001f, az * 0.001f, dt,
+                                                       abs(speed) * 0.01f, cmd != 0);
+        ns += now_ns() - t0;
+
+        if (hit == COLLISION_NONE) {
+            if (pending_since >= 0.0f && t - pending_since > DETECT_WINDOW_S) {
+                fprintf(stderr, "impact at %.3f s not detected\n", pending_since);
+                pending_since = -1.0f;
+            } else if (pending_since < 0.0f && det.blank_s <= 0.0f) {
+                // How close the quiet stretches come to a false alarm
+                float ratio = det.jerk / det.threshold;
+                if (ratio > max_quiet_ratio) max_quiet_ratio = ratio;
+            }
+            continue;
+        }
+        kinds[hit]++;
+        if (pending_since >= 0.0f) {
+            float latency = t - pending_since;
+            if (latency > worst_latency) worst_latency = latency;
+            printf("impact at %.3f s: %s after %.1f ms\n", pending_since, hit == COLLISION_JERK ? "jerk" : "decel",
+                   latency * 1000.0f);
+            detected++;
+            pending_since = -1.0f;
+        } else {
+            fprintf(stderr, "false alarm (%s) at %.3f s\n", hit == COLLISION_JERK ? "jerk" : "decel", t);
+            false_alarms++;
+        }
+    }
+    fclose(f);
+
+    printf("%ld samples at %d Hz: %d/%d impacts detected (%d jerk, %d decel), %d false alarms, "
+           "worst latency %.1f ms, closest miss %.0f%% of threshold, %.1f ns/update\n",
+           n, odr_hz, detected, impacts, kinds[COLLISION_JERK], kinds[COLLISION_DECEL], false_alarms,
+           worst_latency * 1000.0f, max_quiet_ratio * 100.0f, (double)ns / n);
+    if (argc == 1) CHECK(impacts == EXPECTED_IMPACTS, "trace has %d impacts", impacts);
+    CHECK(detected == impacts, "%d of %d impacts detected", detected, impacts);
+    CHECK(false_alarms == 0, "%d false alarms", false_alarms);
+    return check_result("collision_detect");
+}
@@ -0,0 +1,105 @@
+// Orientation filter accuracy and per-update cost over an IMU trace with
+// ground truth (see data/gen_imu_traces.py for the format).
+//   test_imu_ahrs [trace.csv]
+
+#include "host_test.h"
+#include "imu_ahrs.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define BETA 0.1f         // IMU_ORIENTATION_CONFIG_DEFAULT
+#define SETTLE_S 1.0f     // errors before this are not scored
+
+#define MAX_RMS_DEG 0.5f
+#define MAX_ERR_DEG 2.0f
+#define UPDATE_BUDGET_NS 500.0
+
+typedef struct {
+    float t;
+    float g[3];
+    float a[3];
+    float roll, pitch, yaw;
+} trace_row_t;
+
+static trace_row_t *load_trace(const char *path, size_t *count) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    size_t cap = 4096, n = 0;
+    trace_row_t *rows = malloc(cap * sizeof(*rows));
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        trace_row_t r;
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f", &r.t, &r.g[0], &r.g[1], &r.g[2], &r.a[0], &r.a[1],
+                   &r.a[2], &r.roll, &r.pitch, &r.yaw) != 10)
+            continue; // the header, or a damaged line
+        if (n == cap) rows = realloc(rows, (cap *= 2) * sizeof(*rows));
+        rows[n++] = r;
+    }
+    fclose(f);
+    *count = n;
+    return rows;
+}
+
+static float wrap_deg(float d) {
+    while (d > 180.0f) d -= 360.0f;
+    while (d < -180.0f) d += 360.0f;
+    return d;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : DATA_DIR "/imu_orientation.csv";
+    size_t n;
+    trace_row_t *rows = load_trace(path, &n);
+    CHECK(rows && n > 100, "%s: no samples", path);
+    if (!rows || n <= 100) return check_result("imu_ahrs");
+
+    imu_ahrs_t ahrs;
+    imu_ahrs_init(&ahrs, BETA);
+    double sq = 0;
+    float max_err = 0, max_at = 0, yaw_drift = 0;
+    size_t scored = 0;
+    for (size_t i = 0; i < n; i++) {
+        const trace_row_t *r = &rows[i];
+        float dt = i ? r->t - rows[i - 1].t : 0.0f;
+        imu_ahrs_update(&ahrs, r->g[0], r->g[1], r->g[2], r->a[0], r->a[1], r->a[2], dt);
+        if (r->t < SETTLE_S) continue;
+
+        float roll, pitch, yaw;
+        imu_ahrs_to_euler(&ahrs.q, &roll, &pitch, &yaw);
+        float er = wrap_deg(roll - r->roll), ep = wrap_deg(pitch - r->pitch);
+        sq += er * er + ep * ep;
+        scored += 2;
+        float e = fmaxf(fabsf(er), fabsf(ep));
+        if (e > max_err) {
+            max_err = e;
+            max_at = r->t;
+        }
+        yaw_drift = wrap_deg(yaw - r->yaw);
+    }
+    float rms = sqrt(sq / scored);
+    printf("%zu samples: roll/pitch rms %.2f deg, max %.2f deg at %.2f s, yaw drift %.1f deg\n", n, rms, max_err,
+           max_at, yaw_drift);
+    CHECK(rms < MAX_RMS_DEG, "rms error %.2f deg", rms);
+    CHECK(max_err < MAX_ERR_DEG, "max error %.2f deg", max_err);
+
+    // Cost: the whole trace again, many times over
+    const int rounds = 200;
+    uint64_t t0 = now_ns();
+    for (int k = 0; k < rounds; k++) {
+        imu_ahrs_init(&ahrs, BETA);
+        for (size_t i = 0; i < n; i++) {
+            const trace_row_t *r = &rows[i];
+            imu_ahrs_update(&ahrs, r->g[0], r->g[1], r->g[2], r->a[0], r->a[1], r->a[2], 1.0f / 104);
+        }
+        keep(&ahrs);
+    }
+    double ns = (double)(now_ns() - t0) / ((double)rounds * n);
+    printf("%.1f ns/update\n", ns);
+    CHECK_BUDGET(ns < UPDATE_BUDGET_NS, "%.1f ns/update over the %.0f ns budget", ns, UPDATE_BUDGET_NS);
+
+    free(rows);
+    return check_result("imu_ahrs");
+}
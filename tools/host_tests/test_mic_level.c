@@ -0,0 +1,134 @@
+// Level meter and activity detector: block measurements on known signals,
+// and event sequences for barks, hiss and a noise that starts and stays.
+
+#include "host_test.h"
+#include "mic_level.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define RATE_HZ 16000
+#define BLOCK_MS 16     // MIC_MONITOR_CONFIG_DEFAULT
+#define BLOCK (RATE_HZ * BLOCK_MS / 1000)
+
+static uint32_t seed = 23;
+
+// White-ish noise at an RMS level in dBFS, or a 700 Hz tone when tone is set
+static void block(int16_t *x, float dbfs, bool tone, int n0) {
+    float rms = 32768.0f * powf(10.0f, dbfs / 20.0f);
+    for (int i = 0; i < BLOCK; i++) {
+        float v;
+        if (tone) {
+            v = rms * 1.41421f * sinf(2.0f * 3.14159265f * 700.0f * (n0 + i) / RATE_HZ);
+        } else {
+            seed = seed * 1664525u + 1013904223u;
+            v = rms * 1.732f * ((int32_t)seed / 2147483648.0f); // uniform, unit RMS
+        }
+        x[i] = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, v));
+    }
+}
+
+typedef struct {
+    int starts, stops;
+    float first_start_s, last_stop_s;
+} events_t;
+
+// Runs seconds of one kind of sound through the detector
+static void feed(mic_vad_t *vad, float seconds, float dbfs, bool tone, float *t, events_t *ev) {
+    int16_t x[BLOCK];
+    mic_level_t lv;
+    for (int b = 0; b < (int)(seconds * 1000 / BLOCK_MS); b++) {
+        block(x, dbfs, tone, b * BLOCK);
+        mic_level_measure(x, BLOCK, &lv);
+        mic_vad_event_t e = mic_vad_update(vad, &lv, BLOCK_MS, RATE_HZ);
+        *t += BLOCK_MS / 1000.0f;
+        if (e == MIC_VAD_START) {
+            if (!ev->starts++) ev->first_start_s = *t;
+        } else if (e == MIC_VAD_STOP) {
+            ev->stops++;
+            ev->last_stop_s = *t;
+        }
+    }
+}
+
+static void test_measure(void) {
+    int16_t x[BLOCK] = {0};
+    mic_level_t lv;
+    mic_level_measure(x, BLOCK, &lv);
+    CHECK(lv.rms_dbfs == MIC_LEVEL_FLOOR_DBFS && lv.peak == 0 && lv.crossings == 0, "silence measured %.1f dBFS",
+          lv.rms_dbfs);
+
+    block(x, -20.0f, true, 0);
+    mic_level_measure(x, BLOCK, &lv);
+    CHECK(fabsf(lv.rms_dbfs + 20.0f) < 0.2f, "-20 dBFS tone measured %.2f", lv.rms_dbfs);
+    CHECK(fabsf(lv.peak_dbfs + 17.0f) < 0.2f, "tone peak measured %.2f", lv.peak_dbfs);
+    // 700 Hz crosses zero 1400 times a second
+    CHECK(abs((int)lv.crossings - 1400 * BLOCK_MS / 1000) <= 1, "%u crossings", lv.crossings);
+}
+
+static void test_barks(void) {
+    mic_vad_t vad;
+    mic_vad_init(&vad, NULL);
+    events_t ev = {0};
+    float t = 0;
+    feed(&vad, 3.0f, -70.0f, false, &t, &ev);
+    CHECK(ev.starts == 0, "quiet room started an event");
+    CHECK(fabsf(vad.noise_dbfs + 70.0f) < 3.0f, "floor %.1f in a -70 dBFS room", vad.noise_dbfs);
+
+    for (int i = 0; i < 5; i++) {
+        feed(&vad, 0.4f, -30.0f, true, &t, &ev);
+        feed(&vad, 1.5f, -70.0f, false, &t, &ev);
+    }
+    CHECK(ev.starts == 5 && ev.stops == 5, "5 barks gave %d starts, %d stops", ev.starts, ev.stops);
+    CHECK(vad.noise_dbfs < -65.0f, "barks raised the floor to %.1f", vad.noise_dbfs);
+
+    // A bark longer than a sub-window still doesn't become the floor
+    ev = (events_t){0};
+    feed(&vad, 2.0f, -30.0f, true, &t, &ev);
+    CHECK(ev.starts == 1 && ev.stops == 0, "long bark gave %d starts, %d stops", ev.starts, ev.stops);
+    CHECK(vad.noise_dbfs < -65.0f, "long bark raised the floor to %.1f", vad.noise_dbfs);
+}
+
+static void test_hiss(void) {
+    mic_vad_t vad;
+    mic_vad_init(&vad, NULL);
+    events_t ev = {0};
+    float t = 0;
+    feed(&vad, 2.0f, -70.0f, false, &t, &ev);
+    // Loud, but the crossing rate of white noise is far above zcr_max_hz
+    feed(&vad, 2.0f, -35.0f, false, &t, &ev);
+    CHECK(ev.starts == 0, "hiss started an event");
+}
+
+static void test_step(void) {
+    // A fan switches on and stays: the event it starts has to end
+    mic_vad_t vad;
+    mic_vad_init(&vad, NULL);
+    events_t ev = {0};
+    float t = 0;
+    feed(&vad, 3.0f, -70.0f, false, &t, &ev);
+    float step_s = t;
+    feed(&vad, 15.0f, -40.0f, true, &t, &ev);
+    CHECK(ev.starts == 1, "%d starts on the step", ev.starts);
+    CHECK(ev.stops == 1, "%d stops after the step", ev.stops);
+    float window_s = vad.cfg.floor_window_ms / 1000.0f;
+    float limit_s = window_s * (MIC_VAD_FLOOR_SUBWINDOWS + 1) / MIC_VAD_FLOOR_SUBWINDOWS + 0.5f;
+    CHECK(ev.stops == 0 || ev.last_stop_s - step_s < limit_s, "stop came %.1f s after the step",
+          ev.last_stop_s - step_s);
+    CHECK(fabsf(vad.noise_dbfs + 40.0f) < 3.0f, "floor %.1f under a -40 dBFS noise", vad.noise_dbfs);
+    printf("step to -40 dBFS: start after %.2f s, stop after %.2f s\n", ev.first_start_s - step_s,
+           ev.last_stop_s - step_s);
+
+    // And a bark over the fan still counts
+    ev = (events_t){0};
+    feed(&vad, 0.4f, -15.0f, true, &t, &ev);
+    feed(&vad, 1.0f, -40.0f, true, &t, &ev);
+    CHECK(ev.starts == 1 && ev.stops == 1, "bark over the fan gave %d starts, %d stops", ev.starts, ev.stops);
+}
+
+int main(void) {
+    test_measure();
+    test_barks();
+    test_hiss();
+    test_step();
+    return check_result("mic_level");
+}
@@ -0,0 +1,227 @@
+// Sound classifier replay: decodes WAV clips and runs them through
+// mic_spectrum_process() and mic_spectrum_match() hop by hop, the way
+// mic_classifier's task does. Templates are learned from one clip per
+// sound, then every labelled onset in the scene must be found and named,
+// and nothing else may fire (see data/gen_sound_clips.py).
+//   test_mic_spectrum [scene.wav labels.csv name=template.wav ...]
+
+#include "host_test.h"
+#include "mic_spectrum.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE_HZ 16000
+#define SEGMENT_HOPS 8          // MIC_CLASSIFIER_CONFIG_DEFAULT
+#define MAX_DISTANCE_DB 6.0f    // given to every learned template
+#define ONSET_TOLERANCE_S 0.04f
+#define MAX_TEMPLATES 8
+#define MAX_EVENTS 64
+
+// Budget for one hop on the host; the target has 16 ms
+#define HOP_BUDGET_US 200.0
+
+typedef struct {
+    float onset_s;
+    int match;
+    float distance;
+} detection_t;
+
+typedef struct {
+    float onset_s;
+    char label[16];
+} label_t;
+
+static mic_spectrum_t sp;
+
+/**
+ * 16-bit PCM WAV at RATE_HZ; the first channel of multi-channel files.
+ */
+static int16_t *load_wav(const char *path, size_t *count) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    uint8_t hdr[12];
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    int16_t *pcm = NULL;
+    if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) goto out;
+
+    uint8_t ch[8];
+    while (fread(ch, 1, 8, f) == 8) {
+        uint32_t len = ch[4] | ch[5] << 8 | ch[6] << 16 | (uint32_t)ch[7] << 24;
+        if (!memcmp(ch, "fmt ", 4) && len >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, 16, f) != 16) goto out;
+            format = fmt[0] | fmt[1] << 8;
+            channels = fmt[2] | fmt[3] << 8;
+            rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+            bits = fmt[14] | fmt[15] << 8;
+            fseek(f, len - 16 + (len & 1), SEEK_CUR);
+        } else if (!memcmp(ch, "data", 4)) {
+            if (format != 1 || bits != 16 || rate != RATE_HZ || channels == 0) break;
+            size_t frames = len / 2 / channels;
+            int16_t *all = malloc(len);
+            if (fread(all, 2, frames * channels, f) != frames * channels) {
+                free(all);
+                goto out;
+            }
+            pcm = malloc(frames * sizeof(int16_t));
+            for (size_t i = 0; i < frames; i++) pcm[i] = all[i * channels];
+            free(all);
+            *count = frames;
+            break;
+        } else {
+            fseek(f, len + (len & 1), SEEK_CUR);
+        }
+    }
+out:
+    fclose(f);
+    if (!pcm) fprintf(stderr, "%s: not a 16-bit PCM WAV at %d Hz\n", path, RATE_HZ);
+    return pcm;
+}
+
+/**
+ * Hop through a clip as mic_classifier's task does: the first window
+ * starts half silent, each onset opens a SEGMENT_HOPS segment, and the
+ * segment's mean bands are matched once it is full. Returns the number of
+ * segments; if shape is set, it gets the first segment's shape.
+ */
+static int run_clip(const int16_t *pcm, size_t n, const mic_sound_template_t *templates, size_t n_templates,
+                    detection_t *out, int max_out, float *shape, double *us_per_hop) {
+    int16_t frame[MIC_FFT_SIZE] = {0};
+    size_t have = MIC_FFT_SIZE - MIC_HOP;
+    float mel_sum[MIC_MEL_BANDS];
+    uint32_t segment_left = 0;
+    float onset_s = 0;
+    int segments = 0;
+    uint64_t ns = 0;
+    size_t hops = 0;
+
+    mic_spectrum_init(&sp, RATE_HZ, NULL);
+    for (size_t pos = 0; pos + MIC_HOP <= n; pos += MIC_HOP) {
+        memcpy(frame + have, pcm + pos, MIC_HOP * sizeof(int16_t));
+        mic_features_t f;
+        uint64_t t0 = now_ns();
+        mic_spectrum_process(&sp, frame, &f);
+        ns += now_ns() - t0;
+        hops++;
+        memmove(frame, frame + MIC_HOP, (MIC_FFT_SIZE - MIC_HOP) * sizeof(int16_t));
+
+        if (f.onset && segment_left == 0) {
+            // The onset sits in the newer half of the window
+            onset_s = (float)pos / RATE_HZ;
+            segment_left = SEGMENT_HOPS;
+            memset(mel_sum, 0, sizeof(mel_sum));
+        }
+        if (!segment_left) continue;
+        for (int b = 0; b < MIC_MEL_BANDS; b++) mel_sum[b] += f.mel[b];
+        if (--segment_left) continue;
+
+        float mel[MIC_MEL_BANDS], s[MIC_MEL_BANDS];
+        for (int b = 0; b < MIC_MEL_BANDS; b++) mel[b] = mel_sum[b] / SEGMENT_HOPS;
+        mic_spectrum_shape(mel, s);
+        if (shape && segments == 0) memcpy(shape, s, sizeof(s));
+        if (segments < max_out) {
+            detection_t *d = &out[segments];
+            d->onset_s = onset_s;
+            d->match = mic_spectrum_match(templates, n_templates, s, &d->distance);
+        }
+        segments++;
+    }
+    if (us_per_hop) *us_per_hop = hops ? ns / 1e3 / hops : 0;
+    return segments;
+}
+
+static int load_labels(const char *path, label_t *labels, int max) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char line[64];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%f,%15s", &labels[n].onset_s, labels[n].label) == 2) n++;
+    }
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char **argv) {
+    const char *scene_path = DATA_DIR "/scene.wav";
+    const char *labels_path = DATA_DIR "/scene_labels.csv";
+    const char *template_args[MAX_TEMPLATES] = {"bark=" DATA_DIR "/bark.wav", "doorbell=" DATA_DIR "/doorbell.wav"};
+    int n_template_args = 2;
+    if (argc >= 3) {
+        scene_path = argv[1];
+        labels_path = argv[2];
+        n_template_args = 0;
+        for (int i = 3; i < argc && n_template_args < MAX_TEMPLATES; i++) template_args[n_template_args++] = argv[i];
+    }
+
+    // Learn one template per clip, as mic_classifier_learn() would after it
+    mic_sound_template_t templates[MAX_TEMPLATES];
+    size_t n_templates = 0;
+    for (int i = 0; i < n_template_args; i++) {
+        const char *eq = strchr(template_args[i], '=');
+        size_t n;
+        int16_t *pcm = eq ? load_wav(eq + 1, &n) : NULL;
+        if (!pcm) {
+            CHECK(false, "can't load template %s", template_args[i]);
+            continue;
+        }
+        mic_sound_template_t *t = &templates[n_templates];
+        snprintf(t->name, sizeof(t->name), "%.*s", (int)(eq - template_args[i]), template_args[i]);
+        t->max_distance = MAX_DISTANCE_DB;
+        detection_t d;
+        int segments = run_clip(pcm, n, NULL, 0, &d, 1, t->shape, NULL);
+        CHECK(segments >= 1, "%s: no onset to learn from", t->name);
+        if (segments >= 1) n_templates++;
+        free(pcm);
+    }
+
+    size_t n;
+    int16_t *scene = load_wav(scene_path, &n);
+    label_t labels[MAX_EVENTS];
+    int n_labels = load_labels(labels_path, labels, MAX_EVENTS);
+    CHECK(scene && n_labels > 0, "can't load %s or %s", scene_path, labels_path);
+    if (!scene || n_labels == 0) return check_result("mic_spectrum");
+
+    detection_t det[MAX_EVENTS];
+    double us_per_hop;
+    int n_det = run_clip(scene, n, templates, n_templates, det, MAX_EVENTS, NULL, &us_per_hop);
+    if (n_det > MAX_EVENTS) n_det = MAX_EVENTS;
+
+    int found = 0, named = 0, extra = 0;
+    bool used[MAX_EVENTS] = {false};
+    for (int d = 0; d < n_det; d++) {
+        const char *name = det[d].match >= 0 ? templates[det[d].match].name : "unknown";
+        int l = 0;
+        while (l < n_labels && (used[l] || fabsf(det[d].onset_s - labels[l].onset_s) > ONSET_TOLERANCE_S)) l++;
+        if (l == n_labels) {
+            printf("%.3f s: %s (%.1f dB) matches no labelled onset\n", det[d].onset_s, name, det[d].distance);
+            extra++;
+            continue;
+        }
+        used[l] = true;
+        found++;
+        bool ok = !strcmp(name, labels[l].label);
+        named += ok;
+        printf("%.3f s: %s (%.1f dB), labelled %s at %.3f s%s\n", det[d].onset_s, name, det[d].distance,
+               labels[l].label, labels[l].onset_s, ok ? "" : "  <- wrong");
+    }
+    for (int l = 0; l < n_labels; l++) {
+        if (!used[l]) printf("%.3f s: %s missed\n", labels[l].onset_s, labels[l].label);
+    }
+    printf("%d/%d onsets found, %d named right, %d extra, %.1f us/hop\n", found, n_labels, named, extra, us_per_hop);
+
+    CHECK(found == n_labels, "%d of %d onsets found", found, n_labels);
+    CHECK(named == n_labels, "%d of %d named right", named, n_labels);
+    CHECK(extra == 0, "%d onsets without a label", extra);
+    CHECK_BUDGET(us_per_hop < HOP_BUDGET_US, "%.1f us/hop over the %.0f us budget", us_per_hop, HOP_BUDGET_US);
+    free(scene);
+    return check_result("mic_spectrum");
+}
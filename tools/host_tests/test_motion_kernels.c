@@ -0,0 +1,256 @@
+// Motion kernels: unit checks, a replay of a synthetic VGA sequence through
+// the same steps as motion_process_frame(), and frame throughput.
+//   test_motion_kernels [frame.pgm ...]
+// With arguments, binary PGM frames (e.g. extracted from a recording with
+// ffmpeg -i clip.mjpeg -pix_fmt gray %04d.pgm) are replayed and timed
+// instead; they are only reported, not checked.
+
+#include "host_test.h"
+#include "motion_kernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Same constants as motion.c
+#define SCALE          8
+#define THRESHOLD      24
+#define BG_SHIFT       4
+#define MIN_LINE_HITS  2
+#define MIN_CHANGED    4
+
+#define FRAME_W 640
+#define FRAME_H 480
+
+// Budget for one VGA frame through the full pipeline on the host
+#define FRAME_BUDGET_US 2000.0
+
+typedef struct {
+    int w, h;
+    uint8_t *gray;
+    uint8_t *bg;
+    uint8_t *mask;
+    bool bg_valid;
+} pipeline_t;
+
+static void pipeline_init(pipeline_t *p, int frame_w, int frame_h) {
+    p->w = frame_w / SCALE;
+    p->h = frame_h / SCALE;
+    size_t n = (size_t)p->w * p->h;
+    p->gray = malloc(n);
+    p->bg = malloc(n);
+    p->mask = malloc(n);
+    p->bg_valid = false;
+}
+
+static void pipeline_free(pipeline_t *p) {
+    free(p->gray);
+    free(p->bg);
+    free(p->mask);
+}
+
+// Returns true and the box in analysis pixels when the frame moved
+static bool pipeline_run(pipeline_t *p, const uint8_t *frame, int frame_w, int frame_h, motion_box_t *box) {
+    size_t n = (size_t)p->w * p->h;
+    motion_downscale_gray(frame, frame_w, frame_h, SCALE, p->gray);
+    if (!p->bg_valid) {
+        memcpy(p->bg, p->gray, n);
+        p->bg_valid = true;
+        return false;
+    }
+    uint32_t changed = motion_absdiff_threshold(p->gray, p->bg, p->mask, n, THRESHOLD);
+    motion_update_background(p->bg, p->gray, n, BG_SHIFT);
+
+    uint32_t min_changed = n / 100;
+    if (min_changed < MIN_CHANGED) min_changed = MIN_CHANGED;
+    return changed >= min_changed && motion_mask_bbox(p->mask, p->w, p->h, MIN_LINE_HITS, box);
+}
+
+static uint32_t lcg(uint32_t *s) {
+    *s = *s * 1664525u + 1013904223u;
+    return *s >> 24;
+}
+
+/**
+ * Textured background with +-3 sensor noise, plus a 64x64 dark square
+ * at (sx, sy) when sx >= 0.
+ */
+static void synth_frame(uint8_t *f, uint32_t *seed, int sx, int sy) {
+    for (int y = 0; y < FRAME_H; y++) {
+        for (int x = 0; x < FRAME_W; x++) {
+            int v = 96 + ((x / 40 + y / 30) & 1) * 64 + (int)(lcg(seed) % 7) - 3;
+            if (sx >= 0 && x >= sx && x < sx + 64 && y >= sy && y < sy + 64) v = 16;
+            f[y * FRAME_W + x] = (uint8_t)v;
+        }
+    }
+}
+
+static void test_kernels(void) {
+    uint8_t src[16 * 8], dst[4 * 2];
+    for (int i = 0; i < 16 * 8; i++) src[i] = (i % 16) < 4 ? 200 : 100;
+    motion_downscale_gray(src, 16, 8, 4, dst);
+    CHECK(dst[0] == 200 && dst[1] == 100 && dst[4] == 200 && dst[7] == 100,
+          "downscale gave %u %u %u %u", dst[0], dst[1], dst[4], dst[7]);
+
+    // Chroma must not leak into the YUV422 result
+    uint8_t yuv[16 * 8 * 2];
+    for (int i = 0; i < 16 * 8; i++) {
+        yuv[i * 2] = (i % 16) < 4 ? 200 : 100;
+        yuv[i * 2 + 1] = 17;
+    }
+    motion_downscale_yuv422(yuv, 16, 8, 4, dst);
+    CHECK(dst[0] == 200 && dst[1] == 100 && dst[4] == 200, "yuv422 gave %u %u %u", dst[0], dst[1], dst[4]);
+
+    // White, then pure red, big-endian
+    uint8_t rgb[16 * 8 * 2];
+    for (int i = 0; i < 16 * 8; i++) {
+        uint16_t v = (i % 16) < 4 ? 0xFFFF : 0xF800;
+        rgb[i * 2] = v >> 8;
+        rgb[i * 2 + 1] = v & 0xFF;
+    }
+    motion_downscale_rgb565(rgb, 16, 8, 4, dst);
+    CHECK(dst[0] == 255 && dst[1] == 76, "rgb565 gave %u %u", dst[0], dst[1]);
+
+    uint8_t cur[64], bg[64], mask[64];
+    memset(bg, 100, sizeof(bg));
+    memset(cur, 100, sizeof(cur));
+    cur[3] = 130;  // above threshold
+    cur[5] = 120;  // at it: not counted
+    cur[9] = 60;   // below, other direction
+    uint32_t changed = motion_absdiff_threshold(cur, bg, mask, sizeof(cur), 20);
+    CHECK(changed == 2, "absdiff counted %u", changed);
+    CHECK(mask[3] == 0xFF && mask[5] == 0 && mask[9] == 0xFF, "absdiff mask wrong");
+
+    // Rounding away from zero means a difference of 1 still converges
+    uint8_t b = 100, c = 101;
+    for (int i = 0; i < 4; i++) motion_update_background(&b, &c, 1, BG_SHIFT);
+    CHECK(b == 101, "background stuck at %u", b);
+    b = 200, c = 0;
+    for (int i = 0; i < 200; i++) motion_update_background(&b, &c, 1, BG_SHIFT);
+    CHECK(b == 0, "background stuck at %u", b);
+
+    // One isolated pixel is ignored, the block is found
+    uint8_t m[10 * 10] = {0};
+    m[0] = 0xFF;
+    for (int y = 4; y < 7; y++)
+        for (int x = 5; x < 8; x++) m[y * 10 + x] = 0xFF;
+    motion_box_t box;
+    CHECK(motion_mask_bbox(m, 10, 10, 2, &box), "bbox found nothing");
+    CHECK(box.x == 5 && box.y == 4 && box.w == 3 && box.h == 3, "bbox %u,%u %ux%u", box.x, box.y, box.w, box.h);
+    memset(m, 0, sizeof(m));
+    m[55] = 0xFF;
+    CHECK(!motion_mask_bbox(m, 10, 10, 2, &box), "noise pixel made a box");
+}
+
+static void test_replay(void) {
+    uint8_t *f = malloc(FRAME_W * FRAME_H);
+    uint32_t seed = 1;
+    pipeline_t p;
+    pipeline_init(&p, FRAME_W, FRAME_H);
+
+    int false_pos = 0, hits = 0, misses = 0;
+    for (int i = 0; i < 60; i++) {
+        // Still for 20 frames, then the square crosses the frame, then gone
+        int moving = i >= 20 && i < 40;
+        int sx = moving ? 64 + (i - 20) * 24 : -1;
+        int sy = 200;
+        synth_frame(f, &seed, sx, sy);
+
+        motion_box_t box;
+        bool moved = pipeline_run(&p, f, FRAME_W, FRAME_H, &box);
+        if (!moving) {
+            // The frame the square leaves is a change too
+            if (moved && i != 40) false_pos++;
+            continue;
+        }
+        if (!moved) {
+            misses++;
+            continue;
+        }
+        // The box must cover the square, allowing for the 1/8 grid
+        int bx = box.x * SCALE, by = box.y * SCALE;
+        int bx2 = (box.x + box.w) * SCALE, by2 = (box.y + box.h) * SCALE;
+        if (bx <= sx + SCALE && by <= sy + SCALE && bx2 >= sx + 64 - SCALE && by2 >= sy + 64 - SCALE) {
+            hits++;
+        } else {
+            fprintf(stderr, "frame %d: box %d,%d-%d,%d misses square at %d,%d\n", i, bx, by, bx2, by2, sx, sy);
+        }
+    }
+    CHECK(false_pos == 0, "%d frames reported motion while still", false_pos);
+    CHECK(misses == 0, "%d moving frames missed", misses);
+    CHECK(hits == 20, "%d of 20 boxes covered the square", hits);
+
+    pipeline_free(&p);
+    free(f);
+}
+
+static double bench(uint8_t **frames, int count, int w, int h) {
+    pipeline_t p;
+    pipeline_init(&p, w, h);
+    motion_box_t box;
+    int moved = 0;
+
+    const int rounds = count < 50 ? 50 / count + 1 : 1;
+    uint64_t t0 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) moved += pipeline_run(&p, frames[i], w, h, &box);
+    }
+    double us = (now_ns() - t0) / 1e3 / (rounds * count);
+    keep(&moved);
+    printf("%dx%d: %.1f us/frame, %.0f Mpixel/s, %d of %d frames moved\n", w, h, us, w * h / us,
+           moved, rounds * count);
+    pipeline_free(&p);
+    return us;
+}
+
+static uint8_t *load_pgm(const char *path, int *w, int *h) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    int maxval;
+    uint8_t *data = NULL;
+    if (fscanf(fp, "P5 %d %d %d", w, h, &maxval) == 3 && maxval == 255 && fgetc(fp) != EOF) {
+        data = malloc((size_t)*w * *h);
+        if (fread(data, 1, (size_t)*w * *h, fp) != (size_t)*w * *h) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+    return data;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        uint8_t **frames = calloc(argc - 1, sizeof(*frames));
+        int w = 0, h = 0, count = 0;
+        for (int i = 1; i < argc; i++) {
+            int fw, fh;
+            uint8_t *f = load_pgm(argv[i], &fw, &fh);
+            if (!f || (count && (fw != w || fh != h))) {
+                fprintf(stderr, "%s: not an 8-bit PGM of the same size as the first frame\n", argv[i]);
+                free(f);
+                continue;
+            }
+            w = fw;
+            h = fh;
+            frames[count++] = f;
+        }
+        if (count) bench(frames, count, w, h);
+        for (int i = 0; i < count; i++) free(frames[i]);
+        free(frames);
+        return count ? 0 : 1;
+    }
+
+    test_kernels();
+    test_replay();
+
+    uint8_t *frames[8];
+    uint32_t seed = 7;
+    for (int i = 0; i < 8; i++) {
+        frames[i] = malloc(FRAME_W * FRAME_H);
+        synth_frame(frames[i], &seed, 100 + i * 40, 200);
+    }
+    double us = bench(frames, 8, FRAME_W, FRAME_H);
+    CHECK_BUDGET(us < FRAME_BUDGET_US, "%.1f us/frame over the %.0f us budget", us, FRAME_BUDGET_US);
+    for (int i = 0; i < 8; i++) free(frames[i]);
+
+    return check_result("motion_kernels");
+}